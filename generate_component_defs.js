@@ -2,9 +2,63 @@ const fs = require('fs');
 const path = require('path');
 
 
+// Fields marked cold move to a generated side table type named after the component, which the ECS adds and
+// removes along with it. The component's type info still lists every field, with cold offsets into the side table.
+const splitColdFields = types =>
+    types.reduce((result, type) => {
+        const coldFields = (type.fields || []).filter(field => field.cold === true);
+        if (coldFields.length === 0) return result.concat([type]);
+
+        const coldType = {
+            name: `${type.name}Cold`,
+            hide: true,
+            serialize: false,
+            cold: true,
+            fields: coldFields.map(field => Object.assign({}, field, { cold: false })),
+        };
+
+        return result.concat([coldType, Object.assign({}, type, { coldType: coldType.name })]);
+    }, []);
+
+const hotFields = type => type.fields.filter(field => field.cold !== true);
+
+const fieldCType = field => {
+    if (field.type === 'string')  return 'char*';
+    if (field.type === 'pointer') return 'const void*';
+    return field.type;
+};
+
+// Types with "layout": "soa" are stored by the ECS as one stream per hot field, each ECS_PAGE_ITEM_COUNT values
+// long, in field order. The struct is still generated for gathering and scattering whole components, and each
+// hot field gets an accessor macro yielding an lvalue from an ECSSoaRef.
+const writeSoaAccessors = type =>
+{
+    const fields = hotFields(type);
+
+    fields.forEach(field => {
+        if (field.vec || field.type === 'string')
+            throw new Error(`Structure of arrays component ${type.name} can only hold plain data, but ${field.name} owns memory`);
+
+        // The inspector edits a gathered copy of a structure of arrays component, which is freed before an
+        // entity picked for the field could be assigned through it later.
+        if (field.type === 'Entity' && field.hide !== true)
+            throw new Error(`Structure of arrays component ${type.name} cannot show Entity field ${field.name} in the inspector, mark it hidden`);
+    });
+
+    return fields.map((field, i) => {
+        const streamOffset = ['0'].concat(fields.slice(0, i).map(f => `sizeof(${fieldCType(f)})`)).join(' + ');
+        return `#define ${type.name}_${field.name}(ref) (((${fieldCType(field)}*)((ref).page + ECS_PAGE_ITEM_COUNT * (${streamOffset})))[(ref).lane])`;
+    }).join('\n');
+};
+
+// Vec fields with an "inline_capacity" are SmallVecs, which keep that many items in the component before
+// allocating.
+const isSmallVec = field => field.vec === true && field.inline_capacity > 0;
+
 const writeStructDef = type =>
 {
     const writeStructField = field => {
+        if (isSmallVec(field))        return `    SMALL_VEC(${fieldCType(field)}, ${field.inline_capacity}) ${field.name};`;
         if (field.vec)                return `    Vec ${field.name}; // of ${field.type}`;
         if (field.type === 'string')  return `    char *${field.name};`;
         if (field.type === 'pointer') return `    const void *${field.name};`;
@@ -12,7 +66,7 @@ const writeStructDef = type =>
     };
 
     return [`typedef struct ${type.name}`, '{']
-        .concat(type.fields.map(writeStructField))
+        .concat(hotFields(type).map(writeStructField))
         .concat(['}', `${type.name};`])
         .join('\n');
 };
@@ -42,13 +96,16 @@ const writeDefaultDef = (types, rootType) =>
     };
 
     const writeDefaultForType = type =>
-        '{' + type.fields
+        '{' + hotFields(type)
             .map(field => writeDefaultForField(field))
             .join(',') + '}';
 
     const writeDefaultForField = field => {
         if (field.default) return field.default;
 
+        if (isSmallVec(field))
+            return `SMALL_VEC_EMPTY(${fieldCType(field)}, ${field.inline_capacity})`;
+
         if (field.vec) {
             const typeName = field.type === 'string' ? 'char*' : field.type;
             return `{sizeof(${typeName}),0,0}`;
@@ -60,6 +117,19 @@ const writeDefaultDef = (types, rootType) =>
     return `static const ${rootType.name} ${rootType.name}_default = ${writeDefaultForTypeName(rootType.name)};`;
 };
 
+const writeFlags = item => {
+    let flags = '0';
+    if (item.hide === true) flags += ' | COMPONENT_FLAG_HIDDEN';
+    if (item.vec === true) flags += ' | COMPONENT_FLAG_IS_VEC';
+    if (isSmallVec(item)) flags += ' | COMPONENT_FLAG_SMALL_VEC';
+    if (item.serialize === false) flags += ' | COMPONENT_FLAG_DONT_SERIALIZE';
+    if (item.singleton === true) flags += ' | COMPONENT_FLAG_SINGLETON';
+    if (item.tag === true) flags += ' | COMPONENT_FLAG_TAG';
+    if (item.cold === true) flags += ' | COMPONENT_FLAG_COLD';
+    if (item.layout === 'soa') flags += ' | COMPONENT_FLAG_SOA';
+    return flags;
+};
+
 const writeTypeInfo = (types, rootType) =>
 {
     const writeFieldType = typeName => {
@@ -79,26 +149,21 @@ const writeTypeInfo = (types, rootType) =>
         }
     };
 
-    const writeFlags = item => {
-        let flags = '0';
-        if (item.hide === true) flags += ' | COMPONENT_FLAG_HIDDEN';
-        if (item.vec === true) flags += ' | COMPONENT_FLAG_IS_VEC';
-        if (item.serialize === false) flags += ' | COMPONENT_FLAG_DONT_SERIALIZE';
-        return flags;
-    };
-
     const writeSubName = field =>
         writeFieldType(field.type) === 'COMPONENT_FIELD_TYPE_SUBCOMPONENT'
             ? `"${field.type}"`
             : 'NULL';
 
-    const writeFieldInfo = field => 
-        `    { "${field.name}", ${writeFieldType(field.type)}, ${writeFlags(field)}, ${writeSubName(field)}, (size_t)&((${rootType.name}*)0)->${field.name} }`;
+    const writeFieldInfo = field => {
+        const structName = field.cold === true ? rootType.coldType : rootType.name;
+        return `    { "${field.name}", ${writeFieldType(field.type)}, ${writeFlags(field)}, ${writeSubName(field)}, (size_t)&((${structName}*)0)->${field.name}, sizeof(((${structName}*)0)->${field.name}) }`;
+    };
 
     const fieldInfos = rootType.fields.map(writeFieldInfo).join(',\n');
+    const coldInfo = rootType.coldType ? `&${rootType.coldType}_info` : 'NULL';
 
-    return `static const ComponentInfo ${rootType.name}_info = { "${rootType.name}", sizeof(${rootType.name}), ` +
-        `&${rootType.name}_default, &${rootType.name}_destruct, ${writeFlags(rootType)}, ${rootType.fields.length}, {\n${fieldInfos}\n}};`;
+    return `static const ComponentInfo ${rootType.name}_info = { "${rootType.name}", ${rootType.name}_id, sizeof(${rootType.name}), ` +
+        `&${rootType.name}_default, &${rootType.name}_destruct, ${writeFlags(rootType)}, ${coldInfo}, ${rootType.fields.length}, {\n${fieldInfos}\n}};`;
 };
 
 const writeDestructor = (type, body) => {
@@ -110,6 +175,16 @@ const writeDestructor = (type, body) => {
     return result;
 };
 
+// Tags carry no data, so they only get an ID and a type info, without a struct, default or destructor.
+const writeTagInfo = type =>
+    `static const ComponentInfo ${type.name}_info = { "${type.name}", ${type.name}_id, 0, NULL, NULL, ${writeFlags(type)}, NULL, 0 };`;
+
+const writeComponentIds = types =>
+    ['enum', '{']
+        .concat(types.map((t, i) => `    ${t.name}_id = ${i},`))
+        .concat(['};'])
+        .join('\n');
+
 const writeAllInfosArray = types => {
     const infoPtrs = types.map(t => `&${t.name}_info`).join(', ');
 
@@ -124,15 +199,27 @@ const writeComponentDefsHeader = types => {
         '#include <stdint.h>',
         '#include <stddef.h>',
         '#include "containers/vec.h"',
+        '#include "containers/small_vec.h"',
         '#include "components.h"',
     ''];
 
-    types.forEach(c => {
+    result.push(writeComponentIds(types));
+    result.push('');
+
+    const dataTypes = types.filter(t => t.tag !== true);
+
+    dataTypes.forEach(c => {
         result.push(writeStructDef(c));
+        if (c.layout === 'soa') result.push(writeSoaAccessors(c));
+        result.push('');
+    });
+
+    types.filter(t => t.tag === true).forEach(c => {
+        result.push(writeTagInfo(c));
         result.push('');
     });
 
-    types.forEach(c => {
+    dataTypes.forEach(c => {
         result.push(writeDestructor(c, false));
         result.push(writeDefaultDef(types, c));
         result.push(writeTypeInfo(types, c));
@@ -147,5 +234,5 @@ const writeComponentDefsHeader = types => {
 
 fs.writeFileSync(
     path.join(__dirname, 'src', 'component_defs.h'), 
-    writeComponentDefsHeader(require('./engine.components.json').concat(require('./game.components.json')))
+    writeComponentDefsHeader(splitColdFields(require('./engine.components.json').concat(require('./game.components.json'))))
 );
@@ -0,0 +1,225 @@
+#pragma once
+/*generated*/ #include <cglm/cglm.h>
+/*generated*/ #include <stdint.h>
+/*generated*/ #include <stddef.h>
+/*generated*/ #include "containers/vec.h"
+/*generated*/ #include "containers/small_vec.h"
+/*generated*/ #include "components.h"
+/*generated*/ 
+/*generated*/ enum
+/*generated*/ {
+/*generated*/     TransformCold_id = 0,
+/*generated*/     Transform_id = 1,
+/*generated*/     GamepadInputFrame_id = 2,
+/*generated*/     InputFrame_id = 3,
+/*generated*/     InputState_id = 4,
+/*generated*/     ClockInfo_id = 5,
+/*generated*/     MeshRenderer_id = 6,
+/*generated*/     MeshCollider_id = 7,
+/*generated*/     WorldCollisionInfo_id = 8,
+/*generated*/     Camera_id = 9,
+/*generated*/     Player_id = 10,
+/*generated*/     GameCamera_id = 11,
+/*generated*/ };
+/*generated*/ 
+/*generated*/ typedef struct TransformCold
+/*generated*/ {
+/*generated*/     char *name;
+/*generated*/     SMALL_VEC(Entity, 4) children;
+/*generated*/ }
+/*generated*/ TransformCold;
+/*generated*/ 
+/*generated*/ typedef struct Transform
+/*generated*/ {
+/*generated*/     vec3 position;
+/*generated*/     versor rotation;
+/*generated*/     vec3 scale;
+/*generated*/     Entity parent;
+/*generated*/     mat4 world_matrix;
+/*generated*/ }
+/*generated*/ Transform;
+/*generated*/ #define Transform_position(ref) (((vec3*)((ref).page + ECS_PAGE_ITEM_COUNT * (0)))[(ref).lane])
+/*generated*/ #define Transform_rotation(ref) (((versor*)((ref).page + ECS_PAGE_ITEM_COUNT * (0 + sizeof(vec3))))[(ref).lane])
+/*generated*/ #define Transform_scale(ref) (((vec3*)((ref).page + ECS_PAGE_ITEM_COUNT * (0 + sizeof(vec3) + sizeof(versor))))[(ref).lane])
+/*generated*/ #define Transform_parent(ref) (((Entity*)((ref).page + ECS_PAGE_ITEM_COUNT * (0 + sizeof(vec3) + sizeof(versor) + sizeof(vec3))))[(ref).lane])
+/*generated*/ #define Transform_world_matrix(ref) (((mat4*)((ref).page + ECS_PAGE_ITEM_COUNT * (0 + sizeof(vec3) + sizeof(versor) + sizeof(vec3) + sizeof(Entity))))[(ref).lane])
+/*generated*/ 
+/*generated*/ typedef struct GamepadInputFrame
+/*generated*/ {
+/*generated*/     SMALL_VEC(int, 4) buttons;
+/*generated*/     vec2 left_stick;
+/*generated*/     vec2 right_stick;
+/*generated*/ }
+/*generated*/ GamepadInputFrame;
+/*generated*/ 
+/*generated*/ typedef struct InputFrame
+/*generated*/ {
+/*generated*/     vec2 mouse_pos;
+/*generated*/     bool left_mouse;
+/*generated*/     bool right_mouse;
+/*generated*/     SMALL_VEC(int, 4) keys;
+/*generated*/     bool has_gamepad;
+/*generated*/     GamepadInputFrame gamepad;
+/*generated*/ }
+/*generated*/ InputFrame;
+/*generated*/ 
+/*generated*/ typedef struct InputState
+/*generated*/ {
+/*generated*/     InputFrame cur;
+/*generated*/     InputFrame prev;
+/*generated*/ }
+/*generated*/ InputState;
+/*generated*/ 
+/*generated*/ typedef struct ClockInfo
+/*generated*/ {
+/*generated*/     float delta_secs;
+/*generated*/     float secs_since_start;
+/*generated*/ }
+/*generated*/ ClockInfo;
+/*generated*/ 
+/*generated*/ typedef struct MeshRenderer
+/*generated*/ {
+/*generated*/     char *mesh;
+/*generated*/     char *material;
+/*generated*/ }
+/*generated*/ MeshRenderer;
+/*generated*/ 
+/*generated*/ typedef struct MeshCollider
+/*generated*/ {
+/*generated*/     char *mesh;
+/*generated*/ }
+/*generated*/ MeshCollider;
+/*generated*/ 
+/*generated*/ typedef struct WorldCollisionInfo
+/*generated*/ {
+/*generated*/     const void *info;
+/*generated*/ }
+/*generated*/ WorldCollisionInfo;
+/*generated*/ 
+/*generated*/ typedef struct Camera
+/*generated*/ {
+/*generated*/     bool is_editor;
+/*generated*/     float fov;
+/*generated*/     float near_clip;
+/*generated*/     float far_clip;
+/*generated*/ }
+/*generated*/ Camera;
+/*generated*/ 
+/*generated*/ typedef struct Player
+/*generated*/ {
+/*generated*/     vec3 velocity;
+/*generated*/ }
+/*generated*/ Player;
+/*generated*/ 
+/*generated*/ typedef struct GameCamera
+/*generated*/ {
+/*generated*/     Entity target;
+/*generated*/ }
+/*generated*/ GameCamera;
+/*generated*/ 
+/*generated*/ static inline void TransformCold_destruct( TransformCold *x );
+/*generated*/ static const TransformCold TransformCold_default = {0,SMALL_VEC_EMPTY(Entity, 4)};
+/*generated*/ static const ComponentInfo TransformCold_info = { "TransformCold", TransformCold_id, sizeof(TransformCold), &TransformCold_default, &TransformCold_destruct, 0 | COMPONENT_FLAG_HIDDEN | COMPONENT_FLAG_DONT_SERIALIZE | COMPONENT_FLAG_COLD, NULL, 2, {
+/*generated*/     { "name", COMPONENT_FIELD_TYPE_STRING, 0, NULL, (size_t)&((TransformCold*)0)->name, sizeof(((TransformCold*)0)->name) },
+/*generated*/     { "children", COMPONENT_FIELD_TYPE_ENTITY, 0 | COMPONENT_FLAG_HIDDEN | COMPONENT_FLAG_IS_VEC | COMPONENT_FLAG_SMALL_VEC | COMPONENT_FLAG_DONT_SERIALIZE, NULL, (size_t)&((TransformCold*)0)->children, sizeof(((TransformCold*)0)->children) }
+/*generated*/ }};
+/*generated*/ static inline void TransformCold_destruct( TransformCold *x ){ components_generic_destruct( &TransformCold_info, x ); }
+/*generated*/ 
+/*generated*/ static inline void Transform_destruct( Transform *x );
+/*generated*/ static const Transform Transform_default = {{0.f,0.f,0.f},{0.f,0.f,0.f,1.f},{1.f, 1.f, 1.f},0,{{1.f,0.f,0.f,0.f},{0.f,1.f,0.f,0.f},{0.f,0.f,1.f,0.f},{0.f,0.f,0.f,1.f}}};
+/*generated*/ static const ComponentInfo Transform_info = { "Transform", Transform_id, sizeof(Transform), &Transform_default, &Transform_destruct, 0 | COMPONENT_FLAG_SOA, &TransformCold_info, 7, {
+/*generated*/     { "name", COMPONENT_FIELD_TYPE_STRING, 0 | COMPONENT_FLAG_COLD, NULL, (size_t)&((TransformCold*)0)->name, sizeof(((TransformCold*)0)->name) },
+/*generated*/     { "position", COMPONENT_FIELD_TYPE_VEC3, 0, NULL, (size_t)&((Transform*)0)->position, sizeof(((Transform*)0)->position) },
+/*generated*/     { "rotation", COMPONENT_FIELD_TYPE_VERSOR, 0, NULL, (size_t)&((Transform*)0)->rotation, sizeof(((Transform*)0)->rotation) },
+/*generated*/     { "scale", COMPONENT_FIELD_TYPE_VEC3, 0, NULL, (size_t)&((Transform*)0)->scale, sizeof(((Transform*)0)->scale) },
+/*generated*/     { "parent", COMPONENT_FIELD_TYPE_ENTITY, 0 | COMPONENT_FLAG_HIDDEN, NULL, (size_t)&((Transform*)0)->parent, sizeof(((Transform*)0)->parent) },
+/*generated*/     { "children", COMPONENT_FIELD_TYPE_ENTITY, 0 | COMPONENT_FLAG_HIDDEN | COMPONENT_FLAG_IS_VEC | COMPONENT_FLAG_SMALL_VEC | COMPONENT_FLAG_DONT_SERIALIZE | COMPONENT_FLAG_COLD, NULL, (size_t)&((TransformCold*)0)->children, sizeof(((TransformCold*)0)->children) },
+/*generated*/     { "world_matrix", COMPONENT_FIELD_TYPE_MAT4, 0 | COMPONENT_FLAG_HIDDEN | COMPONENT_FLAG_DONT_SERIALIZE, NULL, (size_t)&((Transform*)0)->world_matrix, sizeof(((Transform*)0)->world_matrix) }
+/*generated*/ }};
+/*generated*/ static inline void Transform_destruct( Transform *x ){ components_generic_destruct( &Transform_info, x ); }
+/*generated*/ 
+/*generated*/ static inline void GamepadInputFrame_destruct( GamepadInputFrame *x );
+/*generated*/ static const GamepadInputFrame GamepadInputFrame_default = {SMALL_VEC_EMPTY(int, 4),{0.f,0.f},{0.f,0.f}};
+/*generated*/ static const ComponentInfo GamepadInputFrame_info = { "GamepadInputFrame", GamepadInputFrame_id, sizeof(GamepadInputFrame), &GamepadInputFrame_default, &GamepadInputFrame_destruct, 0 | COMPONENT_FLAG_HIDDEN, NULL, 3, {
+/*generated*/     { "buttons", COMPONENT_FIELD_TYPE_INT, 0 | COMPONENT_FLAG_IS_VEC | COMPONENT_FLAG_SMALL_VEC, NULL, (size_t)&((GamepadInputFrame*)0)->buttons, sizeof(((GamepadInputFrame*)0)->buttons) },
+/*generated*/     { "left_stick", COMPONENT_FIELD_TYPE_VEC2, 0, NULL, (size_t)&((GamepadInputFrame*)0)->left_stick, sizeof(((GamepadInputFrame*)0)->left_stick) },
+/*generated*/     { "right_stick", COMPONENT_FIELD_TYPE_VEC2, 0, NULL, (size_t)&((GamepadInputFrame*)0)->right_stick, sizeof(((GamepadInputFrame*)0)->right_stick) }
+/*generated*/ }};
+/*generated*/ static inline void GamepadInputFrame_destruct( GamepadInputFrame *x ){ components_generic_destruct( &GamepadInputFrame_info, x ); }
+/*generated*/ 
+/*generated*/ static inline void InputFrame_destruct( InputFrame *x );
+/*generated*/ static const InputFrame InputFrame_default = {{0.f,0.f},0,0,SMALL_VEC_EMPTY(int, 4),0,{SMALL_VEC_EMPTY(int, 4),{0.f,0.f},{0.f,0.f}}};
+/*generated*/ static const ComponentInfo InputFrame_info = { "InputFrame", InputFrame_id, sizeof(InputFrame), &InputFrame_default, &InputFrame_destruct, 0 | COMPONENT_FLAG_HIDDEN, NULL, 6, {
+/*generated*/     { "mouse_pos", COMPONENT_FIELD_TYPE_VEC2, 0, NULL, (size_t)&((InputFrame*)0)->mouse_pos, sizeof(((InputFrame*)0)->mouse_pos) },
+/*generated*/     { "left_mouse", COMPONENT_FIELD_TYPE_BOOL, 0, NULL, (size_t)&((InputFrame*)0)->left_mouse, sizeof(((InputFrame*)0)->left_mouse) },
+/*generated*/     { "right_mouse", COMPONENT_FIELD_TYPE_BOOL, 0, NULL, (size_t)&((InputFrame*)0)->right_mouse, sizeof(((InputFrame*)0)->right_mouse) },
+/*generated*/     { "keys", COMPONENT_FIELD_TYPE_INT, 0 | COMPONENT_FLAG_IS_VEC | COMPONENT_FLAG_SMALL_VEC, NULL, (size_t)&((InputFrame*)0)->keys, sizeof(((InputFrame*)0)->keys) },
+/*generated*/     { "has_gamepad", COMPONENT_FIELD_TYPE_BOOL, 0, NULL, (size_t)&((InputFrame*)0)->has_gamepad, sizeof(((InputFrame*)0)->has_gamepad) },
+/*generated*/     { "gamepad", COMPONENT_FIELD_TYPE_SUBCOMPONENT, 0, "GamepadInputFrame", (size_t)&((InputFrame*)0)->gamepad, sizeof(((InputFrame*)0)->gamepad) }
+/*generated*/ }};
+/*generated*/ static inline void InputFrame_destruct( InputFrame *x ){ components_generic_destruct( &InputFrame_info, x ); }
+/*generated*/ 
+/*generated*/ static inline void InputState_destruct( InputState *x );
+/*generated*/ static const InputState InputState_default = {{{0.f,0.f},0,0,SMALL_VEC_EMPTY(int, 4),0,{SMALL_VEC_EMPTY(int, 4),{0.f,0.f},{0.f,0.f}}},{{0.f,0.f},0,0,SMALL_VEC_EMPTY(int, 4),0,{SMALL_VEC_EMPTY(int, 4),{0.f,0.f},{0.f,0.f}}}};
+/*generated*/ static const ComponentInfo InputState_info = { "InputState", InputState_id, sizeof(InputState), &InputState_default, &InputState_destruct, 0 | COMPONENT_FLAG_HIDDEN | COMPONENT_FLAG_DONT_SERIALIZE | COMPONENT_FLAG_SINGLETON, NULL, 2, {
+/*generated*/     { "cur", COMPONENT_FIELD_TYPE_SUBCOMPONENT, 0, "InputFrame", (size_t)&((InputState*)0)->cur, sizeof(((InputState*)0)->cur) },
+/*generated*/     { "prev", COMPONENT_FIELD_TYPE_SUBCOMPONENT, 0, "InputFrame", (size_t)&((InputState*)0)->prev, sizeof(((InputState*)0)->prev) }
+/*generated*/ }};
+/*generated*/ static inline void InputState_destruct( InputState *x ){ components_generic_destruct( &InputState_info, x ); }
+/*generated*/ 
+/*generated*/ static inline void ClockInfo_destruct( ClockInfo *x );
+/*generated*/ static const ClockInfo ClockInfo_default = {0.f,0.f};
+/*generated*/ static const ComponentInfo ClockInfo_info = { "ClockInfo", ClockInfo_id, sizeof(ClockInfo), &ClockInfo_default, &ClockInfo_destruct, 0 | COMPONENT_FLAG_HIDDEN | COMPONENT_FLAG_DONT_SERIALIZE | COMPONENT_FLAG_SINGLETON, NULL, 2, {
+/*generated*/     { "delta_secs", COMPONENT_FIELD_TYPE_FLOAT, 0, NULL, (size_t)&((ClockInfo*)0)->delta_secs, sizeof(((ClockInfo*)0)->delta_secs) },
+/*generated*/     { "secs_since_start", COMPONENT_FIELD_TYPE_FLOAT, 0, NULL, (size_t)&((ClockInfo*)0)->secs_since_start, sizeof(((ClockInfo*)0)->secs_since_start) }
+/*generated*/ }};
+/*generated*/ static inline void ClockInfo_destruct( ClockInfo *x ){ components_generic_destruct( &ClockInfo_info, x ); }
+/*generated*/ 
+/*generated*/ static inline void MeshRenderer_destruct( MeshRenderer *x );
+/*generated*/ static const MeshRenderer MeshRenderer_default = {0,0};
+/*generated*/ static const ComponentInfo MeshRenderer_info = { "MeshRenderer", MeshRenderer_id, sizeof(MeshRenderer), &MeshRenderer_default, &MeshRenderer_destruct, 0, NULL, 2, {
+/*generated*/     { "mesh", COMPONENT_FIELD_TYPE_STRING, 0, NULL, (size_t)&((MeshRenderer*)0)->mesh, sizeof(((MeshRenderer*)0)->mesh) },
+/*generated*/     { "material", COMPONENT_FIELD_TYPE_STRING, 0, NULL, (size_t)&((MeshRenderer*)0)->material, sizeof(((MeshRenderer*)0)->material) }
+/*generated*/ }};
+/*generated*/ static inline void MeshRenderer_destruct( MeshRenderer *x ){ components_generic_destruct( &MeshRenderer_info, x ); }
+/*generated*/ 
+/*generated*/ static inline void MeshCollider_destruct( MeshCollider *x );
+/*generated*/ static const MeshCollider MeshCollider_default = {0};
+/*generated*/ static const ComponentInfo MeshCollider_info = { "MeshCollider", MeshCollider_id, sizeof(MeshCollider), &MeshCollider_default, &MeshCollider_destruct, 0, NULL, 1, {
+/*generated*/     { "mesh", COMPONENT_FIELD_TYPE_STRING, 0, NULL, (size_t)&((MeshCollider*)0)->mesh, sizeof(((MeshCollider*)0)->mesh) }
+/*generated*/ }};
+/*generated*/ static inline void MeshCollider_destruct( MeshCollider *x ){ components_generic_destruct( &MeshCollider_info, x ); }
+/*generated*/ 
+/*generated*/ static inline void WorldCollisionInfo_destruct( WorldCollisionInfo *x );
+/*generated*/ static const WorldCollisionInfo WorldCollisionInfo_default = {0};
+/*generated*/ static const ComponentInfo WorldCollisionInfo_info = { "WorldCollisionInfo", WorldCollisionInfo_id, sizeof(WorldCollisionInfo), &WorldCollisionInfo_default, &WorldCollisionInfo_destruct, 0 | COMPONENT_FLAG_HIDDEN | COMPONENT_FLAG_DONT_SERIALIZE | COMPONENT_FLAG_SINGLETON, NULL, 1, {
+/*generated*/     { "info", COMPONENT_FIELD_TYPE_POINTER, 0, NULL, (size_t)&((WorldCollisionInfo*)0)->info, sizeof(((WorldCollisionInfo*)0)->info) }
+/*generated*/ }};
+/*generated*/ static inline void WorldCollisionInfo_destruct( WorldCollisionInfo *x ){ components_generic_destruct( &WorldCollisionInfo_info, x ); }
+/*generated*/ 
+/*generated*/ static inline void Camera_destruct( Camera *x );
+/*generated*/ static const Camera Camera_default = {0,1.5708f,1.0f,500.0f};
+/*generated*/ static const ComponentInfo Camera_info = { "Camera", Camera_id, sizeof(Camera), &Camera_default, &Camera_destruct, 0, NULL, 4, {
+/*generated*/     { "is_editor", COMPONENT_FIELD_TYPE_BOOL, 0, NULL, (size_t)&((Camera*)0)->is_editor, sizeof(((Camera*)0)->is_editor) },
+/*generated*/     { "fov", COMPONENT_FIELD_TYPE_FLOAT, 0, NULL, (size_t)&((Camera*)0)->fov, sizeof(((Camera*)0)->fov) },
+/*generated*/     { "near_clip", COMPONENT_FIELD_TYPE_FLOAT, 0, NULL, (size_t)&((Camera*)0)->near_clip, sizeof(((Camera*)0)->near_clip) },
+/*generated*/     { "far_clip", COMPONENT_FIELD_TYPE_FLOAT, 0, NULL, (size_t)&((Camera*)0)->far_clip, sizeof(((Camera*)0)->far_clip) }
+/*generated*/ }};
+/*generated*/ static inline void Camera_destruct( Camera *x ){ components_generic_destruct( &Camera_info, x ); }
+/*generated*/ 
+/*generated*/ static inline void Player_destruct( Player *x );
+/*generated*/ static const Player Player_default = {{0.f,0.f,0.f}};
+/*generated*/ static const ComponentInfo Player_info = { "Player", Player_id, sizeof(Player), &Player_default, &Player_destruct, 0 | COMPONENT_FLAG_SINGLETON, NULL, 1, {
+/*generated*/     { "velocity", COMPONENT_FIELD_TYPE_VEC3, 0, NULL, (size_t)&((Player*)0)->velocity, sizeof(((Player*)0)->velocity) }
+/*generated*/ }};
+/*generated*/ static inline void Player_destruct( Player *x ){ components_generic_destruct( &Player_info, x ); }
+/*generated*/ 
+/*generated*/ static inline void GameCamera_destruct( GameCamera *x );
+/*generated*/ static const GameCamera GameCamera_default = {0};
+/*generated*/ static const ComponentInfo GameCamera_info = { "GameCamera", GameCamera_id, sizeof(GameCamera), &GameCamera_default, &GameCamera_destruct, 0 | COMPONENT_FLAG_SINGLETON, NULL, 1, {
+/*generated*/     { "target", COMPONENT_FIELD_TYPE_ENTITY, 0, NULL, (size_t)&((GameCamera*)0)->target, sizeof(((GameCamera*)0)->target) }
+/*generated*/ }};
+/*generated*/ static inline void GameCamera_destruct( GameCamera *x ){ components_generic_destruct( &GameCamera_info, x ); }
+/*generated*/ 
+/*generated*/ #define COMPONENTS_TOTAL_COUNT 12
+/*generated*/ static const ComponentInfo *COMPONENTS_ALL_INFOS[] = { &TransformCold_info, &Transform_info, &GamepadInputFrame_info, &InputFrame_info, &InputState_info, &ClockInfo_info, &MeshRenderer_info, &MeshCollider_info, &WorldCollisionInfo_info, &Camera_info, &Player_info, &GameCamera_info };
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <cglm/cglm.h>
 #include <cJSON.h>
 #include <string.h>
+#include <inttypes.h>
 #include <imgui_impl.h>
 
 #include "utils.h"
@@ -40,6 +41,12 @@ static const ComponentInfo *get_info_for_component_type( const char *type_name )
     PANIC("Unrecognized component type in get_info_for_component_type");
 }
 
+// Fields flagged cold live in the component's side table rather than in the component itself.
+static void *component_field_ptr( void *component, void *cold, const ComponentField *field )
+{
+    return (uint8_t*)( field->flags & COMPONENT_FLAG_COLD ? cold : component ) + field->offset;
+}
+
 static void inspect_int   ( const char *label, int    *v ) { igInputInt(label, v, 1, 10, 0); }
 static void inspect_float ( const char *label, float  *v ) { igDragFloat(label, v, 0.005f, -INFINITY, INFINITY, NULL, 1.0f); }
 static void inspect_bool  ( const char *label, bool   *v ) { igCheckbox(label, v); }
@@ -88,7 +95,7 @@ static void inspect_string( const char *label, char **v )
     }
 }
 
-static void inspect_component( ECS *ecs, void *component, const char *label, const ComponentInfo *info );
+static void inspect_component( ECS *ecs, void *component, void *cold, const char *label, const ComponentInfo *info );
 
 static void inspect_field( ECS *ecs, void *field, const ComponentField *field_def )
 {
@@ -113,14 +120,14 @@ static void inspect_field( ECS *ecs, void *field, const ComponentField *field_de
     case COMPONENT_FIELD_TYPE_ENTITY:  inspect_Entity( ecs, field_def->name, field ); return;
 
     case COMPONENT_FIELD_TYPE_SUBCOMPONENT:
-        inspect_component( ecs, field, field_def->name, get_info_for_component_type( field_def->subcomponent_name ) );
+        inspect_component( ecs, field, NULL, field_def->name, get_info_for_component_type( field_def->subcomponent_name ) );
         return;
     }
 
     PANIC("Unhandled field type in inspect_field");
 }
 
-static void inspect_component( ECS *ecs, void *component, const char *label, const ComponentInfo *info )
+static void inspect_component( ECS *ecs, void *component, void *cold, const char *label, const ComponentInfo *info )
 {
     if (label)
     {
@@ -138,7 +145,7 @@ static void inspect_component( ECS *ecs, void *component, const char *label, con
         if( ( field->flags & COMPONENT_FLAG_HIDDEN ) == 0 )
         {
             igPushIDInt( i );
-            inspect_field( ecs, (uint8_t*)component + field->offset, field );
+            inspect_field( ecs, component_field_ptr( component, cold, field ), field );
             igPopID();
         }
     }
@@ -146,6 +153,22 @@ static void inspect_component( ECS *ecs, void *component, const char *label, con
     igPopID();
 }
 
+static void register_soa_component( ECS *ecs, const ComponentInfo *info )
+{
+    ECSSoaField fields[ECS_MAX_SOA_FIELDS];
+    size_t field_count = 0;
+
+    for( size_t i = 0; i < info->num_fields; ++i )
+    {
+        if( info->fields[i].flags & COMPONENT_FLAG_COLD ) continue;
+        if( field_count == ECS_MAX_SOA_FIELDS ) PANIC( "Too many fields in structure of arrays component '%s'\n", info->name );
+
+        fields[field_count++] = (ECSSoaField){ info->fields[i].offset, info->fields[i].size };
+    }
+
+    ecs_register_soa_component( ecs, info->id, info->name, info->size, field_count, fields );
+}
+
 ECS *components_ecs_new( void )
 {
     ECS *ecs = ecs_new();
@@ -153,17 +176,89 @@ ECS *components_ecs_new( void )
     for( int i = 0; i < COMPONENTS_TOTAL_COUNT; ++i )
     {
         const ComponentInfo *info = COMPONENTS_ALL_INFOS[i];
-        ecs_register_component( ecs, info->name, info->size, info->destructor );
+        if( info->flags & COMPONENT_FLAG_TAG )
+            ecs_register_tag( ecs, info->id, info->name );
+        else if( info->flags & COMPONENT_FLAG_SINGLETON )
+            ecs_register_singleton_component( ecs, info->id, info->name, info->size, info->destructor );
+        else if( info->flags & COMPONENT_FLAG_SOA )
+            register_soa_component( ecs, info );
+        else
+            ecs_register_component( ecs, info->id, info->name, info->size, info->destructor );
+    }
+
+    for( int i = 0; i < COMPONENTS_TOTAL_COUNT; ++i )
+    {
+        const ComponentInfo *info = COMPONENTS_ALL_INFOS[i];
+        if( info->cold )
+            ecs_register_side_table( ecs, info->id, info->cold->id, info->cold->prototype );
     }
 
+    ECS_REGISTER_GROUP( ecs, MeshRenderer, Transform );
+    ECS_REGISTER_QUERY( ecs, MeshCollider, Transform );
+    ECS_REGISTER_QUERY( ecs, Camera, Transform );
+
+    ecs_set_deferred_change_events( ecs, true );
+
     return ecs;
 }
 
+static bool entity_has_component( const ECS *ecs, Entity e, const ComponentInfo *info )
+{
+    return ecs_has_component( ecs, e, info->id );
+}
+
+// Structure-of-arrays components have no address of their own, so for those these work on a copy gathered in to
+// a temporary, which return_component scatters back and frees. Everything else is borrowed in place.
+static void *borrow_component( ECS *ecs, Entity e, const ComponentInfo *info )
+{
+    if( !( info->flags & COMPONENT_FLAG_SOA ) )
+        return ecs_borrow_component( ecs, e, info->id, __FILE__, __LINE__ );
+
+    ECSSoaRef ref = ecs_borrow_soa_component( ecs, e, info->id, __FILE__, __LINE__ );
+    if( !ref.page ) return NULL;
+
+    void *copy = malloc( info->size );
+    ecs_read_soa_component( ecs, info->id, ref, copy );
+    return copy;
+}
+
+static void return_component( ECS *ecs, Entity e, const ComponentInfo *info, void *component )
+{
+    if( !( info->flags & COMPONENT_FLAG_SOA ) )
+    {
+        ecs_return_component( ecs, component, __FILE__, __LINE__ );
+        return;
+    }
+
+    if( !component ) return;
+
+    ECSSoaRef ref = ecs_view_soa_component( ecs, e, info->id );
+    ecs_write_soa_component( ecs, info->id, ref, component );
+    ecs_return_soa_component( ecs, ref, __FILE__, __LINE__ );
+    free( component );
+}
+
+// As above for reading only; *out_copy is set to any temporary, for the caller to free.
+static const void *view_component( const ECS *ecs, Entity e, const ComponentInfo *info, void **out_copy )
+{
+    *out_copy = NULL;
+
+    if( !( info->flags & COMPONENT_FLAG_SOA ) )
+        return ecs_view_component( ecs, e, info->id );
+
+    ECSSoaRef ref = ecs_view_soa_component( ecs, e, info->id );
+    if( !ref.page ) return NULL;
+
+    *out_copy = malloc( info->size );
+    ecs_read_soa_component( ecs, info->id, ref, *out_copy );
+    return *out_copy;
+}
+
 const char *components_name_entity( const ECS *ecs, Entity e, bool *name_from_transform )
 {
     if( !e ) return "empty";
 
-    ECS_VIEW_COMPONENT_DECL( Transform, t, ecs, e );
+    ECS_VIEW_COMPONENT_DECL( TransformCold, t, ecs, e );
     if( t && t->name && strlen( t->name ) )
     {
         *name_from_transform = true;
@@ -173,12 +268,31 @@ const char *components_name_entity( const ECS *ecs, Entity e, bool *name_from_tr
     *name_from_transform = false;
 
     for( int i = 0; i < COMPONENTS_TOTAL_COUNT; ++i )
-        if( ecs_view_component( ecs, e, COMPONENTS_ALL_INFOS[i]->name ) )
-            return COMPONENTS_ALL_INFOS[i]->name;
+    {
+        const ComponentInfo *info = COMPONENTS_ALL_INFOS[i];
+        if( !( info->flags & COMPONENT_FLAG_COLD ) && entity_has_component( ecs, e, info ) )
+            return info->name;
+    }
 
     return "empty";
 }
 
+// Cold fields are left to the side table, which is destructed and copied as a component of its own.
+// Vec fields are a SmallVec when flagged COMPONENT_FLAG_SMALL_VEC, and a Vec otherwise.
+static size_t vec_field_count( const void *field_ptr, const ComponentField *field )
+{
+    return field->flags & COMPONENT_FLAG_SMALL_VEC
+        ? ((const SmallVec*)field_ptr)->item_count
+        : ((const Vec*)field_ptr)->item_count;
+}
+
+static void *vec_field_at( void *field_ptr, const ComponentField *field, size_t index )
+{
+    return field->flags & COMPONENT_FLAG_SMALL_VEC
+        ? small_vec_at( field_ptr, index )
+        : vec_at( field_ptr, index );
+}
+
 void components_generic_destruct( const ComponentInfo *info, void *component )
 {
     for( int i = 0; i < info->num_fields; ++i )
@@ -186,22 +300,27 @@ void components_generic_destruct( const ComponentInfo *info, void *component )
         const ComponentField *field = &info->fields[i];
         void *field_ptr = (uint8_t*)component + field->offset;
 
+        if( field->flags & COMPONENT_FLAG_COLD ) continue;
+
         if( field->flags & COMPONENT_FLAG_IS_VEC )
         {
-            Vec *vec = (Vec*)field_ptr;
+            size_t count = vec_field_count( field_ptr, field );
 
             if( field->type == COMPONENT_FIELD_TYPE_SUBCOMPONENT )
             {
-                for( int i = 0; i < vec->item_count; ++i )
-                    components_generic_destruct( get_info_for_component_type( field->subcomponent_name ), vec_at( vec, i ) );
+                for( int i = 0; i < count; ++i )
+                    components_generic_destruct( get_info_for_component_type( field->subcomponent_name ), vec_field_at( field_ptr, field, i ) );
             }
             else if( field->type == COMPONENT_FIELD_TYPE_STRING )
             {
-                for( int i = 0; i < vec->item_count; ++i )
-                    free( *(char**)vec_at( vec, i ) );
+                for( int i = 0; i < count; ++i )
+                    free( *(char**)vec_field_at( field_ptr, field, i ) );
             }
 
-            vec_clear( vec );
+            if( field->flags & COMPONENT_FLAG_SMALL_VEC )
+                small_vec_clear( field_ptr );
+            else
+                vec_clear( field_ptr );
         }
         else if( field->type == COMPONENT_FIELD_TYPE_SUBCOMPONENT )
         {
@@ -216,15 +335,88 @@ void components_generic_destruct( const ComponentInfo *info, void *component )
     }
 }
 
+// Replaces the memory a bytewise copy of a component shares with the original with copies of its own.
+void components_generic_deep_copy( const ComponentInfo *info, void *component )
+{
+    for( int i = 0; i < info->num_fields; ++i )
+    {
+        const ComponentField *field = &info->fields[i];
+        void *field_ptr = (uint8_t*)component + field->offset;
+
+        if( field->flags & COMPONENT_FLAG_COLD ) continue;
+
+        if( field->flags & COMPONENT_FLAG_IS_VEC )
+        {
+            if( field->flags & COMPONENT_FLAG_SMALL_VEC )
+                small_vec_deep_copy( field_ptr );
+            else
+                *(Vec*)field_ptr = vec_clone( field_ptr );
+
+            size_t count = vec_field_count( field_ptr, field );
+
+            if( field->type == COMPONENT_FIELD_TYPE_SUBCOMPONENT )
+            {
+                for( int i = 0; i < count; ++i )
+                    components_generic_deep_copy( get_info_for_component_type( field->subcomponent_name ), vec_field_at( field_ptr, field, i ) );
+            }
+            else if( field->type == COMPONENT_FIELD_TYPE_STRING )
+            {
+                for( int i = 0; i < count; ++i )
+                {
+                    char **string = vec_field_at( field_ptr, field, i );
+                    if( *string ) *string = strdup( *string );
+                }
+            }
+        }
+        else if( field->type == COMPONENT_FIELD_TYPE_SUBCOMPONENT )
+        {
+            components_generic_deep_copy( get_info_for_component_type( field->subcomponent_name ), field_ptr );
+        }
+        else if( field->type == COMPONENT_FIELD_TYPE_STRING )
+        {
+            char **string = (char**)field_ptr;
+            if( *string ) *string = strdup( *string );
+        }
+    }
+}
+
+static void deep_copy_components( ECSComponentID component_id, void *components, size_t count )
+{
+    const ComponentInfo *info = COMPONENTS_ALL_INFOS[component_id];
+
+    for( size_t i = 0; i < count; ++i )
+        components_generic_deep_copy( info, (uint8_t*)components + i * info->size );
+}
+
+ECS *components_clone_ecs( const ECS *ecs )
+{
+    return ecs_clone( ecs, deep_copy_components );
+}
+
+// Returns the borrowed component, or NULL for tags, which have no data to fill in.
 static void *add_component_if_missing( ECS *ecs, Entity e, const char *type_name )
 {
-    void *comp =  ecs_borrow_component( ecs, e, type_name, __FILE__, __LINE__ );
+    const ComponentInfo *info = get_info_for_component_type( type_name );
+    if( info->flags & COMPONENT_FLAG_TAG )
+    {
+        ecs_add_tag( ecs, e, info->id );
+        return NULL;
+    }
+
+    if( info->flags & COMPONENT_FLAG_SOA )
+    {
+        if( !entity_has_component( ecs, e, info ) )
+            ecs_add_components( ecs, 1, &e, info->id, info->prototype );
+
+        return borrow_component( ecs, e, info );
+    }
+
+    void *comp =  ecs_borrow_component_by_name( ecs, e, type_name, __FILE__, __LINE__ );
 
     if( !comp )
     {
-        comp = ecs_add_component_zeroed( ecs, e, type_name, __FILE__, __LINE__ );
-        const ComponentInfo *comp_info = get_info_for_component_type( type_name );
-        memcpy( comp, comp_info->prototype, comp_info->size );
+        comp = ecs_add_component_zeroed_by_name( ecs, e, type_name, __FILE__, __LINE__ );
+        memcpy( comp, info->prototype, info->size );
     }
 
     return comp;
@@ -249,30 +441,62 @@ void components_inspect_entity( ECS *ecs, Entity e )
     igSameLine( 0, -1 );
 
     if( igButton( "Add Component", (ImVec2){ 0, 0 } ) )
-        add_component_if_missing( ecs, e, visible_components[selected_component] );
+    {
+        // A singleton can only be moved to another entity by removing it first
+        const ComponentInfo *info = get_info_for_component_type( visible_components[selected_component] );
+        if( !( info->flags & COMPONENT_FLAG_SINGLETON ) || !ecs_view_singleton( ecs, info->id, NULL ) )
+            return_component( ecs, e, info, add_component_if_missing( ecs, e, info->name ) );
+    }
 
     igSeparator();
 
     for( int i = 0; i < COMPONENTS_TOTAL_COUNT; ++i )
     {
         const ComponentInfo *info = COMPONENTS_ALL_INFOS[i];
+        if( info->flags & COMPONENT_FLAG_COLD ) continue;
 
         bool keep_alive = true;
-        void *component = ecs_borrow_component( ecs, e, info->name, __FILE__, __LINE__ );
 
-        if( component && igCollapsingHeaderBoolPtr( info->name, &keep_alive, ImGuiTreeNodeFlags_DefaultOpen ) )
-            inspect_component( ecs, component, NULL, info );
+        if( info->flags & COMPONENT_FLAG_TAG )
+        {
+            if( ecs_has_tag( ecs, e, info->id ) )
+                igCollapsingHeaderBoolPtr( info->name, &keep_alive, ImGuiTreeNodeFlags_Leaf );
+        }
+        else
+        {
+            void *component = borrow_component( ecs, e, info );
+            void *cold = component && info->cold ? ecs_borrow_component( ecs, e, info->cold->id, __FILE__, __LINE__ ) : NULL;
 
-        ecs_return_component( ecs, component, __FILE__, __LINE__ );
+            if( component && igCollapsingHeaderBoolPtr( info->name, &keep_alive, ImGuiTreeNodeFlags_DefaultOpen ) )
+                inspect_component( ecs, component, cold, NULL, info );
+
+            ecs_return_component( ecs, cold, __FILE__, __LINE__ );
+            return_component( ecs, e, info, component );
+        }
 
         if (! keep_alive)
-            ecs_remove_component( ecs, e, info->name );
+            ecs_remove_component( ecs, e, info->id );
     }
 }
 
-static void serialize_component( cJSON *obj, const void *component, const ComponentInfo *info, bool nested );
+// Scenes refer to entities by their position in the file rather than by handle. Handles carry a 32 bit
+// generation in their upper bits, which JSON numbers can't hold exactly, and positions keep files stable.
+static void entity_key( Entity e, char *out_key )
+{
+    sprintf( out_key, "%" PRIu64, e );
+}
+
+static double scene_id_for_entity( const HashTable *ids_for_entities, Entity e )
+{
+    char key[32];
+    entity_key( e, key );
+    const double *id = hashtable_at_const( ids_for_entities, key );
+    return id ? *id : 0.0;
+}
+
+static void serialize_component( cJSON *obj, const void *component, const void *cold, const ComponentInfo *info, bool nested, const HashTable *ids_for_entities );
 
-static cJSON *serialize_field( void *field, const ComponentField *field_def )
+static cJSON *serialize_field( void *field, const ComponentField *field_def, const HashTable *ids_for_entities )
 {
     switch( field_def->type )
     {
@@ -284,26 +508,26 @@ static cJSON *serialize_field( void *field, const ComponentField *field_def )
     case COMPONENT_FIELD_TYPE_VEC4:   return cJSON_CreateFloatArray((float*)(*(vec4*)field), 4);
     case COMPONENT_FIELD_TYPE_VERSOR: return cJSON_CreateFloatArray((float*)(*(versor*)field), 4);
     case COMPONENT_FIELD_TYPE_MAT4:   return cJSON_CreateFloatArray((float*)(*(mat4*)field), 16);
-    case COMPONENT_FIELD_TYPE_ENTITY: return cJSON_CreateNumber((double)(*(Entity*)field));
+    case COMPONENT_FIELD_TYPE_ENTITY: return cJSON_CreateNumber(scene_id_for_entity(ids_for_entities, *(Entity*)field));
     case COMPONENT_FIELD_TYPE_STRING: return cJSON_CreateString(*(char**)field);
 
     case COMPONENT_FIELD_TYPE_SUBCOMPONENT: {}
         cJSON *obj = cJSON_CreateObject();
-        serialize_component( obj, field, get_info_for_component_type( field_def->subcomponent_name ), true );
+        serialize_component( obj, field, NULL, get_info_for_component_type( field_def->subcomponent_name ), true, ids_for_entities );
         return obj;
     }
 
     PANIC("Unhandled field type in serialize_field");
 }
 
-static void serialize_component( cJSON *obj, const void *component, const ComponentInfo *info, bool nested )
+static void serialize_component( cJSON *obj, const void *component, const void *cold, const ComponentInfo *info, bool nested, const HashTable *ids_for_entities )
 {
     cJSON *comp_obj = nested ? obj : cJSON_AddObjectToObject( obj, info->name );
 
     for( int i = 0; i < info->num_fields; ++i )
     {
         const ComponentField *field = &info->fields[i];
-        void *field_ptr = (uint8_t*)component + field->offset;
+        void *field_ptr = component_field_ptr( (void*)component, (void*)cold, field );
 
         if( field->flags & COMPONENT_FLAG_DONT_SERIALIZE || field->type == COMPONENT_FIELD_TYPE_POINTER ) continue;
 
@@ -313,12 +537,12 @@ static void serialize_component( cJSON *obj, const void *component, const Compon
         }
         else
         {
-            cJSON_AddItemToObject( comp_obj, field->name, serialize_field( field_ptr, field ) );
+            cJSON_AddItemToObject( comp_obj, field->name, serialize_field( field_ptr, field, ids_for_entities ) );
         }
     }
 }
 
-static void deserialize_nested_component( cJSON *item, void *out, const ComponentInfo *info, HashTable *entities_for_ids );
+static void deserialize_nested_component( cJSON *item, void *out, void *out_cold, const ComponentInfo *info, HashTable *entities_for_ids );
 
 static void deserialize_field( cJSON *item, void *out, HashTable *entities_for_ids, const ComponentField *field_def )
 {
@@ -337,13 +561,15 @@ static void deserialize_field( cJSON *item, void *out, HashTable *entities_for_i
     case COMPONENT_FIELD_TYPE_ENTITY: {}
         char id_as_str_buf[128];
         sprintf( id_as_str_buf, "%f", item->valuedouble );
-        *(Entity*)out = *(Entity*)hashtable_at( entities_for_ids, id_as_str_buf );
+        const Entity *mapped = hashtable_at( entities_for_ids, id_as_str_buf );
+        *(Entity*)out = mapped ? *mapped : 0;
         return;
 
     case COMPONENT_FIELD_TYPE_SUBCOMPONENT:
         deserialize_nested_component(
             cJSON_GetObjectItem( item, field_def->name ),
             out,
+            NULL,
             get_info_for_component_type( field_def->subcomponent_name ),
             entities_for_ids
         );
@@ -353,13 +579,13 @@ static void deserialize_field( cJSON *item, void *out, HashTable *entities_for_i
     PANIC("Unhandled field type in deserialize_field");
 }
 
-static void deserialize_nested_component( cJSON *item, void *out, const ComponentInfo *info, HashTable *entities_for_ids )
+static void deserialize_nested_component( cJSON *item, void *out, void *out_cold, const ComponentInfo *info, HashTable *entities_for_ids )
 {
     const ComponentField *field;
     for( int i = 0; i < info->num_fields; ++i )
     {
         field = &info->fields[i];
-        void *field_ptr = (uint8_t*)out + field->offset;
+        void *field_ptr = component_field_ptr( out, out_cold, field );
 
         if( field->flags & COMPONENT_FLAG_DONT_SERIALIZE || field->type == COMPONENT_FIELD_TYPE_POINTER ) continue;
 
@@ -377,8 +603,21 @@ static void deserialize_nested_component( cJSON *item, void *out, const Componen
 static void deserialize_component( ECS *ecs, cJSON *component_obj, Entity entity, const ComponentInfo *info, HashTable *entities_for_ids )
 {
     void *comp = add_component_if_missing( ecs, entity, info->name );
-    deserialize_nested_component( component_obj, comp, info, entities_for_ids );
-    ecs_return_component( ecs, comp, __FILE__, __LINE__ );
+    void *cold = info->cold ? ecs_borrow_component( ecs, entity, info->cold->id, __FILE__, __LINE__ ) : NULL;
+    deserialize_nested_component( component_obj, comp, cold, info, entities_for_ids );
+    ecs_return_component( ecs, cold, __FILE__, __LINE__ );
+    return_component( ecs, entity, info, comp );
+}
+
+static bool has_serialized_components( const ECS *ecs, Entity e )
+{
+    for( int i = 0; i < COMPONENTS_TOTAL_COUNT; ++i )
+    {
+        if( COMPONENTS_ALL_INFOS[i]->flags & COMPONENT_FLAG_DONT_SERIALIZE ) continue;
+        if( entity_has_component( ecs, e, COMPONENTS_ALL_INFOS[i] ) ) return true;
+    }
+
+    return false;
 }
 
 char *components_serialize_scene_alloc( const ECS *ecs )
@@ -386,32 +625,56 @@ char *components_serialize_scene_alloc( const ECS *ecs )
     cJSON *json = cJSON_CreateArray();
     size_t num_entities;
     Entity *entities = ecs_find_all_entities_alloc( ecs, &num_entities );
+    HashTable ids_for_entities = hashtable_empty( 1024, sizeof( double ) );
+    char key[32];
+
+    // Empty entities aren't written, so only entities with components get an ID, and references to anything
+    // else are written as 0.
+    double next_id = 1.0;
+    for( int i = 0; i < num_entities; ++i )
+    {
+        if( !has_serialized_components( ecs, entities[i] ) ) continue;
+
+        entity_key( entities[i], key );
+        hashtable_set_copy( &ids_for_entities, key, &next_id );
+        next_id += 1.0;
+    }
 
     for( int i = 0; i < num_entities; ++i )
     {
-        bool empty = true;
+        double id = scene_id_for_entity( &ids_for_entities, entities[i] );
+        if( id == 0.0 ) continue;
+
         cJSON *obj = cJSON_CreateObject();
-        cJSON_AddNumberToObject( obj, "_id", (double)entities[i] );
+        cJSON_AddNumberToObject( obj, "_id", id );
 
         for( int j = 0; j < COMPONENTS_TOTAL_COUNT; ++j )
         {
             if( COMPONENTS_ALL_INFOS[j]->flags & COMPONENT_FLAG_DONT_SERIALIZE ) continue;
 
-            const void *component = ecs_view_component( ecs, entities[i], COMPONENTS_ALL_INFOS[j]->name );
-            if( component )
+            if( COMPONENTS_ALL_INFOS[j]->flags & COMPONENT_FLAG_TAG )
             {
-                serialize_component( obj, component, COMPONENTS_ALL_INFOS[j], false );
-                empty = false;
+                if( ecs_has_tag( ecs, entities[i], COMPONENTS_ALL_INFOS[j]->id ) )
+                    cJSON_AddItemToObject( obj, COMPONENTS_ALL_INFOS[j]->name, cJSON_CreateTrue() );
+                continue;
             }
+
+            const ComponentInfo *info = COMPONENTS_ALL_INFOS[j];
+            void *copy;
+            const void *component = view_component( ecs, entities[i], info, &copy );
+            const void *cold = info->cold ? ecs_view_component( ecs, entities[i], info->cold->id ) : NULL;
+
+            if( component )
+                serialize_component( obj, component, cold, info, false, &ids_for_entities );
+
+            free( copy );
         }
 
-        if( empty )
-            cJSON_Delete( obj );
-        else
-            cJSON_AddItemToArray( json, obj );
+        cJSON_AddItemToArray( json, obj );
     }
 
     char *result = cJSON_Print( json );
+    hashtable_clear( &ids_for_entities );
     free( entities );
     cJSON_Delete( json );
     return result;
@@ -429,13 +692,19 @@ ECS *components_deserialize_scene_alloc( const char *json_scene )
     sprintf( id_as_str_buf, "%f", 0.0 );
     hashtable_set_copy( &entities_for_ids, id_as_str_buf, &empty_entity );
 
+    size_t entity_count = cJSON_GetArraySize( json );
+    Entity *new_entities = malloc( entity_count * sizeof( Entity ) );
+    ecs_create_entities( result, entity_count, new_entities );
+
+    int entity_index = 0;
     cJSON_ArrayForEach( entity_obj, json )
     {
         sprintf( id_as_str_buf, "%f", cJSON_GetObjectItem( entity_obj, "_id" )->valuedouble );
-        Entity new_entity = ecs_create_entity( result );
-        hashtable_set_copy( &entities_for_ids, id_as_str_buf, &new_entity );
+        hashtable_set_copy( &entities_for_ids, id_as_str_buf, &new_entities[entity_index++] );
     }
 
+    free( new_entities );
+
     cJSON_ArrayForEach( entity_obj, json )
     {
         sprintf( id_as_str_buf, "%f", cJSON_GetObjectItem( entity_obj, "_id" )->valuedouble );
@@ -27,6 +27,11 @@ typedef enum ComponentFlags
     COMPONENT_FLAG_IS_VEC         = 0x01,
     COMPONENT_FLAG_HIDDEN         = 0x02,
     COMPONENT_FLAG_DONT_SERIALIZE = 0x04,
+    COMPONENT_FLAG_SINGLETON      = 0x08,
+    COMPONENT_FLAG_TAG            = 0x10,
+    COMPONENT_FLAG_COLD           = 0x20, // on a field it lives in the side table, on a type it is a side table
+    COMPONENT_FLAG_SOA            = 0x40, // stored as a structure of arrays, see ecs_register_soa_component
+    COMPONENT_FLAG_SMALL_VEC      = 0x80, // with COMPONENT_FLAG_IS_VEC, the field is a SmallVec rather than a Vec
 }
 ComponentFlags;
 
@@ -37,16 +42,19 @@ typedef struct ComponentField
     ComponentFlags flags;
     const char *subcomponent_name;
     size_t offset;
+    size_t size;
 }
 ComponentField;
 
 typedef struct ComponentInfo
 {
     const char *name;
+    ECSComponentID id;
     size_t size;
     const void *prototype;
     ECSComponentDestructor destructor;
     ComponentFlags flags;
+    const struct ComponentInfo *cold; // side table holding the fields flagged cold, or NULL
     size_t num_fields;
     ComponentField fields[];
 }
@@ -62,5 +70,7 @@ extern void components_inspector_provide_entity( Entity e );
 
 extern char *components_serialize_scene_alloc( const ECS *ecs );
 extern ECS *components_deserialize_scene_alloc( const char *json_scene );
+extern ECS *components_clone_ecs( const ECS *ecs );
 
-extern void components_generic_destruct( const ComponentInfo *info, void *component );
\ No newline at end of file
+extern void components_generic_destruct( const ComponentInfo *info, void *component );
+extern void components_generic_deep_copy( const ComponentInfo *info, void *component );
\ No newline at end of file
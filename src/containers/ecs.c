@@ -9,6 +9,14 @@
 #include "vec.h"
 #include "hashtable.h"
 
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define ECS_BITSET_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define ECS_BITSET_SSE2
+#endif
+
 
 typedef struct GenerationalIndex
 {
@@ -17,23 +25,132 @@ typedef struct GenerationalIndex
 }
 GenerationalIndex;
 
-typedef struct AllocatorEntry
-{
-    bool is_live;
-    uint32_t generation;
-}
-AllocatorEntry;
+// Typed accessors for the tables walked on every lookup and query step.
+VEC_DECLARE(uint32_t)
+VEC_DECLARE(GenerationalIndex)
+VEC_DECLARE(ECSTick)
+
+// Entities pack the index + 1 in the low 32 bits, so the largest index must leave room for the + 1.
+#define ECS_MAX_ENTITY_COUNT 0xFFFFFFFF
 
+// Liveness is kept in a bitset beside the generations rather than as a flag in each entry, so an index costs
+// 4 bytes and a bit instead of a padded 8 byte struct, and walks over live indices can skip 64 dead ones at once.
 typedef struct GenerationalIndexAllocator
 {
-    Vec entries; // Vec of AllocatorEntry
-    Vec free_indices; // Vec of uint32_t
+    Vec generations; // of uint32_t, the current generation of each index
+    Vec live_bits; // of uint64_t, bit i is set while index i is allocated
+    Vec free_indices; // of uint32_t
+    uint32_t first_generation; // for new indices, above that of any index compaction has trimmed away
 }
 GenerationalIndexAllocator;
 
+// Bitsets are Vecs of uint64_t words. Bits past the end of the Vec read as clear.
+static bool bitset_get(const Vec *bits, uint32_t index)
+{
+    if (index / 64 >= bits->item_count) return false;
+
+    return (*(const uint64_t*)vec_at_const(bits, index / 64) >> (index % 64)) & 1;
+}
+
+static void bitset_set(Vec *bits, uint32_t index, bool value)
+{
+    if (index / 64 >= bits->item_count)
+    {
+        if (!value) return;
+        vec_resize(bits, index / 64 + 1);
+    }
+
+    uint64_t *word = vec_at(bits, index / 64);
+    uint64_t bit = (uint64_t)1 << (index % 64);
+
+    *word = value ? *word | bit : *word & ~bit;
+}
+
+static uint64_t bitset_word(const Vec *bits, size_t word)
+{
+    return word < bits->item_count ? *(const uint64_t*)vec_at_const(bits, word) : 0;
+}
+
+#define ECS_BITSET_BLOCK_WORDS 4
+
+// Returns the 256 bit block starting at first_word, reading straight from the bitset unless the block runs
+// past its end, in which case it is copied to scratch and padded with clear bits.
+static const uint64_t *bitset_block(const Vec *bits, size_t first_word, uint64_t scratch[ECS_BITSET_BLOCK_WORDS])
+{
+    if (first_word + ECS_BITSET_BLOCK_WORDS <= bits->item_count)
+        return vec_at_const(bits, first_word);
+
+    for (size_t i = 0; i < ECS_BITSET_BLOCK_WORDS; ++i)
+        scratch[i] = bitset_word(bits, first_word + i);
+
+    return scratch;
+}
+
+// Intersects the same 256 bit block of several bitsets.
+static void bitset_and_blocks(size_t count, const Vec *const *bitsets, size_t first_word, uint64_t out[ECS_BITSET_BLOCK_WORDS])
+{
+    uint64_t scratch[ECS_BITSET_BLOCK_WORDS];
+    const uint64_t *block = bitset_block(bitsets[0], first_word, scratch);
+
+#if defined(ECS_BITSET_AVX2)
+    __m256i acc = _mm256_loadu_si256((const __m256i*)block);
+
+    for (size_t i = 1; i < count; ++i)
+        acc = _mm256_and_si256(acc, _mm256_loadu_si256((const __m256i*)bitset_block(bitsets[i], first_word, scratch)));
+
+    _mm256_storeu_si256((__m256i*)out, acc);
+#elif defined(ECS_BITSET_SSE2)
+    __m128i lo = _mm_loadu_si128((const __m128i*)block);
+    __m128i hi = _mm_loadu_si128((const __m128i*)(block + 2));
+
+    for (size_t i = 1; i < count; ++i)
+    {
+        block = bitset_block(bitsets[i], first_word, scratch);
+        lo = _mm_and_si128(lo, _mm_loadu_si128((const __m128i*)block));
+        hi = _mm_and_si128(hi, _mm_loadu_si128((const __m128i*)(block + 2)));
+    }
+
+    _mm_storeu_si128((__m128i*)out, lo);
+    _mm_storeu_si128((__m128i*)(out + 2), hi);
+#else
+    memcpy(out, block, sizeof(uint64_t) * ECS_BITSET_BLOCK_WORDS);
+
+    for (size_t i = 1; i < count; ++i)
+    {
+        block = bitset_block(bitsets[i], first_word, scratch);
+
+        for (size_t j = 0; j < ECS_BITSET_BLOCK_WORDS; ++j)
+            out[j] &= block[j];
+    }
+#endif
+}
+
+static void giallocator_resize(GenerationalIndexAllocator *gia, size_t count)
+{
+    if (count > ECS_MAX_ENTITY_COUNT)
+        PANIC("Tried to allocate more than %u entities\n", ECS_MAX_ENTITY_COUNT);
+
+    vec_resize(&gia->generations, count);
+    vec_resize(&gia->live_bits, (count + 63) / 64);
+}
+
 GenerationalIndexAllocator giallocator_empty(void)
 {
-    return (GenerationalIndexAllocator) { vec_empty(sizeof(AllocatorEntry)), vec_empty(sizeof(uint32_t)) };
+    return (GenerationalIndexAllocator) {
+        vec_empty(sizeof(uint32_t)),
+        vec_empty(sizeof(uint64_t)),
+        vec_empty(sizeof(uint32_t)),
+        0
+    };
+}
+
+// Marks a free or newly added index as live and returns its handle.
+static GenerationalIndex giallocator_revive(GenerationalIndexAllocator *gia, uint32_t index, uint32_t generation)
+{
+    *(uint32_t*)vec_at(&gia->generations, index) = generation;
+    bitset_set(&gia->live_bits, index, true);
+
+    return (GenerationalIndex) { generation, index };
 }
 
 GenerationalIndex giallocator_allocate(GenerationalIndexAllocator *gia)
@@ -43,34 +160,51 @@ GenerationalIndex giallocator_allocate(GenerationalIndexAllocator *gia)
         uint32_t index;
         vec_pop(&gia->free_indices, &index);
 
-        AllocatorEntry *entry = vec_at(&gia->entries, index);
-        entry->generation += 1;
-        entry->is_live = true;
+        uint32_t generation = *(uint32_t*)vec_at(&gia->generations, index);
+        return giallocator_revive(gia, index, generation + 1);
+    }
+
+    uint32_t index = (uint32_t)gia->generations.item_count;
+    giallocator_resize(gia, (size_t)index + 1);
+
+    return giallocator_revive(gia, index, gia->first_generation);
+}
+
+void giallocator_allocate_many(GenerationalIndexAllocator *gia, size_t count, GenerationalIndex *out_indices)
+{
+    size_t free_count = gia->free_indices.item_count;
+    size_t reused = count < free_count ? count : free_count;
+
+    for (size_t i = 0; i < reused; ++i)
+    {
+        uint32_t index = *(uint32_t*)vec_at(&gia->free_indices, free_count - 1 - i);
+        uint32_t generation = *(uint32_t*)vec_at(&gia->generations, index);
 
-        return (GenerationalIndex) { entry->generation, index };
+        out_indices[i] = giallocator_revive(gia, index, generation + 1);
     }
 
-    AllocatorEntry new_entry = (AllocatorEntry) { true, 0 };
-    vec_push_copy(&gia->entries, &new_entry);
+    vec_resize(&gia->free_indices, free_count - reused);
 
-    return (GenerationalIndex) { 0, (uint32_t)gia->entries.item_count - 1 };
+    size_t first_new = gia->generations.item_count;
+    giallocator_resize(gia, first_new + count - reused);
+
+    for (size_t i = reused; i < count; ++i)
+        out_indices[i] = giallocator_revive(gia, (uint32_t)(first_new + i - reused), gia->first_generation);
 }
 
 bool giallocator_is_index_live(const GenerationalIndexAllocator *gia, GenerationalIndex index)
 {
-    if (index.index >= gia->entries.item_count) return false;
-
-    const AllocatorEntry *entry = vec_at_const(&gia->entries, index.index);
+    if (index.index >= gia->generations.item_count) return false;
 
-    return entry->is_live && entry->generation == index.generation;
+    return bitset_get(&gia->live_bits, index.index)
+        && vec_uint32_t_get(&gia->generations, index.index) == index.generation;
 }
 
 bool giallocator_deallocate(GenerationalIndexAllocator *gia, GenerationalIndex index)
 {
     if (!giallocator_is_index_live(gia, index)) return false;
 
-    AllocatorEntry *entry = vec_at(&gia->entries, index.index);
-    entry->is_live = false;
+    bitset_set(&gia->live_bits, index.index, false);
 
     uint32_t x = index.index;
     vec_push_copy(&gia->free_indices, &x);
@@ -78,16 +212,31 @@ bool giallocator_deallocate(GenerationalIndexAllocator *gia, GenerationalIndex i
     return true;
 }
 
+void giallocator_deallocate_many(GenerationalIndexAllocator *gia, size_t count, const GenerationalIndex *indices)
+{
+    size_t free_count = gia->free_indices.item_count;
+    vec_resize(&gia->free_indices, free_count + count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!giallocator_is_index_live(gia, indices[i])) continue;
+
+        bitset_set(&gia->live_bits, indices[i].index, false);
+        vec_set_copy(&gia->free_indices, free_count++, &indices[i].index);
+    }
+
+    vec_resize(&gia->free_indices, free_count);
+}
+
 GenerationalIndex *giallocator_get_all_allocated_indices_alloc(const GenerationalIndexAllocator *gia, size_t *result_length)
 {
     Vec result = vec_empty(sizeof(GenerationalIndex));
 
-    for (int i = 0; i < gia->entries.item_count; ++i)
+    for (uint32_t i = 0; i < gia->generations.item_count; ++i)
     {
-        const AllocatorEntry *entry = vec_at_const(&gia->entries, i);
-        if (!entry->is_live) continue;
+        if (!bitset_get(&gia->live_bits, i)) continue;
 
-        GenerationalIndex index = { entry->generation, i };
+        GenerationalIndex index = { *(const uint32_t*)vec_at_const(&gia->generations, i), i };
         vec_push_copy(&result, &index);
     }
 
@@ -95,89 +244,373 @@ GenerationalIndex *giallocator_get_all_allocated_indices_alloc(const Generationa
     return result.data;
 }
 
-void giallocator_clear(GenerationalIndexAllocator *gia)
+// Drops the dead indices at the end of the allocator. New indices start above every dropped generation, so
+// handles to dropped indices never become valid again.
+void giallocator_compact(GenerationalIndexAllocator *gia)
 {
-    vec_clear(&gia->entries);
-    vec_clear(&gia->free_indices);
+    size_t count = gia->generations.item_count;
+
+    while (count > 0 && !bitset_get(&gia->live_bits, (uint32_t)count - 1))
+    {
+        uint32_t generation = *(const uint32_t*)vec_at_const(&gia->generations, count - 1);
+
+        if (generation >= gia->first_generation)
+            gia->first_generation = generation + 1;
+
+        count--;
+    }
+
+    if (count == gia->generations.item_count) return;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < gia->free_indices.item_count; ++i)
+    {
+        uint32_t index = *(uint32_t*)vec_at(&gia->free_indices, i);
+        if (index < count) vec_set_copy(&gia->free_indices, kept++, &index);
+    }
+
+    vec_resize(&gia->free_indices, kept);
+    giallocator_resize(gia, count);
+
+    vec_shrink_to_fit(&gia->free_indices);
+    vec_shrink_to_fit(&gia->generations);
+    vec_shrink_to_fit(&gia->live_bits);
 }
 
-typedef struct GenerationalIndexArrayEntry
+void giallocator_clear(GenerationalIndexAllocator *gia)
 {
-    bool has_value;
-    uint32_t generation;
-    uint8_t entry[];
+    vec_clear(&gia->generations);
+    vec_clear(&gia->live_bits);
+    vec_clear(&gia->free_indices);
 }
-GenerationalIndexArrayEntry;
 
+#define ECS_PAGE_OCCUPANCY_WORDS (ECS_PAGE_ITEM_COUNT / 64)
+
+// GenerationalIndexArray is a sparse set: the generational indices that have items are packed densely, and a
+// sparse table maps each entity index to its dense slot. Iteration only touches the indices that have items,
+// and removal swaps the last index in to the hole. The items themselves live in fixed size pages found through
+// a directory indexed by entity index, so an item never moves while it exists, however the store grows or is
+// reordered. Pages are allocated when first used and freed by compaction once empty.
+// Items with a structure-of-arrays layout are split across pages by field instead: each page holds one stream
+// per field, ECS_PAGE_ITEM_COUNT values long, one after another in field order.
 typedef struct GenerationalIndexArray
 {
     size_t item_size;
     ECSComponentDestructor destructor;
-    Vec entries; // Vec of (GenerationalIndexArrayEntry + item)
+    size_t field_count; // 0 unless items are stored as a structure of arrays
+    ECSSoaField fields[ECS_MAX_SOA_FIELDS];
+    size_t stream_offsets[ECS_MAX_SOA_FIELDS]; // from the start of a page
+    Vec sparse; // of uint32_t, dense slot + 1 for each index, or 0 if the index has no item
+    Vec dense_indices; // of GenerationalIndex
+    Vec dense_ticks; // of ECSTick, the tick each item last changed at, parallel to dense_indices
+    Vec pages; // of uint8_t*, ECS_PAGE_ITEM_COUNT items each, NULL where no index in the page has an item
+    Vec occupancy; // of uint64_t, bit i is set while index i has an item, so queries can intersect stores by word
 }
 GenerationalIndexArray;
 
 GenerationalIndexArray giarray_empty(size_t item_size, ECSComponentDestructor destructor)
 {
-    return (GenerationalIndexArray) { item_size, destructor, vec_empty(sizeof(GenerationalIndexArrayEntry) + item_size) };
+    return (GenerationalIndexArray) {
+        .item_size = item_size,
+        .destructor = destructor,
+        .sparse = vec_empty(sizeof(uint32_t)),
+        .dense_indices = vec_empty(sizeof(GenerationalIndex)),
+        .dense_ticks = vec_empty(sizeof(ECSTick)),
+        .pages = vec_empty(sizeof(uint8_t*)),
+        .occupancy = vec_empty(sizeof(uint64_t))
+    };
+}
+
+GenerationalIndexArray giarray_empty_soa(size_t item_size, size_t field_count, const ECSSoaField *fields)
+{
+    GenerationalIndexArray result = giarray_empty(item_size, NULL);
+    size_t stream_offset = 0;
+
+    result.field_count = field_count;
+
+    for (size_t i = 0; i < field_count; ++i)
+    {
+        result.fields[i] = fields[i];
+        result.stream_offsets[i] = stream_offset;
+        stream_offset += ECS_PAGE_ITEM_COUNT * fields[i].size;
+    }
+
+    return result;
+}
+
+// A structure-of-arrays item has no address of its own, so it is handled by its page address plus its lane.
+// That is unique while the item exists, and keeps the lane recoverable from the handle.
+static size_t giarray_item_stride(const GenerationalIndexArray *gia)
+{
+    return gia->field_count ? 1 : gia->item_size;
+}
+
+static uint8_t *giarray_page(const GenerationalIndexArray *gia, uint32_t index)
+{
+    return *(uint8_t *const *)vec_at_const(&gia->pages, index / ECS_PAGE_ITEM_COUNT);
+}
+
+// The index must have an item.
+static void *giarray_item(const GenerationalIndexArray *gia, uint32_t index)
+{
+    return giarray_page(gia, index) + (index % ECS_PAGE_ITEM_COUNT) * giarray_item_stride(gia);
+}
+
+// Scatters a struct across the field streams of a page. A NULL value zeroes every field.
+static void soa_write(const GenerationalIndexArray *gia, uint8_t *page, uint32_t lane, const void *value)
+{
+    for (size_t i = 0; i < gia->field_count; ++i)
+    {
+        uint8_t *field = page + gia->stream_offsets[i] + lane * gia->fields[i].size;
+
+        if (value)
+            memcpy(field, (const uint8_t*)value + gia->fields[i].offset, gia->fields[i].size);
+        else
+            memset(field, 0, gia->fields[i].size);
+    }
+}
+
+static void soa_read(const GenerationalIndexArray *gia, const uint8_t *page, uint32_t lane, void *out)
+{
+    for (size_t i = 0; i < gia->field_count; ++i)
+        memcpy((uint8_t*)out + gia->fields[i].offset, page + gia->stream_offsets[i] + lane * gia->fields[i].size, gia->fields[i].size);
+}
+
+// Copies value in to the item at index. A NULL value zeroes the item.
+static void giarray_write_item(GenerationalIndexArray *gia, uint32_t index, void *item, const void *value)
+{
+    if (gia->field_count)
+        soa_write(gia, giarray_page(gia, index), index % ECS_PAGE_ITEM_COUNT, value);
+    else if (value)
+        memcpy(item, value, gia->item_size);
+    else
+        memset(item, 0, gia->item_size);
+}
+
+static void *giarray_ensure_item(GenerationalIndexArray *gia, uint32_t index)
+{
+    size_t page_index = index / ECS_PAGE_ITEM_COUNT;
+
+    if (gia->pages.item_count <= page_index)
+        vec_resize(&gia->pages, page_index + 1);
+
+    uint8_t **page = vec_at(&gia->pages, page_index);
+    if (!*page) *page = malloc(ECS_PAGE_ITEM_COUNT * gia->item_size);
+
+    return *page + (index % ECS_PAGE_ITEM_COUNT) * giarray_item_stride(gia);
 }
 
-static void giarray_clear_callback(GenerationalIndexArray *context, GenerationalIndexArrayEntry *entry)
+static void giarray_free_pages(GenerationalIndexArray *gia)
 {
-    if (entry->has_value)
-        context->destructor(entry->entry);
+    for (size_t i = 0; i < gia->pages.item_count; ++i)
+        free(*(uint8_t**)vec_at(&gia->pages, i));
+
+    vec_clear(&gia->pages);
 }
 
 void giarray_clear(GenerationalIndexArray *gia)
 {
     if (gia->destructor)
-        vec_clear_with_callback(&gia->entries, gia, giarray_clear_callback);
-    else
-        vec_clear(&gia->entries);
+        for (size_t i = 0; i < gia->dense_indices.item_count; ++i)
+            gia->destructor(giarray_item(gia, ((GenerationalIndex*)vec_at(&gia->dense_indices, i))->index));
+
+    giarray_free_pages(gia);
+    vec_clear(&gia->dense_indices);
+    vec_clear(&gia->dense_ticks);
+    vec_clear(&gia->sparse);
+    vec_clear(&gia->occupancy);
+}
+
+static uint32_t giarray_dense_slot(const GenerationalIndexArray *gia, uint32_t index)
+{
+    if (index >= gia->sparse.item_count) return 0;
+    return vec_uint32_t_get(&gia->sparse, index);
 }
 
 void *giarray_set_copy_or_zeroed(GenerationalIndexArray *gia, GenerationalIndex index, const void *value)
 {
-    if (gia->entries.item_count <= index.index)
-        vec_resize(&gia->entries, index.index + 1);
+    if (gia->sparse.item_count <= index.index)
+        vec_resize(&gia->sparse, index.index + 1);
 
-    GenerationalIndexArrayEntry* entry = vec_at(&gia->entries, index.index);
+    uint32_t *slot = vec_at(&gia->sparse, index.index);
+    void *item;
 
-    if (gia->destructor && entry->has_value)
-        gia->destructor(entry->entry);
+    if (*slot)
+    {
+        item = giarray_item(gia, index.index);
 
-    entry->has_value = true;
-    entry->generation = index.generation;
+        if (gia->destructor)
+            gia->destructor(item);
 
-    if (value)
-        memcpy(entry->entry, value, gia->item_size);
+        vec_set_copy(&gia->dense_indices, *slot - 1, &index);
+    }
     else
-        memset(entry->entry, 0, gia->item_size);
+    {
+        vec_push_copy(&gia->dense_indices, &index);
+        vec_resize(&gia->dense_ticks, gia->dense_ticks.item_count + 1);
+        *slot = (uint32_t)gia->dense_indices.item_count;
+        item = giarray_ensure_item(gia, index.index);
+        bitset_set(&gia->occupancy, index.index, true);
+    }
+
+    giarray_write_item(gia, index.index, item, value);
 
-    return entry->entry;
+    return item;
 }
 
-void *giarray_at(GenerationalIndexArray *gia, GenerationalIndex index)
+// Shrinks the sparse table to end at the highest index which has an item, and frees pages left empty.
+void giarray_compact(GenerationalIndexArray *gia)
+{
+    size_t count = gia->sparse.item_count;
+
+    while (count > 0 && *(const uint32_t*)vec_at_const(&gia->sparse, count - 1) == 0)
+        count--;
+
+    if (count < gia->sparse.item_count)
+        vec_resize(&gia->sparse, count);
+
+    if ((count + 63) / 64 < gia->occupancy.item_count)
+        vec_resize(&gia->occupancy, (count + 63) / 64);
+
+    for (size_t i = 0; i < gia->pages.item_count; ++i)
+    {
+        uint8_t **page = vec_at(&gia->pages, i);
+        if (!*page) continue;
+
+        bool empty = true;
+        for (size_t w = 0; w < ECS_PAGE_OCCUPANCY_WORDS && empty; ++w)
+            empty = bitset_word(&gia->occupancy, i * ECS_PAGE_OCCUPANCY_WORDS + w) == 0;
+
+        if (empty)
+        {
+            free(*page);
+            *page = NULL;
+        }
+    }
+
+    size_t page_count = (count + ECS_PAGE_ITEM_COUNT - 1) / ECS_PAGE_ITEM_COUNT;
+    if (page_count < gia->pages.item_count)
+        vec_resize(&gia->pages, page_count);
+
+    vec_shrink_to_fit(&gia->sparse);
+    vec_shrink_to_fit(&gia->occupancy);
+    vec_shrink_to_fit(&gia->pages);
+    vec_shrink_to_fit(&gia->dense_indices);
+    vec_shrink_to_fit(&gia->dense_ticks);
+}
+
+// Sets every index to a copy of value, growing the storage once up front instead of once per item.
+void giarray_set_copy_many(GenerationalIndexArray *gia, size_t count, const GenerationalIndex *indices, const void *value)
 {
-    if (index.index >= gia->entries.item_count) return NULL;
+    uint32_t max_index = 0;
+    size_t new_count = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (indices[i].index > max_index) max_index = indices[i].index;
+        if (!giarray_dense_slot(gia, indices[i].index)) new_count++;
+    }
+
+    if (count > 0 && gia->sparse.item_count <= max_index)
+        vec_resize(&gia->sparse, max_index + 1);
+    if (count > 0 && gia->occupancy.item_count <= max_index / 64)
+        vec_resize(&gia->occupancy, max_index / 64 + 1);
+
+    size_t next = gia->dense_indices.item_count;
+    vec_resize(&gia->dense_indices, next + new_count);
+    vec_resize(&gia->dense_ticks, next + new_count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t *slot = vec_at(&gia->sparse, indices[i].index);
+        void *item;
+
+        if (*slot)
+        {
+            item = giarray_item(gia, indices[i].index);
+            if (gia->destructor) gia->destructor(item);
+        }
+        else
+        {
+            *slot = (uint32_t)++next;
+            item = giarray_ensure_item(gia, indices[i].index);
+            bitset_set(&gia->occupancy, indices[i].index, true);
+        }
+
+        vec_set_copy(&gia->dense_indices, *slot - 1, &indices[i]);
+        giarray_write_item(gia, indices[i].index, item, value);
+    }
 
-    GenerationalIndexArrayEntry* entry = vec_at(&gia->entries, index.index);
+    // Repeated indices reserve more slots than they use.
+    vec_resize(&gia->dense_indices, next);
+    vec_resize(&gia->dense_ticks, next);
+}
+
+void *giarray_at(GenerationalIndexArray *gia, GenerationalIndex index)
+{
+    uint32_t slot = giarray_dense_slot(gia, index.index);
+    if (!slot) return NULL;
 
-    return entry->has_value && entry->generation == index.generation
-        ? entry->entry
+    return vec_GenerationalIndex_at_const(&gia->dense_indices, slot - 1)->generation == index.generation
+        ? giarray_item(gia, index.index)
         : NULL;
 }
 
 void giarray_remove(GenerationalIndexArray *gia, GenerationalIndex index)
 {
-    if (index.index >= gia->entries.item_count) return;
+    uint32_t slot = giarray_dense_slot(gia, index.index);
+    if (!slot) return;
+
+    const GenerationalIndex *owner = vec_at_const(&gia->dense_indices, slot - 1);
+    if (owner->generation != index.generation) return;
+
+    if (gia->destructor)
+        gia->destructor(giarray_item(gia, index.index));
+
+    uint32_t last_slot = (uint32_t)gia->dense_indices.item_count;
+
+    if (slot != last_slot)
+    {
+        GenerationalIndex moved = *(GenerationalIndex*)vec_at(&gia->dense_indices, last_slot - 1);
+
+        vec_set_copy(&gia->dense_indices, slot - 1, &moved);
+        vec_set_copy(&gia->dense_ticks, slot - 1, vec_at(&gia->dense_ticks, last_slot - 1));
+        vec_set_copy(&gia->sparse, moved.index, &slot);
+    }
 
-    GenerationalIndexArrayEntry* entry = vec_at(&gia->entries, index.index);
+    vec_resize(&gia->dense_indices, last_slot - 1);
+    vec_resize(&gia->dense_ticks, last_slot - 1);
+    *(uint32_t*)vec_at(&gia->sparse, index.index) = 0;
+    bitset_set(&gia->occupancy, index.index, false);
+}
 
-    if (gia->destructor && entry->has_value)
-        gia->destructor(entry->entry);
+// Reorders the dense arrays only; the items stay where they are.
+void giarray_swap_dense(GenerationalIndexArray *gia, uint32_t a, uint32_t b)
+{
+    if (a == b) return;
+
+    GenerationalIndex *index_a = vec_at(&gia->dense_indices, a);
+    GenerationalIndex *index_b = vec_at(&gia->dense_indices, b);
+    GenerationalIndex temp_index = *index_a;
+    *index_a = *index_b;
+    *index_b = temp_index;
+
+    ECSTick *tick_a = vec_at(&gia->dense_ticks, a);
+    ECSTick *tick_b = vec_at(&gia->dense_ticks, b);
+    ECSTick temp_tick = *tick_a;
+    *tick_a = *tick_b;
+    *tick_b = temp_tick;
+
+    uint32_t slot_a = a + 1, slot_b = b + 1;
+    vec_set_copy(&gia->sparse, index_a->index, &slot_a);
+    vec_set_copy(&gia->sparse, index_b->index, &slot_b);
+}
 
-    entry->has_value = false;
+// Returns NULL when the index has no item, without checking its generation.
+static ECSTick *giarray_tick_at(GenerationalIndexArray *gia, uint32_t index)
+{
+    uint32_t slot = giarray_dense_slot(gia, index);
+    return slot ? vec_ECSTick_at(&gia->dense_ticks, slot - 1) : NULL;
 }
 
 GenerationalIndex *giarray_get_all_valid_indices_alloc(
@@ -185,111 +618,241 @@ GenerationalIndex *giarray_get_all_valid_indices_alloc(
 ){
     Vec result = vec_empty(sizeof(GenerationalIndex));
 
-    for (uint32_t i = 0; i < gia->entries.item_count; ++i)
+    for (size_t i = 0; i < gia->dense_indices.item_count; ++i)
     {
-        const GenerationalIndexArrayEntry* entry = vec_at_const(&gia->entries, i);
-        if (!entry->has_value) continue;
+        const GenerationalIndex *index = vec_at_const(&gia->dense_indices, i);
 
-        GenerationalIndex index = (GenerationalIndex) { entry->generation, i };
-
-        if (giallocator_is_index_live(allocator, index))
-            vec_push_copy(&result, &index);
+        if (giallocator_is_index_live(allocator, *index))
+            vec_push_copy(&result, index);
     }
 
     *result_length = result.item_count;
     return result.data;
 }
 
-bool giarray_get_first_valid_index(
-    const GenerationalIndexArray *gia, const GenerationalIndexAllocator *allocator, GenerationalIndex *result
-){
-    for (uint32_t i = 0; i < gia->entries.item_count; ++i)
-    {
-        const GenerationalIndexArrayEntry* entry = vec_at_const(&gia->entries, i);
-        if (!entry->has_value) continue;
-
-        GenerationalIndex index = (GenerationalIndex) { entry->generation, i };
-
-        if (giallocator_is_index_live(allocator, index))
-        {
-            *result = index;
-            return true;
-        }
-    }
-
-    return false;
-}
-
 typedef struct ECSComponent
 {
+    const char *name; // NULL for component IDs which have not been registered
     size_t size;
     ECSComponentDestructor destructor;
     GenerationalIndexArray components;
+    Vec event_listeners; // of EventListenerEntry
+    uint32_t group; // index in to ECS.groups + 1, or 0 if the component is not owned by a group
+    uint32_t side_table; // component ID + 1 of the side table which follows this component around, or 0
+    const void *side_table_prototype;
+    bool singleton; // at most one entity has this component, so it always sits in dense slot 0
+    bool tag; // carries no data, so membership lives in tag_bits and the component store stays empty
+    Vec tag_bits; // of uint64_t, for tags bit i is set while entity index i has the tag
+    Vec pending_changes; // of Entity, change events waiting for ecs_flush_change_events
+    Vec pending_bits; // of uint64_t, bit i is set while entity index i has a change waiting
 }
 ECSComponent;
 
+// A group owns the storage of a set of components, and keeps the entities which have all of them
+// packed in the same order at the front of each component's dense index and tick arrays. Iterating a
+// group then needs no membership checks, and change ticks are read from the dense position. The
+// components themselves stay in their pages at their entity index, so grouping never moves them, and
+// they are still fetched through the page directory.
+typedef struct ECSGroup
+{
+    size_t component_count;
+    ECSComponentID component_ids[ECS_MAX_QUERY_COMPONENTS];
+    uint32_t size;
+}
+ECSGroup;
+
+// A registered query keeps the entities which have all of its components in a dense list. Adding and removing
+// components updates the list straight away, so iterating it never has to filter or look anything up.
+typedef struct ECSCachedQuery
+{
+    size_t component_count;
+    ECSComponentID component_ids[ECS_MAX_QUERY_COMPONENTS];
+    Vec rows; // of GenerationalIndex, the matching entities in no particular order
+    Vec row_slots; // of uint32_t indexed by entity index, the row + 1 holding the entity or 0 if it does not match
+}
+ECSCachedQuery;
+
 typedef struct EventListenerEntry
 {
     ECSComponentEventType type;
-    ECSComponentEventListener listener;
+    ECSComponentEventListener listener; // exactly one of listener and batch_listener is set
+    ECSComponentBatchEventListener batch_listener;
 }
 EventListenerEntry;
 
 typedef struct BorrowedComponent
 {
+    const void *component; // NULL marks an empty slot in the BorrowSet
     Entity entity;
-    const char *type; // This should always be a string with a static lifetime.
-    const void *component;
+    ECSComponentID type;
     const char *debug_file;
     int debug_line;
 }
 BorrowedComponent;
 
+// Open addressed set of BorrowedComponent keyed by component pointer, using linear probing.
+typedef struct BorrowSet
+{
+    size_t capacity; // zero or a power of two
+    size_t count;
+    BorrowedComponent *slots;
+}
+BorrowSet;
+
+static BorrowSet borrowset_empty(void)
+{
+    return (BorrowSet) { 0, 0, NULL };
+}
+
+static size_t borrowset_home_slot(const BorrowSet *set, const void *component)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)component * 0x9E3779B97F4A7C15ull;
+    return (size_t)(hash >> 32) & (set->capacity - 1);
+}
+
+static BorrowedComponent *borrowset_find(BorrowSet *set, const void *component)
+{
+    if (set->count == 0) return NULL;
+
+    for (size_t i = borrowset_home_slot(set, component); set->slots[i].component; i = (i + 1) & (set->capacity - 1))
+        if (set->slots[i].component == component)
+            return &set->slots[i];
+
+    return NULL;
+}
+
+static void borrowset_insert(BorrowSet *set, const BorrowedComponent *borrow)
+{
+    if ((set->count + 1) * 2 > set->capacity)
+    {
+        BorrowSet grown = { set->capacity ? set->capacity * 2 : 16, 0, NULL };
+        grown.slots = calloc(grown.capacity, sizeof(BorrowedComponent));
+
+        for (size_t i = 0; i < set->capacity; ++i)
+            if (set->slots[i].component)
+                borrowset_insert(&grown, &set->slots[i]);
+
+        free(set->slots);
+        *set = grown;
+    }
+
+    size_t i = borrowset_home_slot(set, borrow->component);
+    while (set->slots[i].component)
+        i = (i + 1) & (set->capacity - 1);
+
+    set->slots[i] = *borrow;
+    set->count++;
+}
+
+static void borrowset_remove(BorrowSet *set, BorrowedComponent *borrow)
+{
+    size_t hole = (size_t)(borrow - set->slots);
+    size_t mask = set->capacity - 1;
+
+    // Shift back any following entries whose probe sequence passes through the hole, so lookups stay correct.
+    for (size_t i = (hole + 1) & mask; set->slots[i].component; i = (i + 1) & mask)
+    {
+        size_t home = borrowset_home_slot(set, set->slots[i].component);
+
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            set->slots[hole] = set->slots[i];
+            hole = i;
+        }
+    }
+
+    set->slots[hole].component = NULL;
+    set->count--;
+}
+
+static void borrowset_clear(BorrowSet *set)
+{
+    free(set->slots);
+    *set = borrowset_empty();
+}
+
 struct ECS
 {
     GenerationalIndexAllocator allocator;
-    HashTable components; // of ECSComponent keyed by component type
-    Vec borrowed_components; // of BorrowedComponent
-    HashTable event_listeners; // of Vec of EventListenerEntry keyed by component type
+    Vec components; // of ECSComponent indexed by ECSComponentID
+    HashTable component_ids; // of ECSComponentID keyed by component type name
+    Vec groups; // of ECSGroup
+    Vec cached_queries; // of ECSCachedQuery
+    size_t destroyed_since_compaction;
+    bool defer_change_events;
+    BorrowSet borrowed_components; // without borrow checks, only borrows of component types with listeners
+    int32_t borrow_lock; // systems running concurrently on the scheduler may borrow at the same time
+#ifdef ECS_NO_BORROW_CHECKS
+    uint32_t listened_type_count; // component types with at least one event listener
+#endif
 };
 
+// An entity holds the generation in its high 32 bits and the index + 1 in its low 32 bits, leaving 0 free to
+// mean no entity. Handles with a zero low half are never produced for live entities; command buffers use them
+// for pending entities.
 static GenerationalIndex entity_to_gi(Entity entity)
 {
-    if (entity == 0)
+    if ((uint32_t)entity == 0)
         PANIC("Attempted to convert empty entity in to generational index");
 
-    entity -= 1;
-
     return (GenerationalIndex) {
-        (uint32_t)((entity & 0x0000FFFFFF000000) >> 24),
-        (uint32_t) (entity & 0x0000000000FFFFFF)
+        (uint32_t)(entity >> 32),
+        (uint32_t)entity - 1
     };
 }
 
 static Entity gi_to_entity(GenerationalIndex index)
 {
-    return (((uint64_t)index.generation << 24) & 0x0000FFFFFF000000)
-        |  (((uint64_t)index.index + 1)        & 0x0000000000FFFFFF);
+    return ((uint64_t)index.generation << 32) | ((uint64_t)index.index + 1);
+}
+
+static ECSComponent *get_component(ECS *ecs, ECSComponentID component_id)
+{
+    if (component_id >= ecs->components.item_count) return NULL;
+
+    ECSComponent *comp = vec_at(&ecs->components, component_id);
+
+    return comp->name ? comp : NULL;
+}
+
+static const ECSComponent *get_component_const(const ECS *ecs, ECSComponentID component_id)
+{
+    return get_component((ECS*)ecs, component_id);
 }
 
 ECS *ecs_new(void)
 {
     ECS *ecs = malloc(sizeof(ECS));
     ecs->allocator = giallocator_empty();
-    ecs->components = hashtable_empty(256, sizeof(ECSComponent));
-    ecs->borrowed_components = vec_empty(sizeof(BorrowedComponent));
-    ecs->event_listeners = hashtable_empty(256, sizeof(Vec));
+    ecs->components = vec_empty(sizeof(ECSComponent));
+    ecs->component_ids = hashtable_empty(256, sizeof(ECSComponentID));
+    ecs->groups = vec_empty(sizeof(ECSGroup));
+    ecs->cached_queries = vec_empty(sizeof(ECSCachedQuery));
+    ecs->destroyed_since_compaction = 0;
+    ecs->defer_change_events = false;
+    ecs->borrowed_components = borrowset_empty();
+    ecs->borrow_lock = 0;
+#ifdef ECS_NO_BORROW_CHECKS
+    ecs->listened_type_count = 0;
+#endif
     return ecs;
 }
 
-static void delete_components_hashtable_cb(void *context, ECSComponent *comp)
+static void delete_components_vec_cb(void *context, ECSComponent *comp)
 {
+    if (!comp->name) return;
+
     giarray_clear(&comp->components);
+    vec_clear(&comp->event_listeners);
+    vec_clear(&comp->tag_bits);
+    vec_clear(&comp->pending_changes);
+    vec_clear(&comp->pending_bits);
 }
 
-static void delete_event_listeners_hashtable_cb(void *context, Vec *listeners)
+static void delete_cached_queries_vec_cb(void *context, ECSCachedQuery *cached)
 {
-    vec_clear(listeners);
+    vec_clear(&cached->rows);
+    vec_clear(&cached->row_slots);
 }
 
 void ecs_delete(ECS *ecs)
@@ -297,9 +860,11 @@ void ecs_delete(ECS *ecs)
     if (!ecs) return;
 
     giallocator_clear(&ecs->allocator);
-    hashtable_clear_with_callback(&ecs->components, NULL, delete_components_hashtable_cb);
-    vec_clear(&ecs->borrowed_components);
-    hashtable_clear_with_callback(&ecs->event_listeners, NULL, delete_event_listeners_hashtable_cb);
+    vec_clear_with_callback(&ecs->components, NULL, delete_components_vec_cb);
+    hashtable_clear(&ecs->component_ids);
+    vec_clear(&ecs->groups);
+    vec_clear_with_callback(&ecs->cached_queries, NULL, delete_cached_queries_vec_cb);
+    borrowset_clear(&ecs->borrowed_components);
 
     free(ecs);
 }
@@ -310,468 +875,2610 @@ Entity ecs_create_entity(ECS *ecs)
     return gi_to_entity(gi);
 }
 
-void ecs_destroy_entity(ECS *ecs, Entity entity)
+static void remove_all_components(ECS *ecs, Entity entity)
 {
-    giallocator_deallocate(&ecs->allocator, entity_to_gi(entity));
+    for (ECSComponentID id = 0; id < ecs->components.item_count; ++id)
+        if (get_component(ecs, id))
+            ecs_remove_component(ecs, entity, id);
 }
 
-bool ecs_is_entity_valid(const ECS *ecs, Entity entity)
+void ecs_destroy_entity(ECS *ecs, Entity entity)
 {
-    return giallocator_is_index_live(&ecs->allocator, entity_to_gi(entity));
+    if (!ecs_is_entity_valid(ecs, entity)) return;
+
+    remove_all_components(ecs, entity);
+    giallocator_deallocate(&ecs->allocator, entity_to_gi(entity));
+    ecs->destroyed_since_compaction++;
 }
 
-void ecs_register_component(ECS *ecs, const char *component_type, size_t component_size, ECSComponentDestructor destructor)
+void ecs_create_entities(ECS *ecs, size_t count, Entity *out_entities)
 {
-    if (hashtable_at(&ecs->components, component_type))
-        PANIC("Tried to register the same component twice: '%s'\n", component_type);
+    GenerationalIndex *indices = malloc(count * sizeof(GenerationalIndex));
+    giallocator_allocate_many(&ecs->allocator, count, indices);
 
-    ECSComponent new_component = { component_size, destructor, giarray_empty(component_size, destructor) };
-    hashtable_set_copy(&ecs->components, component_type, &new_component);
-}
+    for (size_t i = 0; i < count; ++i)
+        out_entities[i] = gi_to_entity(indices[i]);
 
-static bool check_borrowed_component_matches_ptr(const void *component, const BorrowedComponent *borrow_entry)
-{
-    return component == borrow_entry->component;
+    free(indices);
 }
 
-void *ecs_borrow_component(ECS *ecs, Entity entity, const char *component_type, const char *debug_file, int debug_line)
+void ecs_destroy_entities(ECS *ecs, size_t count, const Entity *entities)
 {
-    ECSComponent *comp = hashtable_at(&ecs->components, component_type);
-    void *result = comp ? giarray_at(&comp->components, entity_to_gi(entity)) : NULL;
+    GenerationalIndex *indices = malloc(count * sizeof(GenerationalIndex));
 
-    if (!result) return NULL;
+    for (size_t i = 0; i < count; ++i)
+    {
+        indices[i] = entity_to_gi(entities[i]);
+
+        if (ecs_is_entity_valid(ecs, entities[i]))
+            remove_all_components(ecs, entities[i]);
+    }
+
+    giallocator_deallocate_many(&ecs->allocator, count, indices);
+    ecs->destroyed_since_compaction += count;
+    free(indices);
+}
 
-    int found_index = vec_find_index(&ecs->borrowed_components, result, check_borrowed_component_matches_ptr);
+static void clone_pages(GenerationalIndexArray *store)
+{
+    store->pages = vec_clone(&store->pages);
 
-    if (found_index >= 0)
+    for (size_t p = 0; p < store->pages.item_count; ++p)
     {
-        BorrowedComponent *prev_borrow = vec_at(&ecs->borrowed_components, found_index);
-        PANIC("A component of type '%s' was borrowed twice without being returned.\n"
-            "Original borrow occurred at %s : %d\n"
-            "    This borrow occurred at %s : %d",
-            component_type, prev_borrow->debug_file, prev_borrow->debug_line, debug_file, debug_line);
+        uint8_t **page = vec_at(&store->pages, p);
+        if (!*page) continue;
+
+        uint8_t *copy = malloc(ECS_PAGE_ITEM_COUNT * store->item_size);
+        memcpy(copy, *page, ECS_PAGE_ITEM_COUNT * store->item_size);
+        *page = copy;
     }
+}
 
-    BorrowedComponent new_borrow = {
-        .component = result,
-        .entity = entity,
-        .type = component_type,
-        .debug_file = debug_file,
-        .debug_line = debug_line,
-    };
+// Pages can have holes, so deep_copy is handed each run of neighbouring items separately.
+static void deep_copy_pages(ECSComponentID id, GenerationalIndexArray *store, ECSComponentDeepCopier deep_copy)
+{
+    for (size_t p = 0; p < store->pages.item_count; ++p)
+    {
+        uint8_t *page = *(uint8_t**)vec_at(&store->pages, p);
+        if (!page) continue;
+
+        size_t run_start = 0, run_length = 0;
+
+        for (size_t i = 0; i <= ECS_PAGE_ITEM_COUNT; ++i)
+        {
+            if (i < ECS_PAGE_ITEM_COUNT && bitset_get(&store->occupancy, (uint32_t)(p * ECS_PAGE_ITEM_COUNT + i)))
+            {
+                if (run_length++ == 0) run_start = i;
+            }
+            else if (run_length > 0)
+            {
+                deep_copy(id, page + run_start * store->item_size, run_length);
+                run_length = 0;
+            }
+        }
+    }
+}
+
+ECS *ecs_clone(const ECS *ecs, ECSComponentDeepCopier deep_copy)
+{
+    ECS *result = ecs_new();
+
+    result->allocator.generations = vec_clone(&ecs->allocator.generations);
+    result->allocator.live_bits = vec_clone(&ecs->allocator.live_bits);
+    result->allocator.free_indices = vec_clone(&ecs->allocator.free_indices);
+    result->allocator.first_generation = ecs->allocator.first_generation;
+    result->components = vec_clone(&ecs->components);
+    result->groups = vec_clone(&ecs->groups);
+    result->defer_change_events = ecs->defer_change_events;
+#ifdef ECS_NO_BORROW_CHECKS
+    result->listened_type_count = ecs->listened_type_count;
+#endif
+    result->cached_queries = vec_clone(&ecs->cached_queries);
+
+    for (size_t i = 0; i < result->cached_queries.item_count; ++i)
+    {
+        ECSCachedQuery *cached = vec_at(&result->cached_queries, i);
+        cached->rows = vec_clone(&cached->rows);
+        cached->row_slots = vec_clone(&cached->row_slots);
+    }
 
-    vec_push_copy(&ecs->borrowed_components, &new_borrow);
+    for (ECSComponentID id = 0; id < result->components.item_count; ++id)
+    {
+        ECSComponent *comp = get_component(result, id);
+        if (!comp) continue;
+
+        GenerationalIndexArray *store = &comp->components;
+        store->sparse = vec_clone(&store->sparse);
+        store->dense_indices = vec_clone(&store->dense_indices);
+        clone_pages(store);
+        store->dense_ticks = vec_clone(&store->dense_ticks);
+        store->occupancy = vec_clone(&store->occupancy);
+        comp->event_listeners = vec_clone(&comp->event_listeners);
+        comp->tag_bits = vec_clone(&comp->tag_bits);
+        comp->pending_changes = vec_empty(sizeof(Entity));
+        comp->pending_bits = vec_empty(sizeof(uint64_t));
+
+        hashtable_set_copy(&result->component_ids, comp->name, &id);
+
+        // Structure-of-arrays components are plain data, and have no items for deep_copy to be handed.
+        if (deep_copy && !store->field_count)
+            deep_copy_pages(id, store, deep_copy);
+    }
 
     return result;
 }
 
-void ecs_return_component(ECS *ecs, void *component, const char *debug_file, int debug_line)
+void ecs_compact(ECS *ecs)
 {
-    if (!component) return;
+    if (ecs->destroyed_since_compaction == 0) return;
 
-    int found_index = vec_find_index(&ecs->borrowed_components, component, check_borrowed_component_matches_ptr);
+    giallocator_compact(&ecs->allocator);
 
-    if (found_index < 0)
-        PANIC("Attempted to return a component that was not borrowed.\n%s : %d", debug_file, debug_line);
+    for (ECSComponentID id = 0; id < ecs->components.item_count; ++id)
+    {
+        ECSComponent *comp = get_component(ecs, id);
+        if (!comp) continue;
 
-    BorrowedComponent *borrowed = vec_at(&ecs->borrowed_components, found_index);
+        giarray_compact(&comp->components);
 
-    Vec *listeners = hashtable_at(&ecs->event_listeners, borrowed->type);
+        size_t tag_words = (ecs->allocator.generations.item_count + 63) / 64;
+        if (comp->tag_bits.item_count > tag_words)
+            vec_resize(&comp->tag_bits, tag_words);
+
+        vec_shrink_to_fit(&comp->tag_bits);
+    }
 
-    if (listeners)
-    for (int i = 0; i < listeners->item_count; ++i)
+    for (size_t i = 0; i < ecs->cached_queries.item_count; ++i)
     {
-        EventListenerEntry *entry = vec_at(listeners, i);
-        if (entry->type == ECS_EVENT_COMPONENT_CHANGED)
-            entry->listener(borrowed->entity, component);
+        ECSCachedQuery *cached = vec_at(&ecs->cached_queries, i);
+
+        if (cached->row_slots.item_count > ecs->allocator.generations.item_count)
+            vec_resize(&cached->row_slots, ecs->allocator.generations.item_count);
+
+        vec_shrink_to_fit(&cached->row_slots);
+        vec_shrink_to_fit(&cached->rows);
     }
 
-    vec_remove(&ecs->borrowed_components, found_index);
+    ecs->destroyed_since_compaction = 0;
 }
 
-const void *ecs_view_component(const ECS *ecs, Entity entity, const char *component_type)
+bool ecs_is_entity_valid(const ECS *ecs, Entity entity)
 {
-    const ECSComponent *comp = hashtable_at_const(&ecs->components, component_type);
-    ECSComponent *comp_mut = (ECSComponent*)comp;
-    return comp ? giarray_at(&comp_mut->components, entity_to_gi(entity)) : NULL;
+    return giallocator_is_index_live(&ecs->allocator, entity_to_gi(entity));
 }
 
-void *ecs_add_component_zeroed(ECS *ecs, Entity entity, const char *component_type, const char *debug_file, int debug_line)
+static ECSComponent *register_component(ECS *ecs, ECSComponentID component_id, const char *component_type, size_t component_size, ECSComponentDestructor destructor)
 {
-    ECSComponent *comp = hashtable_at(&ecs->components, component_type);
-    if (!comp)
-        PANIC("Tried to add unregistered component: '%s'\n", component_type);
-
-    void *result = giarray_set_copy_or_zeroed(&comp->components, entity_to_gi(entity), 0);
+    if (get_component(ecs, component_id) || hashtable_at(&ecs->component_ids, component_type))
+        PANIC("Tried to register the same component twice: '%s'\n", component_type);
 
-    BorrowedComponent new_borrow = {
-        .component = result,
-        .entity = entity,
-        .type = component_type,
-        .debug_file = debug_file,
-        .debug_line = debug_line,
+    if (ecs->components.item_count <= component_id)
+        vec_resize(&ecs->components, component_id + 1);
+
+    ECSComponent new_component = {
+        .name = component_type,
+        .size = component_size,
+        .destructor = destructor,
+        .components = giarray_empty(component_size, destructor),
+        .event_listeners = vec_empty(sizeof(EventListenerEntry)),
+        .tag_bits = vec_empty(sizeof(uint64_t)),
+        .pending_changes = vec_empty(sizeof(Entity)),
+        .pending_bits = vec_empty(sizeof(uint64_t)),
     };
 
-    vec_push_copy(&ecs->borrowed_components, &new_borrow);
+    vec_set_copy(&ecs->components, component_id, &new_component);
+    hashtable_set_copy(&ecs->component_ids, component_type, &component_id);
 
-    return result;
+    return vec_at(&ecs->components, component_id);
 }
 
-void ecs_remove_component(ECS *ecs, Entity entity, const char *component_type)
+void ecs_register_component(ECS *ecs, ECSComponentID component_id, const char *component_type, size_t component_size, ECSComponentDestructor destructor)
 {
-    ECSComponent *comp = hashtable_at(&ecs->components, component_type);
-    if (!comp) return;
+    register_component(ecs, component_id, component_type, component_size, destructor);
+}
 
-    giarray_remove(&comp->components, entity_to_gi(entity));
+void ecs_register_singleton_component(ECS *ecs, ECSComponentID component_id, const char *component_type, size_t component_size, ECSComponentDestructor destructor)
+{
+    register_component(ecs, component_id, component_type, component_size, destructor)->singleton = true;
 }
 
-bool ecs_find_first_entity_with_component(const ECS *ecs, const char *component_type, Entity *out_entity)
+void ecs_register_soa_component(ECS *ecs, ECSComponentID component_id, const char *component_type, size_t component_size, size_t field_count, const ECSSoaField *fields)
 {
-    const ECSComponent *comp = hashtable_at_const(&ecs->components, component_type);
-    if (!comp) return false;
+    if (field_count < 1 || field_count > ECS_MAX_SOA_FIELDS)
+        PANIC("Structure of arrays component '%s' must have between 1 and %d fields\n", component_type, ECS_MAX_SOA_FIELDS);
 
-    GenerationalIndex index;
-    bool found_index = giarray_get_first_valid_index(&comp->components, &ecs->allocator, &index);
-    if (!found_index) return false;
+    ECSComponent *comp = register_component(ecs, component_id, component_type, component_size, NULL);
+    comp->components = giarray_empty_soa(component_size, field_count, fields);
+}
 
-    *out_entity = gi_to_entity(index);
-    return true;
+void ecs_register_tag(ECS *ecs, ECSComponentID tag_id, const char *tag_type)
+{
+    register_component(ecs, tag_id, tag_type, 0, NULL)->tag = true;
 }
 
-Entity *ecs_find_all_entities_with_component_alloc(const ECS *ecs, const char *component_type, size_t *result_length)
+void ecs_register_side_table(ECS *ecs, ECSComponentID component_id, ECSComponentID side_table_id, const void *prototype)
 {
-    const ECSComponent *comp = hashtable_at_const(&ecs->components, component_type);
-    if (!comp) return NULL;
+    ECSComponent *comp = get_component(ecs, component_id);
+    const ECSComponent *side_table = get_component(ecs, side_table_id);
 
-    GenerationalIndex *result = giarray_get_all_valid_indices_alloc(&comp->components, &ecs->allocator, result_length);
+    if (!comp || !side_table)
+        PANIC("Tried to register a side table with unregistered component ids: %u, %u\n", component_id, side_table_id);
+    if (comp->tag || side_table->tag || comp->side_table)
+        PANIC("Component '%s' cannot have the side table '%s'\n", comp->name, side_table->name);
 
-    for (int i = 0; i < *result_length; ++i)
-        ((Entity*)result)[i] = gi_to_entity(result[i]);
+    comp->side_table = side_table_id + 1;
+    comp->side_table_prototype = prototype;
+}
 
-    return (Entity*)result;
+bool ecs_find_component_id(const ECS *ecs, const char *component_type, ECSComponentID *out_id)
+{
+    const ECSComponentID *id = hashtable_at_const(&ecs->component_ids, component_type);
+    if (!id) return false;
+
+    *out_id = *id;
+    return true;
 }
 
-Entity *ecs_find_all_entities_alloc(const ECS *ecs, size_t *result_length)
+static void group_try_add_index(ECS *ecs, ECSGroup *group, uint32_t index)
 {
-    const GenerationalIndex *result = giallocator_get_all_allocated_indices_alloc(&ecs->allocator, result_length);
+    for (size_t i = 0; i < group->component_count; ++i)
+    {
+        const ECSComponent *comp = get_component(ecs, group->component_ids[i]);
+        uint32_t slot = giarray_dense_slot(&comp->components, index);
 
-    for (int i = 0; i < *result_length; ++i)
-        ((Entity*)result)[i] = gi_to_entity(result[i]);
+        if (!slot) return;
+        if (i == 0 && slot - 1 < group->size) return;
+    }
 
-    return (Entity*)result;
+    for (size_t i = 0; i < group->component_count; ++i)
+    {
+        ECSComponent *comp = get_component(ecs, group->component_ids[i]);
+        giarray_swap_dense(&comp->components, giarray_dense_slot(&comp->components, index) - 1, group->size);
+    }
+
+    group->size++;
 }
 
-static bool check_event_listeners_entries_match(EventListenerEntry *a, const EventListenerEntry *b)
+static void group_remove_index(ECS *ecs, ECSGroup *group, uint32_t index)
 {
-    return a->listener == b->listener && a->type == b->type;
+    const ECSComponent *first = get_component(ecs, group->component_ids[0]);
+    uint32_t slot = giarray_dense_slot(&first->components, index);
+
+    if (!slot || slot - 1 >= group->size) return;
+
+    group->size--;
+
+    for (size_t i = 0; i < group->component_count; ++i)
+    {
+        ECSComponent *comp = get_component(ecs, group->component_ids[i]);
+        giarray_swap_dense(&comp->components, giarray_dense_slot(&comp->components, index) - 1, group->size);
+    }
 }
 
-void ecs_register_event_listener(ECS *ecs, ECSComponentEventType event_type, const char *component_type, ECSComponentEventListener listener)
+void ecs_register_group(ECS *ecs, size_t component_count, const ECSComponentID *component_ids)
 {
-    Vec *entries = hashtable_at(&ecs->event_listeners, component_type);
+    if (component_count < 2 || component_count > ECS_MAX_QUERY_COMPONENTS)
+        PANIC("Groups must own between 2 and %d components\n", ECS_MAX_QUERY_COMPONENTS);
+
+    ECSGroup new_group = { component_count, { 0 }, 0 };
+    uint32_t group_slot = (uint32_t)ecs->groups.item_count + 1;
 
-    if (!entries)
+    for (size_t i = 0; i < component_count; ++i)
     {
-        Vec new_entries = vec_empty(sizeof(EventListenerEntry));
-        entries = hashtable_set_copy(&ecs->event_listeners, component_type, &new_entries);
-    }
+        ECSComponent *comp = get_component(ecs, component_ids[i]);
 
-    EventListenerEntry entry = {
-        .type = event_type,
-        .listener = listener
-    };
+        if (!comp)
+            PANIC("Tried to group unregistered component with id: %u\n", component_ids[i]);
+        if (comp->group)
+            PANIC("Component '%s' is already owned by a group\n", comp->name);
+        if (comp->singleton || comp->tag)
+            PANIC("Singleton and tag component '%s' cannot be owned by a group\n", comp->name);
+
+        comp->group = group_slot;
+        new_group.component_ids[i] = component_ids[i];
+    }
 
-    int found_index = vec_find_index(entries, &entry, check_event_listeners_entries_match);
+    ECSGroup *group = vec_push_copy(&ecs->groups, &new_group);
+    const ECSComponent *first = get_component(ecs, component_ids[0]);
 
-    if (found_index < 0)
-        vec_push_copy(entries, &entry);
+    for (size_t i = 0; i < first->components.dense_indices.item_count; ++i)
+    {
+        const GenerationalIndex *index = vec_at_const(&first->components.dense_indices, i);
+        group_try_add_index(ecs, group, index->index);
+    }
 }
 
-void ecs_remove_event_listener(ECS *ecs, ECSComponentEventType event_type, const char *component_type, ECSComponentEventListener listener)
+static bool group_is_covered_by(const ECSGroup *group, size_t component_count, const ECSComponentID *component_ids)
 {
-    Vec *entries = hashtable_at(&ecs->event_listeners, component_type);
-    if (!entries) return;
+    for (size_t i = 0; i < group->component_count; ++i)
+    {
+        bool found = false;
 
-    EventListenerEntry entry = {
-        .type = event_type,
-        .listener = listener
-    };
+        for (size_t j = 0; j < component_count && !found; ++j)
+            found = group->component_ids[i] == component_ids[j];
 
-    int found_index = vec_find_index(entries, &entry, check_event_listeners_entries_match);
+        if (!found) return false;
+    }
 
-    if (found_index >= 0)
-        vec_remove(entries, found_index);
+    return true;
 }
 
+static bool entity_index_has_component(const ECSComponent *comp, uint32_t index)
+{
+    return bitset_get(comp->tag ? &comp->tag_bits : &comp->components.occupancy, index);
+}
 
-#ifdef RUN_TESTS
-static int test_destructor_call_count;
-static void test_destructor(void *value)
+static bool ids_contain(size_t count, const ECSComponentID *ids, ECSComponentID component_id)
 {
-    test_destructor_call_count++;
+    for (size_t i = 0; i < count; ++i)
+        if (ids[i] == component_id) return true;
+
+    return false;
 }
 
-static float test_change_event_listener_sum;
-static void test_change_event_listener(Entity e, const float *component)
+static bool cached_query_uses(const ECSCachedQuery *cached, ECSComponentID component_id)
 {
-    test_change_event_listener_sum += *component;
+    return ids_contain(cached->component_count, cached->component_ids, component_id);
 }
 
-TestResult ecs_test()
+static uint32_t cached_query_row_slot(const ECSCachedQuery *cached, uint32_t index)
 {
-    TEST_BEGIN("GenerationalIndexAllocator works");
+    if (index >= cached->row_slots.item_count) return 0;
+    return *(const uint32_t*)vec_at_const(&cached->row_slots, index);
+}
 
-        GenerationalIndexAllocator alloc = giallocator_empty();
+static void cached_query_push(ECSCachedQuery *cached, GenerationalIndex index)
+{
+    vec_push_copy(&cached->rows, &index);
 
-        GenerationalIndex i = giallocator_allocate(&alloc);
-        GenerationalIndex j = giallocator_allocate(&alloc);
+    if (cached->row_slots.item_count <= index.index)
+        vec_resize(&cached->row_slots, index.index + 1);
 
-        TEST_ASSERT(i.generation == 0 && i.index == 0);
-        TEST_ASSERT(j.generation == 0 && j.index == 1);
+    *(uint32_t*)vec_at(&cached->row_slots, index.index) = (uint32_t)cached->rows.item_count;
+}
 
-        TEST_ASSERT( giallocator_deallocate(&alloc, i));
-        TEST_ASSERT(!giallocator_deallocate(&alloc, i));
+static const ECSCachedQuery *find_cached_query(const ECS *ecs, size_t component_count, const ECSComponentID *component_ids)
+{
+    for (size_t i = 0; i < ecs->cached_queries.item_count; ++i)
+    {
+        const ECSCachedQuery *cached = vec_at_const(&ecs->cached_queries, i);
+        if (cached->component_count != component_count) continue;
 
-        GenerationalIndex k = giallocator_allocate(&alloc);
+        // Checked both ways round, so a duplicate ID on either side cannot stand in for a missing one.
+        bool matched = true;
+        for (size_t j = 0; j < component_count && matched; ++j)
+            matched = cached_query_uses(cached, component_ids[j]);
+        for (size_t j = 0; j < component_count && matched; ++j)
+            matched = ids_contain(component_count, component_ids, cached->component_ids[j]);
 
-        TEST_ASSERT(k.generation == 1 && k.index == 0);
+        if (matched) return cached;
+    }
 
-        TEST_ASSERT(!giallocator_is_index_live(&alloc, i));
-        TEST_ASSERT( giallocator_is_index_live(&alloc, j));
-        TEST_ASSERT( giallocator_is_index_live(&alloc, k));
+    return NULL;
+}
 
-        giallocator_clear(&alloc);
+// Called once the component is in place, so the entity only needs checking against the other components.
+static void cached_queries_on_add(ECS *ecs, ECSComponentID component_id, GenerationalIndex index)
+{
+    for (size_t i = 0; i < ecs->cached_queries.item_count; ++i)
+    {
+        ECSCachedQuery *cached = vec_at(&ecs->cached_queries, i);
+        if (!cached_query_uses(cached, component_id) || cached_query_row_slot(cached, index.index)) continue;
 
-    TEST_END();
-    TEST_BEGIN("GenerationalIndexAllocator get all indices works");
+        bool matched = true;
+        for (size_t j = 0; j < cached->component_count && matched; ++j)
+            matched = entity_index_has_component(get_component(ecs, cached->component_ids[j]), index.index);
 
-        GenerationalIndexAllocator alloc = giallocator_empty();
+        if (matched) cached_query_push(cached, index);
+    }
+}
 
-        giallocator_allocate(&alloc); // [(0,0)]
-        GenerationalIndex j = giallocator_allocate(&alloc); // [(0,0), (0,1)]
+static void cached_queries_on_remove(ECS *ecs, ECSComponentID component_id, uint32_t index)
+{
+    for (size_t i = 0; i < ecs->cached_queries.item_count; ++i)
+    {
+        ECSCachedQuery *cached = vec_at(&ecs->cached_queries, i);
+        if (!cached_query_uses(cached, component_id)) continue;
 
-        giallocator_deallocate(&alloc, j); // [(0,0), (x,1)]
+        uint32_t slot = cached_query_row_slot(cached, index);
+        if (!slot) continue;
 
-        giallocator_allocate(&alloc); // [(0,0), (1,1)]
-        GenerationalIndex l = giallocator_allocate(&alloc); // [(0,0), (1,1), (0,2)]
-        giallocator_allocate(&alloc); // [(0,0), (1,1), (0,2), (0,3)]
+        uint32_t last_slot = (uint32_t)cached->rows.item_count;
 
-        giallocator_deallocate(&alloc, l); // [(0,0), (1,1), (x,2), (0,3)]
+        if (slot != last_slot)
+        {
+            GenerationalIndex moved = *(GenerationalIndex*)vec_at(&cached->rows, last_slot - 1);
 
-        size_t num_indices;
-        GenerationalIndex *indices = giallocator_get_all_allocated_indices_alloc(&alloc, &num_indices);
+            vec_set_copy(&cached->rows, slot - 1, &moved);
+            vec_set_copy(&cached->row_slots, moved.index, &slot);
+        }
 
-        TEST_ASSERT(num_indices == 3);
-        TEST_ASSERT(indices[0].generation == 0 && indices[0].index == 0);
-        TEST_ASSERT(indices[1].generation == 1 && indices[1].index == 1);
-        TEST_ASSERT(indices[2].generation == 0 && indices[2].index == 3);
+        vec_resize(&cached->rows, last_slot - 1);
+        *(uint32_t*)vec_at(&cached->row_slots, index) = 0;
+    }
+}
 
-        free(indices);
-        giallocator_clear(&alloc);
+void ecs_register_query(ECS *ecs, size_t component_count, const ECSComponentID *component_ids)
+{
+    if (component_count < 1 || component_count > ECS_MAX_QUERY_COMPONENTS)
+        PANIC("Registered queries must match between 1 and %d components\n", ECS_MAX_QUERY_COMPONENTS);
 
-    TEST_END();
-    TEST_BEGIN("GenerationalIndexArray works with multiple generations");
+    for (size_t i = 0; i < component_count; ++i)
+        if (!get_component(ecs, component_ids[i]))
+            PANIC("Tried to register a query on unregistered component with id: %u\n", component_ids[i]);
 
-        typedef struct TestArrayElem
-        {
-            float x;
-            int16_t y;
-        }
-        TestArrayElem;
+    if (find_cached_query(ecs, component_count, component_ids)) return;
 
-        GenerationalIndexAllocator alloc = giallocator_empty();
-        GenerationalIndexArray arr = giarray_empty(sizeof(TestArrayElem), test_destructor);
+    ECSCachedQuery cached = {
+        .component_count = component_count,
+        .rows = vec_empty(sizeof(GenerationalIndex)),
+        .row_slots = vec_empty(sizeof(uint32_t)),
+    };
 
-        test_destructor_call_count = 0;
+    for (size_t i = 0; i < component_count; ++i)
+        cached.component_ids[i] = component_ids[i];
 
-        GenerationalIndex i = giallocator_allocate(&alloc);
-        TestArrayElem val_in = { 4.0f, 19 };
-        giarray_set_copy_or_zeroed(&arr, i, &val_in);
+    // Filled by an ordinary query before it is added to the list, so the query cannot find the empty cache.
+    ECSQuery query = ecs_query_begin(ecs, component_count, component_ids);
+    while (ecs_query_next(&query))
+        cached_query_push(&cached, entity_to_gi(query.entity));
 
-        TestArrayElem *val_out = giarray_at(&arr, i);
+    vec_push_copy(&ecs->cached_queries, &cached);
+}
 
-        TEST_ASSERT(val_out);
-        TEST_ASSERT(val_out != &val_in);
-        TEST_ASSERT(val_out->x == 4.0f && val_out->y == 19);
-        TEST_ASSERT(test_destructor_call_count == 0);
+ECSQuery ecs_query_begin(ECS *ecs, size_t component_count, const ECSComponentID *component_ids)
+{
+    return ecs_query_begin_changed_since(ecs, 0, component_count, component_ids);
+}
 
-        giallocator_deallocate(&alloc, i);
+ECSQuery ecs_query_begin_changed_since(ECS *ecs, ECSTick tick, size_t component_count, const ECSComponentID *component_ids)
+{
+    if (component_count > ECS_MAX_QUERY_COMPONENTS)
+        PANIC("Queries can match at most %d components\n", ECS_MAX_QUERY_COMPONENTS);
 
-        GenerationalIndex j = giallocator_allocate(&alloc);
-        TestArrayElem *val_out2 = giarray_set_copy_or_zeroed(&arr, j, 0);
+    ECSQuery query = { 0 };
+    query.ecs_ = ecs;
+    query.position_ = (size_t)-1;
+    query.component_count_ = component_count;
+    query.changed_since_ = tick;
 
-        TEST_ASSERT(test_destructor_call_count == 1);
+    size_t smallest_count = SIZE_MAX;
 
-        TEST_ASSERT(!giarray_at(&arr, i));
+    for (size_t i = 0; i < component_count; ++i)
+    {
+        ECSComponent *comp = get_component(ecs, component_ids[i]);
 
-        TEST_ASSERT(val_out2);
-        TEST_ASSERT(val_out2->x == 0.0f && val_out->y == 0);
+        if (!comp)
+        {
+            query.done_ = true;
+            return query;
+        }
 
-        giarray_clear(&arr);
-        giallocator_clear(&alloc);
+        if (comp->tag)
+        {
+            query.tag_[i] = true;
+            query.stores_[i] = &comp->tag_bits;
+            continue;
+        }
 
-        TEST_ASSERT(test_destructor_call_count == 2);
+        query.stores_[i] = &comp->components;
 
-    TEST_END();
-    TEST_BEGIN("GenerationalIndexArray find all valid indices works");
+        if (comp->components.dense_indices.item_count < smallest_count)
+        {
+            smallest_count = comp->components.dense_indices.item_count;
+            query.driver_ = i;
+        }
+    }
 
-        GenerationalIndexAllocator alloc = giallocator_empty();
-        GenerationalIndexArray arr = giarray_empty(sizeof(float), NULL);
-        GenerationalIndex i0 = giallocator_allocate(&alloc);
-        GenerationalIndex i1 = giallocator_allocate(&alloc);
-        GenerationalIndex i2 = giallocator_allocate(&alloc);
+    // A registered query for the same set of components already holds exactly the matching entities.
+    query.cached_ = find_cached_query(ecs, component_count, component_ids);
+    if (query.cached_) return query;
 
-        float *f0 = giarray_set_copy_or_zeroed(&arr, i0, 0);
-        float *f1 = giarray_set_copy_or_zeroed(&arr, i1, 0);
-        float *f2 = giarray_set_copy_or_zeroed(&arr, i2, 0);
+    // With nothing but tags there is no store to drive the walk, so the tag bitsets are intersected with the
+    // live entities instead. The same goes for joins where even the smallest store has more items than there
+    // are 64 bit words of entities: a lookup per driver item would then cost more than intersecting every
+    // store's occupancy bitset 256 bits at a time.
+    size_t data_count = 0;
+    for (size_t i = 0; i < component_count; ++i)
+        if (!query.tag_[i]) data_count++;
 
-        giarray_remove(&arr, i1);
+    query.by_bits_ = smallest_count == SIZE_MAX
+        || (data_count > 1 && smallest_count > ecs->allocator.live_bits.item_count);
 
-        size_t result_count;
-        GenerationalIndex *results = giarray_get_all_valid_indices_alloc(&arr, &alloc, &result_count);
+    // Prefer walking a group when the query covers one, since its members need no membership checks.
+    for (size_t i = 0; i < component_count; ++i)
+    {
+        const ECSComponent *comp = get_component(ecs, component_ids[i]);
+        if (!comp->group) continue;
 
-        TEST_ASSERT(result_count == 2);
-        TEST_ASSERT(results[0].generation == i0.generation && results[0].index == i0.index);
-        TEST_ASSERT(results[1].generation == i2.generation && results[1].index == i2.index);
+        const ECSGroup *group = vec_at_const(&ecs->groups, comp->group - 1);
+        if (!group_is_covered_by(group, component_count, component_ids)) continue;
 
-        free(results);
+        query.by_bits_ = false;
+        query.group_ = group;
+        query.driver_ = i;
 
-        giarray_clear(&arr);
-        giallocator_clear(&alloc);
+        for (size_t j = 0; j < component_count; ++j)
+            query.packed_[j] = get_component(ecs, component_ids[j])->group == comp->group;
 
-    TEST_END();
-    TEST_BEGIN("GenerationalIndexArray remove element works, destructor not called twice");
+        break;
+    }
 
-        GenerationalIndexAllocator alloc = giallocator_empty();
-        GenerationalIndexArray arr = giarray_empty(sizeof(float), test_destructor);
-        GenerationalIndex i = giallocator_allocate(&alloc);
+    return query;
+}
 
-        test_destructor_call_count = 0;
+static bool query_load_next_block(ECSQuery *query)
+{
+    const GenerationalIndexAllocator *alloc = &query->ecs_->allocator;
+    const Vec *bitsets[ECS_MAX_QUERY_COMPONENTS + 1] = { &alloc->live_bits };
 
-        giarray_set_copy_or_zeroed(&arr, i, 0);
-        TEST_ASSERT(giarray_at(&arr, i));
+    for (size_t i = 0; i < query->component_count_; ++i)
+        bitsets[i + 1] = query->tag_[i]
+            ? query->stores_[i]
+            : &((const GenerationalIndexArray*)query->stores_[i])->occupancy;
 
-        giarray_remove(&arr, i);
-        TEST_ASSERT(!giarray_at(&arr, i));
+    do
+    {
+        if (++query->position_ * ECS_BITSET_BLOCK_WORDS >= alloc->live_bits.item_count)
+            return false;
 
-        TEST_ASSERT(test_destructor_call_count == 1);
+        bitset_and_blocks(query->component_count_ + 1, bitsets, query->position_ * ECS_BITSET_BLOCK_WORDS, query->block_);
+    }
+    while (!(query->block_[0] | query->block_[1] | query->block_[2] | query->block_[3]));
 
-        giarray_clear(&arr);
-        giallocator_clear(&alloc);
+    return true;
+}
 
-        TEST_ASSERT(test_destructor_call_count == 1);
+static bool query_changed_since(const ECSQuery *query, GenerationalIndex index);
 
-    TEST_END();
-    TEST_BEGIN("Entity to GenerationalIndex conversion reverses");
+// Structure-of-arrays components are handed out as their page, which together with query->lane is an ECSSoaRef.
+static void *query_item(GenerationalIndexArray *store, uint32_t index)
+{
+    return store->field_count ? giarray_page(store, index) : giarray_item(store, index);
+}
 
-        {
-            GenerationalIndex i = { 29, 119 };
-            GenerationalIndex j = entity_to_gi(gi_to_entity(i));
+static bool query_next_by_bits(ECSQuery *query)
+{
+    const GenerationalIndexAllocator *alloc = &query->ecs_->allocator;
+
+    for (;;)
+    {
+        size_t word = 0;
+        while (word < ECS_BITSET_BLOCK_WORDS && query->block_[word] == 0) word++;
+
+        if (word == ECS_BITSET_BLOCK_WORDS)
+        {
+            if (query_load_next_block(query)) continue;
+
+            query->done_ = true;
+            return false;
+        }
+
+        uint64_t *bits = &query->block_[word];
+        uint32_t index = (uint32_t)((query->position_ * ECS_BITSET_BLOCK_WORDS + word) * 64 + utils_count_trailing_zeros_u64(*bits));
+        *bits &= *bits - 1;
+
+        GenerationalIndex gi = { vec_uint32_t_get(&alloc->generations, index), index };
+
+        for (size_t i = 0; i < query->component_count_; ++i)
+        {
+            if (query->tag_[i]) continue;
+
+            GenerationalIndexArray *store = query->stores_[i];
+            query->components[i] = query_item(store, index);
+        }
+
+        if (query->changed_since_ && !query_changed_since(query, gi)) continue;
+
+        query->entity = gi_to_entity(gi);
+        query->lane = index % ECS_PAGE_ITEM_COUNT;
+        return true;
+    }
+}
+
+static bool query_next_cached(ECSQuery *query)
+{
+    const ECSCachedQuery *cached = query->cached_;
+
+    while (++query->position_ < cached->rows.item_count)
+    {
+        GenerationalIndex index = vec_GenerationalIndex_get(&cached->rows, query->position_);
+
+        for (size_t i = 0; i < query->component_count_; ++i)
+            query->components[i] = query->tag_[i] ? NULL : query_item(query->stores_[i], index.index);
+
+        if (query->changed_since_ && !query_changed_since(query, index)) continue;
+
+        query->entity = gi_to_entity(index);
+        query->lane = index.index % ECS_PAGE_ITEM_COUNT;
+        return true;
+    }
+
+    query->done_ = true;
+    return false;
+}
+
+static bool query_changed_since(const ECSQuery *query, GenerationalIndex index)
+{
+    for (size_t i = 0; i < query->component_count_; ++i)
+    {
+        if (query->tag_[i]) continue;
+
+        GenerationalIndexArray *store = query->stores_[i];
+        const ECSTick *tick = !query->by_bits_ && !query->cached_ && (i == query->driver_ || query->packed_[i])
+            ? vec_ECSTick_at_const(&store->dense_ticks, query->position_)
+            : giarray_tick_at(store, index.index);
+
+        if (*tick > query->changed_since_) return true;
+    }
+
+    return false;
+}
+
+bool ecs_query_next(ECSQuery *query)
+{
+    if (query->done_) return false;
+    if (query->cached_) return query_next_cached(query);
+    if (query->by_bits_) return query_next_by_bits(query);
+
+    const GenerationalIndexArray *driver = query->stores_[query->driver_];
+    size_t end = query->group_
+        ? ((const ECSGroup*)query->group_)->size
+        : driver->dense_indices.item_count;
+
+    while (++query->position_ < end)
+    {
+        // Destroying an entity removes its components, so every stored item belongs to a live entity.
+        GenerationalIndex index = vec_GenerationalIndex_get(&driver->dense_indices, query->position_);
+        bool matched = true;
+
+        for (size_t i = 0; i < query->component_count_ && matched; ++i)
+        {
+            GenerationalIndexArray *store = query->stores_[i];
+
+            if (query->tag_[i])
+            {
+                query->components[i] = NULL;
+                matched = bitset_get(query->stores_[i], index.index);
+            }
+            else if (i == query->driver_ || query->packed_[i])
+            {
+                query->components[i] = query_item(store, index.index);
+            }
+            else
+            {
+                matched = giarray_at(store, index) != NULL;
+                query->components[i] = matched ? query_item(store, index.index) : NULL;
+            }
+        }
+
+        if (!matched) continue;
+        if (query->changed_since_ && !query_changed_since(query, index)) continue;
+
+        query->entity = gi_to_entity(index);
+        query->lane = index.index % ECS_PAGE_ITEM_COUNT;
+        return true;
+    }
+
+    query->done_ = true;
+    return false;
+}
+
+// Shared by every ECS so ticks stay comparable when one ECS replaces another, e.g. when entering play mode.
+static ECSTick s_change_tick;
+
+static ECSTick next_change_tick(void)
+{
+    return UTILS_ATOMIC_INCREMENT_U64(&s_change_tick);
+}
+
+static void stamp_change_tick(GenerationalIndexArray *gia, GenerationalIndex index)
+{
+    *giarray_tick_at(gia, index.index) = next_change_tick();
+}
+
+ECSTick ecs_get_change_tick(void)
+{
+    return UTILS_ATOMIC_LOAD_U64(&s_change_tick);
+}
+
+ECSTick ecs_get_component_change_tick(const ECS *ecs, Entity entity, ECSComponentID component_id)
+{
+    const ECSComponent *comp = get_component_const(ecs, component_id);
+    if (!comp || !giarray_at((GenerationalIndexArray*)&comp->components, entity_to_gi(entity))) return 0;
+
+    return *giarray_tick_at((GenerationalIndexArray*)&comp->components, entity_to_gi(entity).index);
+}
+
+void ecs_mark_all_changed(ECS *ecs)
+{
+    ECSTick tick = next_change_tick();
+
+    for (ECSComponentID id = 0; id < ecs->components.item_count; ++id)
+    {
+        ECSComponent *comp = get_component(ecs, id);
+        if (!comp) continue;
+
+        for (size_t i = 0; i < comp->components.dense_ticks.item_count; ++i)
+            *(ECSTick*)vec_at(&comp->components.dense_ticks, i) = tick;
+    }
+}
+
+static void call_listeners(const ECSComponent *comp, ECSComponentEventType event_type, const Entity *entities, size_t count, const void *const *components)
+{
+    for (size_t i = 0; i < comp->event_listeners.item_count; ++i)
+    {
+        const EventListenerEntry *entry = vec_at_const(&comp->event_listeners, i);
+        if (entry->type != event_type) continue;
+
+        if (entry->batch_listener)
+            entry->batch_listener(entities, count);
+        else
+            for (size_t j = 0; j < count; ++j)
+                entry->listener(entities[j], components[j]);
+    }
+}
+
+// Deferred change events only record which entity changed, so each type's queue is touched by one thread at a
+// time just like the components themselves.
+static void dispatch_event(ECS *ecs, ECSComponentEventType event_type, ECSComponentID component_id, Entity entity, const void *component)
+{
+    ECSComponent *comp = get_component(ecs, component_id);
+    if (comp->event_listeners.item_count == 0) return;
+
+    // Structure-of-arrays components have no address to hand out.
+    if (comp->components.field_count) component = NULL;
+
+    if (event_type == ECS_EVENT_COMPONENT_CHANGED && ecs->defer_change_events)
+    {
+        uint32_t index = entity_to_gi(entity).index;
+        if (bitset_get(&comp->pending_bits, index)) return;
+
+        bitset_set(&comp->pending_bits, index, true);
+        vec_push_copy(&comp->pending_changes, &entity);
+        return;
+    }
+
+    call_listeners(comp, event_type, &entity, 1, &component);
+}
+
+void ecs_set_deferred_change_events(ECS *ecs, bool deferred)
+{
+    if (!deferred) ecs_flush_change_events(ecs);
+    ecs->defer_change_events = deferred;
+}
+
+void ecs_flush_change_events(ECS *ecs)
+{
+    for (ECSComponentID id = 0; id < ecs->components.item_count; ++id)
+    {
+        ECSComponent *comp = get_component(ecs, id);
+        if (!comp || comp->pending_changes.item_count == 0) continue;
+
+        // Drop duplicates and entities which lost the component, then swap the queue out so listeners which
+        // borrow and return components of this type queue their changes for the next flush.
+        Vec changes = comp->pending_changes;
+        Vec components = vec_empty(sizeof(void*));
+        size_t kept = 0;
+
+        for (size_t i = 0; i < changes.item_count; ++i)
+        {
+            Entity entity = *(Entity*)vec_at(&changes, i);
+            GenerationalIndex gi = entity_to_gi(entity);
+            void *component = giarray_at(&comp->components, gi);
+
+            if (!component || !bitset_get(&comp->pending_bits, gi.index)) continue;
+
+            if (comp->components.field_count) component = NULL;
+
+            bitset_set(&comp->pending_bits, gi.index, false);
+            vec_set_copy(&changes, kept++, &entity);
+            vec_push_copy(&components, &component);
+        }
+
+        comp->pending_changes = vec_empty(sizeof(Entity));
+        vec_clear(&comp->pending_bits);
+
+        if (kept > 0)
+            call_listeners(comp, ECS_EVENT_COMPONENT_CHANGED, changes.data, kept, components.data);
+
+        vec_clear(&changes);
+        vec_clear(&components);
+    }
+}
+
+#ifndef ECS_NO_BORROW_CHECKS
+static void track_borrow(ECS *ecs, const void *component, Entity entity, ECSComponentID component_id, const char *debug_file, int debug_line)
+{
+    UTILS_SPIN_LOCK(&ecs->borrow_lock);
+
+    const BorrowedComponent *prev_borrow = borrowset_find(&ecs->borrowed_components, component);
+
+    if (prev_borrow)
+    {
+        PANIC("A component of type '%s' was borrowed twice without being returned.\n"
+            "Original borrow occurred at %s : %d\n"
+            "    This borrow occurred at %s : %d",
+            get_component(ecs, component_id)->name, prev_borrow->debug_file, prev_borrow->debug_line, debug_file, debug_line);
+    }
+
+    BorrowedComponent new_borrow = {
+        .component = component,
+        .entity = entity,
+        .type = component_id,
+        .debug_file = debug_file,
+        .debug_line = debug_line,
+    };
+
+    borrowset_insert(&ecs->borrowed_components, &new_borrow);
+
+    UTILS_SPIN_UNLOCK(&ecs->borrow_lock);
+}
+#else
+// Without borrow checks, only borrows of component types with listeners are recorded, so that returning them can
+// raise a change event. A component borrowed twice keeps its latest record.
+static void track_borrow(ECS *ecs, const void *component, Entity entity, ECSComponentID component_id, const char *debug_file, int debug_line)
+{
+    if (get_component(ecs, component_id)->event_listeners.item_count == 0) return;
+
+    BorrowedComponent new_borrow = {
+        .component = component,
+        .entity = entity,
+        .type = component_id,
+        .debug_file = debug_file,
+        .debug_line = debug_line,
+    };
+
+    UTILS_SPIN_LOCK(&ecs->borrow_lock);
+
+    BorrowedComponent *existing = borrowset_find(&ecs->borrowed_components, component);
+
+    if (existing)
+        *existing = new_borrow;
+    else
+        borrowset_insert(&ecs->borrowed_components, &new_borrow);
+
+    UTILS_SPIN_UNLOCK(&ecs->borrow_lock);
+}
+#endif
+
+static void panic_if_soa(const ECSComponent *comp)
+{
+    if (comp && comp->components.field_count)
+        PANIC("Component '%s' is stored as a structure of arrays, so it must be accessed with the soa functions\n", comp->name);
+}
+
+static ECSComponent *get_soa_component(ECS *ecs, ECSComponentID component_id)
+{
+    ECSComponent *comp = get_component(ecs, component_id);
+
+    if (comp && !comp->components.field_count)
+        PANIC("Component '%s' is not stored as a structure of arrays\n", comp->name);
+
+    return comp;
+}
+
+static ECSSoaRef soa_ref(const GenerationalIndexArray *gia, const void *item, Entity entity)
+{
+    if (!item) return (ECSSoaRef) { NULL, 0 };
+
+    uint32_t index = entity_to_gi(entity).index;
+    return (ECSSoaRef) { giarray_page(gia, index), index % ECS_PAGE_ITEM_COUNT };
+}
+
+static void *borrow_item(ECS *ecs, ECSComponent *comp, Entity entity, ECSComponentID component_id, const char *debug_file, int debug_line)
+{
+    void *result = comp ? giarray_at(&comp->components, entity_to_gi(entity)) : NULL;
+
+    if (!result) return NULL;
+
+    stamp_change_tick(&comp->components, entity_to_gi(entity));
+
+    track_borrow(ecs, result, entity, component_id, debug_file, debug_line);
+
+    return result;
+}
+
+void *ecs_borrow_component(ECS *ecs, Entity entity, ECSComponentID component_id, const char *debug_file, int debug_line)
+{
+    ECSComponent *comp = get_component(ecs, component_id);
+    panic_if_soa(comp);
+
+    return borrow_item(ecs, comp, entity, component_id, debug_file, debug_line);
+}
+
+ECSSoaRef ecs_view_soa_component(const ECS *ecs, Entity entity, ECSComponentID component_id)
+{
+    ECSComponent *comp = get_soa_component((ECS*)ecs, component_id);
+    if (!comp) return (ECSSoaRef) { NULL, 0 };
+
+    return soa_ref(&comp->components, giarray_at(&comp->components, entity_to_gi(entity)), entity);
+}
+
+ECSSoaRef ecs_borrow_soa_component(ECS *ecs, Entity entity, ECSComponentID component_id, const char *debug_file, int debug_line)
+{
+    ECSComponent *comp = get_soa_component(ecs, component_id);
+    if (!comp) return (ECSSoaRef) { NULL, 0 };
+
+    return soa_ref(&comp->components, borrow_item(ecs, comp, entity, component_id, debug_file, debug_line), entity);
+}
+
+void ecs_return_soa_component(ECS *ecs, ECSSoaRef ref, const char *debug_file, int debug_line)
+{
+    ecs_return_component(ecs, ref.page ? ref.page + ref.lane : NULL, debug_file, debug_line);
+}
+
+void ecs_read_soa_component(const ECS *ecs, ECSComponentID component_id, ECSSoaRef ref, void *out)
+{
+    const ECSComponent *comp = get_soa_component((ECS*)ecs, component_id);
+    soa_read(&comp->components, ref.page, ref.lane, out);
+}
+
+void ecs_write_soa_component(ECS *ecs, ECSComponentID component_id, ECSSoaRef ref, const void *value)
+{
+    const ECSComponent *comp = get_soa_component(ecs, component_id);
+    soa_write(&comp->components, ref.page, ref.lane, value);
+}
+
+void ecs_return_component(ECS *ecs, void *component, const char *debug_file, int debug_line)
+{
+    if (!component) return;
+
+#ifndef ECS_NO_BORROW_CHECKS
+    UTILS_SPIN_LOCK(&ecs->borrow_lock);
+
+    BorrowedComponent *borrowed = borrowset_find(&ecs->borrowed_components, component);
+
+    if (!borrowed)
+        PANIC("Attempted to return a component that was not borrowed.\n%s : %d", debug_file, debug_line);
+
+    BorrowedComponent returned = *borrowed;
+    borrowset_remove(&ecs->borrowed_components, borrowed);
+
+    UTILS_SPIN_UNLOCK(&ecs->borrow_lock);
+
+    dispatch_event(ecs, ECS_EVENT_COMPONENT_CHANGED, returned.type, returned.entity, component);
+#else
+    // Returns cost one branch while no component type has listeners.
+    if (ecs->listened_type_count == 0) return;
+
+    UTILS_SPIN_LOCK(&ecs->borrow_lock);
+
+    BorrowedComponent *borrowed = borrowset_find(&ecs->borrowed_components, component);
+    BorrowedComponent returned = borrowed ? *borrowed : (BorrowedComponent) { 0 };
+    if (borrowed) borrowset_remove(&ecs->borrowed_components, borrowed);
+
+    UTILS_SPIN_UNLOCK(&ecs->borrow_lock);
+
+    if (returned.component)
+        dispatch_event(ecs, ECS_EVENT_COMPONENT_CHANGED, returned.type, returned.entity, component);
+#endif
+}
+
+// Destroying an entity removes its components straight away, so the first dense slot of any component always
+// belongs to a live entity. For singletons it is the only slot, which makes these lookups O(1).
+static bool first_component_slot(const ECSComponent *comp, Entity *out_entity)
+{
+    if (!comp || comp->components.dense_indices.item_count == 0) return false;
+
+    if (out_entity)
+        *out_entity = gi_to_entity(*(const GenerationalIndex*)vec_at_const(&comp->components.dense_indices, 0));
+
+    return true;
+}
+
+const void *ecs_view_singleton(const ECS *ecs, ECSComponentID component_id, Entity *out_entity)
+{
+    const ECSComponent *comp = get_component_const(ecs, component_id);
+    Entity entity;
+    if (!first_component_slot(comp, &entity)) return NULL;
+
+    if (out_entity) *out_entity = entity;
+    return giarray_item(&comp->components, entity_to_gi(entity).index);
+}
+
+void *ecs_borrow_singleton(ECS *ecs, ECSComponentID component_id, Entity *out_entity, const char *debug_file, int debug_line)
+{
+    ECSComponent *comp = get_component(ecs, component_id);
+    Entity entity;
+    if (!first_component_slot(comp, &entity)) return NULL;
+
+    void *result = giarray_item(&comp->components, entity_to_gi(entity).index);
+    *(ECSTick*)vec_at(&comp->components.dense_ticks, 0) = next_change_tick();
+
+    track_borrow(ecs, result, entity, component_id, debug_file, debug_line);
+
+    if (out_entity) *out_entity = entity;
+    return result;
+}
+
+const void *ecs_view_component(const ECS *ecs, Entity entity, ECSComponentID component_id)
+{
+    const ECSComponent *comp = get_component_const(ecs, component_id);
+    ECSComponent *comp_mut = (ECSComponent*)comp;
+    panic_if_soa(comp);
+    return comp ? giarray_at(&comp_mut->components, entity_to_gi(entity)) : NULL;
+}
+
+bool ecs_has_component(const ECS *ecs, Entity entity, ECSComponentID component_id)
+{
+    ECSComponent *comp = (ECSComponent*)get_component_const(ecs, component_id);
+    if (!comp) return false;
+
+    return comp->tag
+        ? ecs_has_tag(ecs, entity, component_id)
+        : giarray_at(&comp->components, entity_to_gi(entity)) != NULL;
+}
+
+// Adds or replaces a component without borrowing it. A NULL value adds the component zeroed.
+static void *add_component(ECS *ecs, Entity entity, ECSComponentID component_id, const void *value)
+{
+    ECSComponent *comp = get_component(ecs, component_id);
+    if (!comp)
+        PANIC("Tried to add unregistered component with id: %u\n", component_id);
+    if (comp->tag)
+        PANIC("Tried to add tag '%s' as a component, use ecs_add_tag\n", comp->name);
+    if (!ecs_is_entity_valid(ecs, entity))
+        PANIC("Tried to add component '%s' to a destroyed entity\n", comp->name);
+
+    GenerationalIndex gi = entity_to_gi(entity);
+
+    bool added = !giarray_at(&comp->components, gi);
+
+    if (comp->singleton && comp->components.dense_indices.item_count > 0 && added)
+        PANIC("Tried to add singleton component '%s' to a second entity\n", comp->name);
+
+    void *result = giarray_set_copy_or_zeroed(&comp->components, gi, value);
+
+    if (comp->group)
+        group_try_add_index(ecs, vec_at(&ecs->groups, comp->group - 1), gi.index);
+
+    stamp_change_tick(&comp->components, gi);
+
+    if (added)
+    {
+        // Added first so listeners of the component can already reach its side table.
+        if (comp->side_table && !ecs_has_component(ecs, entity, comp->side_table - 1))
+            add_component(ecs, entity, comp->side_table - 1, comp->side_table_prototype);
+
+        cached_queries_on_add(ecs, component_id, gi);
+        dispatch_event(ecs, ECS_EVENT_COMPONENT_ADDED, component_id, entity, result);
+    }
+
+    return result;
+}
+
+void *ecs_add_component_zeroed(ECS *ecs, Entity entity, ECSComponentID component_id, const char *debug_file, int debug_line)
+{
+    panic_if_soa(get_component(ecs, component_id));
+
+    void *result = add_component(ecs, entity, component_id, NULL);
+
+    track_borrow(ecs, result, entity, component_id, debug_file, debug_line);
+
+    return result;
+}
+
+void ecs_remove_component(ECS *ecs, Entity entity, ECSComponentID component_id)
+{
+    ECSComponent *comp = get_component(ecs, component_id);
+    if (!comp) return;
+
+    GenerationalIndex gi = entity_to_gi(entity);
+
+    if (comp->tag)
+    {
+        if (!ecs_has_tag(ecs, entity, component_id)) return;
+
+        dispatch_event(ecs, ECS_EVENT_COMPONENT_REMOVED, component_id, entity, NULL);
+        bitset_set(&comp->tag_bits, gi.index, false);
+        cached_queries_on_remove(ecs, component_id, gi.index);
+        return;
+    }
+
+    const void *component = giarray_at(&comp->components, gi);
+    if (!component) return;
+
+    dispatch_event(ecs, ECS_EVENT_COMPONENT_REMOVED, component_id, entity, component);
+    bitset_set(&comp->pending_bits, gi.index, false);
+
+    if (comp->group)
+        group_remove_index(ecs, vec_at(&ecs->groups, comp->group - 1), gi.index);
+
+    cached_queries_on_remove(ecs, component_id, gi.index);
+    giarray_remove(&comp->components, gi);
+
+    if (comp->side_table)
+        ecs_remove_component(ecs, entity, comp->side_table - 1);
+}
+
+void ecs_add_tag(ECS *ecs, Entity entity, ECSComponentID tag_id)
+{
+    ECSComponent *comp = get_component(ecs, tag_id);
+    if (!comp || !comp->tag)
+        PANIC("Tried to add unregistered tag with id: %u\n", tag_id);
+    if (!ecs_is_entity_valid(ecs, entity))
+        PANIC("Tried to add tag '%s' to a destroyed entity\n", comp->name);
+
+    GenerationalIndex gi = entity_to_gi(entity);
+    if (bitset_get(&comp->tag_bits, gi.index)) return;
+
+    bitset_set(&comp->tag_bits, gi.index, true);
+    cached_queries_on_add(ecs, tag_id, gi);
+    dispatch_event(ecs, ECS_EVENT_COMPONENT_ADDED, tag_id, entity, NULL);
+}
+
+bool ecs_has_tag(const ECS *ecs, Entity entity, ECSComponentID tag_id)
+{
+    const ECSComponent *comp = get_component_const(ecs, tag_id);
+
+    return comp && comp->tag
+        && ecs_is_entity_valid(ecs, entity)
+        && bitset_get(&comp->tag_bits, entity_to_gi(entity).index);
+}
+
+void ecs_add_components(ECS *ecs, size_t count, const Entity *entities, ECSComponentID component_id, const void *prototype)
+{
+    ECSComponent *comp = get_component(ecs, component_id);
+    if (!comp)
+        PANIC("Tried to add unregistered component with id: %u\n", component_id);
+    if (comp->tag)
+        PANIC("Tried to add tag '%s' as a component, use ecs_add_tag\n", comp->name);
+
+    GenerationalIndex *indices = malloc(count * sizeof(GenerationalIndex));
+    bool *added = malloc(count * sizeof(bool));
+    Entity new_singleton = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!ecs_is_entity_valid(ecs, entities[i]))
+            PANIC("Tried to add component '%s' to a destroyed entity\n", comp->name);
+
+        indices[i] = entity_to_gi(entities[i]);
+        added[i] = !giarray_at(&comp->components, indices[i]);
+
+        // Like a single add, only creating an instance next to an existing one is an error.
+        if (comp->singleton && added[i])
+        {
+            if (comp->components.dense_indices.item_count > 0 || (new_singleton && new_singleton != entities[i]))
+                PANIC("Tried to add singleton component '%s' to more than one entity\n", comp->name);
+
+            new_singleton = entities[i];
+        }
+    }
+
+    size_t first_new_slot = comp->components.dense_indices.item_count;
+    giarray_set_copy_many(&comp->components, count, indices, prototype);
+
+    // An entity listed more than once is only added by its first occurrence, which claims its new dense slot.
+    bool *claimed = calloc(comp->components.dense_indices.item_count - first_new_slot + 1, sizeof(bool));
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!added[i]) continue;
+
+        size_t slot = giarray_dense_slot(&comp->components, indices[i].index) - 1 - first_new_slot;
+        added[i] = !claimed[slot];
+        claimed[slot] = true;
+    }
+
+    free(claimed);
+
+    ECSGroup *group = comp->group ? vec_at(&ecs->groups, comp->group - 1) : NULL;
+    ECSTick tick = next_change_tick();
+
+    if (comp->side_table)
+    {
+        Entity *missing = malloc(count * sizeof(Entity));
+        size_t missing_count = 0;
+
+        for (size_t i = 0; i < count; ++i)
+            if (added[i] && !ecs_has_component(ecs, entities[i], comp->side_table - 1))
+                missing[missing_count++] = entities[i];
+
+        ecs_add_components(ecs, missing_count, missing, comp->side_table - 1, comp->side_table_prototype);
+        free(missing);
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (group) group_try_add_index(ecs, group, indices[i].index);
+        if (added[i]) cached_queries_on_add(ecs, component_id, indices[i]);
+        *giarray_tick_at(&comp->components, indices[i].index) = tick;
+    }
+
+    if (comp->event_listeners.item_count > 0)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const void *component = giarray_at(&comp->components, indices[i]);
+
+            if (added[i]) dispatch_event(ecs, ECS_EVENT_COMPONENT_ADDED, component_id, entities[i], component);
+            dispatch_event(ecs, ECS_EVENT_COMPONENT_CHANGED, component_id, entities[i], component);
+        }
+    }
+
+    free(added);
+    free(indices);
+}
+
+const void *ecs_view_component_by_name(const ECS *ecs, Entity entity, const char *component_type)
+{
+    ECSComponentID id;
+    return ecs_find_component_id(ecs, component_type, &id) ? ecs_view_component(ecs, entity, id) : NULL;
+}
+
+void *ecs_add_component_zeroed_by_name(ECS *ecs, Entity entity, const char *component_type, const char *debug_file, int debug_line)
+{
+    ECSComponentID id;
+    if (!ecs_find_component_id(ecs, component_type, &id))
+        PANIC("Tried to add unregistered component: '%s'\n", component_type);
+
+    return ecs_add_component_zeroed(ecs, entity, id, debug_file, debug_line);
+}
+
+void ecs_remove_component_by_name(ECS *ecs, Entity entity, const char *component_type)
+{
+    ECSComponentID id;
+    if (ecs_find_component_id(ecs, component_type, &id))
+        ecs_remove_component(ecs, entity, id);
+}
+
+void *ecs_borrow_component_by_name(ECS *ecs, Entity entity, const char *component_type, const char *debug_file, int debug_line)
+{
+    ECSComponentID id;
+    return ecs_find_component_id(ecs, component_type, &id) ? ecs_borrow_component(ecs, entity, id, debug_file, debug_line) : NULL;
+}
+
+typedef enum ECSCommandType
+{
+    ECS_COMMAND_CREATE_ENTITY,
+    ECS_COMMAND_DESTROY_ENTITY,
+    ECS_COMMAND_ADD_COMPONENT,
+    ECS_COMMAND_REMOVE_COMPONENT,
+}
+ECSCommandType;
+
+typedef struct ECSCommand
+{
+    ECSCommandType type;
+    Entity entity;
+    ECSComponentID component_id;
+    size_t value_offset; // in to ECSCommandBuffer.values
+    size_t value_size;
+}
+ECSCommand;
+
+// Entities created by a command buffer are pending until it plays back. Until then they are represented by
+// their creation order in the high 32 bits with a zero low half, which real entities never have.
+static bool is_pending_entity(Entity entity)
+{
+    return entity != 0 && (uint32_t)entity == 0;
+}
+
+struct ECSCommandBuffer
+{
+    Vec commands; // of ECSCommand
+    Vec values; // of uint8_t, component values for ECS_COMMAND_ADD_COMPONENT
+    uint64_t pending_entity_count;
+};
+
+ECSCommandBuffer *ecs_commands_new(void)
+{
+    ECSCommandBuffer *commands = malloc(sizeof(ECSCommandBuffer));
+    commands->commands = vec_empty(sizeof(ECSCommand));
+    commands->values = vec_empty(sizeof(uint8_t));
+    commands->pending_entity_count = 0;
+    return commands;
+}
+
+void ecs_commands_delete(ECSCommandBuffer *commands)
+{
+    if (!commands) return;
+
+    vec_clear(&commands->commands);
+    vec_clear(&commands->values);
+    free(commands);
+}
+
+Entity ecs_commands_create_entity(ECSCommandBuffer *commands)
+{
+    ECSCommand command = { ECS_COMMAND_CREATE_ENTITY };
+    vec_push_copy(&commands->commands, &command);
+
+    if (commands->pending_entity_count == UINT32_MAX)
+        PANIC("Tried to create too many entities in one command buffer\n");
+
+    return ++commands->pending_entity_count << 32;
+}
+
+void ecs_commands_destroy_entity(ECSCommandBuffer *commands, Entity entity)
+{
+    ECSCommand command = { ECS_COMMAND_DESTROY_ENTITY, entity };
+    vec_push_copy(&commands->commands, &command);
+}
+
+void ecs_commands_add_component(ECSCommandBuffer *commands, Entity entity, ECSComponentID component_id, size_t component_size, const void *value)
+{
+    ECSCommand command = { ECS_COMMAND_ADD_COMPONENT, entity, component_id, commands->values.item_count, component_size };
+    vec_push_copy(&commands->commands, &command);
+    vec_resize(&commands->values, commands->values.item_count + component_size);
+
+    if (value)
+        memcpy(vec_at(&commands->values, command.value_offset), value, component_size);
+}
+
+void ecs_commands_remove_component(ECSCommandBuffer *commands, Entity entity, ECSComponentID component_id)
+{
+    ECSCommand command = { ECS_COMMAND_REMOVE_COMPONENT, entity, component_id };
+    vec_push_copy(&commands->commands, &command);
+}
+
+static Entity resolve_command_entity(const Vec *created_entities, Entity entity)
+{
+    if (!is_pending_entity(entity)) return entity;
+
+    uint64_t pending_index = (entity >> 32) - 1;
+    if (pending_index >= created_entities->item_count)
+        PANIC("Command buffer referenced an entity created by a different command buffer\n");
+
+    return *(const Entity*)vec_at_const(created_entities, pending_index);
+}
+
+void ecs_commands_play(ECSCommandBuffer *commands, ECS *ecs)
+{
+    Vec created_entities = vec_empty(sizeof(Entity));
+
+    for (size_t i = 0; i < commands->commands.item_count; ++i)
+    {
+        const ECSCommand *command = vec_at_const(&commands->commands, i);
+
+        if (command->type == ECS_COMMAND_CREATE_ENTITY)
+        {
+            Entity created = ecs_create_entity(ecs);
+            vec_push_copy(&created_entities, &created);
+            continue;
+        }
+
+        Entity entity = resolve_command_entity(&created_entities, command->entity);
+
+        switch (command->type)
+        {
+            case ECS_COMMAND_DESTROY_ENTITY:
+                ecs_destroy_entity(ecs, entity);
+                break;
+
+            case ECS_COMMAND_REMOVE_COMPONENT:
+                ecs_remove_component(ecs, entity, command->component_id);
+                break;
+
+            case ECS_COMMAND_ADD_COMPONENT:
+            {
+                const ECSComponent *comp = get_component(ecs, command->component_id);
+                void *value = vec_at(&commands->values, command->value_offset);
+
+                if (!comp || comp->size != command->value_size)
+                    PANIC("Command buffer added a component with unknown id or mismatched size: %u\n", command->component_id);
+
+                if (comp->tag)
+                {
+                    if (ecs_is_entity_valid(ecs, entity)) ecs_add_tag(ecs, entity, command->component_id);
+                    break;
+                }
+
+                // The buffer owns the value until it is moved in to the ECS, so clean it up if its entity is gone.
+                if (!ecs_is_entity_valid(ecs, entity))
+                {
+                    if (comp->destructor) comp->destructor(value);
+                    break;
+                }
+
+                void *component = add_component(ecs, entity, command->component_id, value);
+                dispatch_event(ecs, ECS_EVENT_COMPONENT_CHANGED, command->component_id, entity, component);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    vec_clear(&created_entities);
+    vec_clear(&commands->commands);
+    vec_clear(&commands->values);
+    commands->pending_entity_count = 0;
+}
+
+bool ecs_find_first_entity_with_component(const ECS *ecs, ECSComponentID component_id, Entity *out_entity)
+{
+    const ECSComponent *comp = get_component_const(ecs, component_id);
+
+    if (comp && comp->tag)
+    {
+        ECSQuery query = ecs_query_begin((ECS*)ecs, 1, &component_id);
+        if (!ecs_query_next(&query)) return false;
+
+        *out_entity = query.entity;
+        return true;
+    }
+
+    return first_component_slot(comp, out_entity);
+}
+
+Entity *ecs_find_all_entities_with_component_alloc(const ECS *ecs, ECSComponentID component_id, size_t *result_length)
+{
+    const ECSComponent *comp = get_component_const(ecs, component_id);
+    if (!comp) return NULL;
+
+    if (comp->tag)
+    {
+        ECSQuery query = ecs_query_begin((ECS*)ecs, 1, &component_id);
+        Vec tagged = vec_empty(sizeof(Entity));
+
+        while (ecs_query_next(&query))
+            vec_push_copy(&tagged, &query.entity);
+
+        *result_length = tagged.item_count;
+        return tagged.data;
+    }
+
+    GenerationalIndex *result = giarray_get_all_valid_indices_alloc(&comp->components, &ecs->allocator, result_length);
+
+    for (int i = 0; i < *result_length; ++i)
+        ((Entity*)result)[i] = gi_to_entity(result[i]);
+
+    return (Entity*)result;
+}
+
+Entity *ecs_find_all_entities_alloc(const ECS *ecs, size_t *result_length)
+{
+    const GenerationalIndex *result = giallocator_get_all_allocated_indices_alloc(&ecs->allocator, result_length);
+
+    for (int i = 0; i < *result_length; ++i)
+        ((Entity*)result)[i] = gi_to_entity(result[i]);
+
+    return (Entity*)result;
+}
+
+static bool check_event_listeners_entries_match(EventListenerEntry *a, const EventListenerEntry *b)
+{
+    return a->listener == b->listener && a->batch_listener == b->batch_listener && a->type == b->type;
+}
+
+static void register_event_listener_entry(ECS *ecs, ECSComponentID component_id, const EventListenerEntry *entry)
+{
+    ECSComponent *comp = get_component(ecs, component_id);
+    if (!comp)
+        PANIC("Tried to register an event listener on unregistered component with id: %u\n", component_id);
+
+    int found_index = vec_find_index(&comp->event_listeners, (void*)entry, check_event_listeners_entries_match);
+    if (found_index >= 0) return;
+
+#ifdef ECS_NO_BORROW_CHECKS
+    if (comp->event_listeners.item_count == 0) ecs->listened_type_count++;
+#endif
+
+    vec_push_copy(&comp->event_listeners, entry);
+}
+
+static void remove_event_listener_entry(ECS *ecs, ECSComponentID component_id, const EventListenerEntry *entry)
+{
+    ECSComponent *comp = get_component(ecs, component_id);
+    if (!comp) return;
+
+    int found_index = vec_find_index(&comp->event_listeners, (void*)entry, check_event_listeners_entries_match);
+
+    if (found_index < 0) return;
+
+    vec_remove(&comp->event_listeners, found_index);
+
+#ifdef ECS_NO_BORROW_CHECKS
+    // Records of borrows made while the type was listened to would otherwise linger.
+    if (comp->event_listeners.item_count == 0 && --ecs->listened_type_count == 0)
+        borrowset_clear(&ecs->borrowed_components);
+#endif
+}
+
+void ecs_register_event_listener(ECS *ecs, ECSComponentEventType event_type, ECSComponentID component_id, ECSComponentEventListener listener)
+{
+    EventListenerEntry entry = {
+        .type = event_type,
+        .listener = listener
+    };
+
+    register_event_listener_entry(ecs, component_id, &entry);
+}
+
+void ecs_remove_event_listener(ECS *ecs, ECSComponentEventType event_type, ECSComponentID component_id, ECSComponentEventListener listener)
+{
+    EventListenerEntry entry = {
+        .type = event_type,
+        .listener = listener
+    };
+
+    remove_event_listener_entry(ecs, component_id, &entry);
+}
+
+void ecs_register_batch_event_listener(ECS *ecs, ECSComponentEventType event_type, ECSComponentID component_id, ECSComponentBatchEventListener listener)
+{
+    EventListenerEntry entry = {
+        .type = event_type,
+        .batch_listener = listener
+    };
+
+    register_event_listener_entry(ecs, component_id, &entry);
+}
+
+void ecs_remove_batch_event_listener(ECS *ecs, ECSComponentEventType event_type, ECSComponentID component_id, ECSComponentBatchEventListener listener)
+{
+    EventListenerEntry entry = {
+        .type = event_type,
+        .batch_listener = listener
+    };
+
+    remove_event_listener_entry(ecs, component_id, &entry);
+}
+
+
+#ifdef RUN_TESTS
+static int test_destructor_call_count;
+static void test_destructor(void *value)
+{
+    test_destructor_call_count++;
+}
+
+static int test_destructor_calls;
+static void test_count_destructor(void *component)
+{
+    test_destructor_calls++;
+}
+
+static size_t test_deep_copied_count;
+static void test_deep_copier(ECSComponentID component_id, void *components, size_t count)
+{
+    test_deep_copied_count += count;
+}
+
+static float test_change_event_listener_sum;
+static void test_change_event_listener(Entity e, const float *component)
+{
+    test_change_event_listener_sum += *component;
+}
+
+static int test_added_event_count;
+static void test_added_event_listener(Entity e, const void *component)
+{
+    test_added_event_count++;
+}
+
+static size_t test_batch_event_calls;
+static size_t test_batch_event_total;
+static void test_batch_event_listener(const Entity *entities, size_t count)
+{
+    test_batch_event_calls++;
+    test_batch_event_total += count;
+}
+
+static int test_removed_event_count;
+static void test_removed_event_listener(Entity e, const float *component)
+{
+    if (*component == 1.f) test_removed_event_count++;
+}
+
+typedef struct TestSoa
+{
+    float x;
+    uint8_t flag;
+    double y;
+}
+TestSoa;
+
+enum
+{
+    float_id,
+    uint32_t_id,
+    int16_t_id,
+    TestSoa_id,
+};
+
+static const ECSSoaField test_soa_fields[] = {
+    { offsetof(TestSoa, x), sizeof(float) },
+    { offsetof(TestSoa, flag), sizeof(uint8_t) },
+    { offsetof(TestSoa, y), sizeof(double) },
+};
+
+#define TestSoa_x(ref) (((float*)((ref).page))[(ref).lane])
+#define TestSoa_y(ref) (((double*)((ref).page + ECS_PAGE_ITEM_COUNT * (sizeof(float) + sizeof(uint8_t))))[(ref).lane])
+
+static const float float_default = 2.f;
+
+TestResult ecs_test()
+{
+    TEST_BEGIN("GenerationalIndexAllocator works");
+
+        GenerationalIndexAllocator alloc = giallocator_empty();
+
+        GenerationalIndex i = giallocator_allocate(&alloc);
+        GenerationalIndex j = giallocator_allocate(&alloc);
+
+        TEST_ASSERT(i.generation == 0 && i.index == 0);
+        TEST_ASSERT(j.generation == 0 && j.index == 1);
+
+        TEST_ASSERT( giallocator_deallocate(&alloc, i));
+        TEST_ASSERT(!giallocator_deallocate(&alloc, i));
+
+        GenerationalIndex k = giallocator_allocate(&alloc);
+
+        TEST_ASSERT(k.generation == 1 && k.index == 0);
+
+        TEST_ASSERT(!giallocator_is_index_live(&alloc, i));
+        TEST_ASSERT( giallocator_is_index_live(&alloc, j));
+        TEST_ASSERT( giallocator_is_index_live(&alloc, k));
+
+        giallocator_clear(&alloc);
+
+    TEST_END();
+    TEST_BEGIN("GenerationalIndexAllocator get all indices works");
+
+        GenerationalIndexAllocator alloc = giallocator_empty();
+
+        giallocator_allocate(&alloc); // [(0,0)]
+        GenerationalIndex j = giallocator_allocate(&alloc); // [(0,0), (0,1)]
+
+        giallocator_deallocate(&alloc, j); // [(0,0), (x,1)]
+
+        giallocator_allocate(&alloc); // [(0,0), (1,1)]
+        GenerationalIndex l = giallocator_allocate(&alloc); // [(0,0), (1,1), (0,2)]
+        giallocator_allocate(&alloc); // [(0,0), (1,1), (0,2), (0,3)]
+
+        giallocator_deallocate(&alloc, l); // [(0,0), (1,1), (x,2), (0,3)]
+
+        size_t num_indices;
+        GenerationalIndex *indices = giallocator_get_all_allocated_indices_alloc(&alloc, &num_indices);
+
+        TEST_ASSERT(num_indices == 3);
+        TEST_ASSERT(indices[0].generation == 0 && indices[0].index == 0);
+        TEST_ASSERT(indices[1].generation == 1 && indices[1].index == 1);
+        TEST_ASSERT(indices[2].generation == 0 && indices[2].index == 3);
+
+        free(indices);
+        giallocator_clear(&alloc);
+
+    TEST_END();
+    TEST_BEGIN("GenerationalIndexArray works with multiple generations");
+
+        typedef struct TestArrayElem
+        {
+            float x;
+            int16_t y;
+        }
+        TestArrayElem;
+
+        GenerationalIndexAllocator alloc = giallocator_empty();
+        GenerationalIndexArray arr = giarray_empty(sizeof(TestArrayElem), test_destructor);
+
+        test_destructor_call_count = 0;
+
+        GenerationalIndex i = giallocator_allocate(&alloc);
+        TestArrayElem val_in = { 4.0f, 19 };
+        giarray_set_copy_or_zeroed(&arr, i, &val_in);
+
+        TestArrayElem *val_out = giarray_at(&arr, i);
+
+        TEST_ASSERT(val_out);
+        TEST_ASSERT(val_out != &val_in);
+        TEST_ASSERT(val_out->x == 4.0f && val_out->y == 19);
+        TEST_ASSERT(test_destructor_call_count == 0);
+
+        giallocator_deallocate(&alloc, i);
+
+        GenerationalIndex j = giallocator_allocate(&alloc);
+        TestArrayElem *val_out2 = giarray_set_copy_or_zeroed(&arr, j, 0);
+
+        TEST_ASSERT(test_destructor_call_count == 1);
+
+        TEST_ASSERT(!giarray_at(&arr, i));
+
+        TEST_ASSERT(val_out2);
+        TEST_ASSERT(val_out2->x == 0.0f && val_out->y == 0);
+
+        giarray_clear(&arr);
+        giallocator_clear(&alloc);
+
+        TEST_ASSERT(test_destructor_call_count == 2);
+
+    TEST_END();
+    TEST_BEGIN("GenerationalIndexArray find all valid indices works");
+
+        GenerationalIndexAllocator alloc = giallocator_empty();
+        GenerationalIndexArray arr = giarray_empty(sizeof(float), NULL);
+        GenerationalIndex i0 = giallocator_allocate(&alloc);
+        GenerationalIndex i1 = giallocator_allocate(&alloc);
+        GenerationalIndex i2 = giallocator_allocate(&alloc);
+
+        float *f0 = giarray_set_copy_or_zeroed(&arr, i0, 0);
+        float *f1 = giarray_set_copy_or_zeroed(&arr, i1, 0);
+        float *f2 = giarray_set_copy_or_zeroed(&arr, i2, 0);
+
+        giarray_remove(&arr, i1);
+
+        size_t result_count;
+        GenerationalIndex *results = giarray_get_all_valid_indices_alloc(&arr, &alloc, &result_count);
+
+        TEST_ASSERT(result_count == 2);
+        TEST_ASSERT(results[0].generation == i0.generation && results[0].index == i0.index);
+        TEST_ASSERT(results[1].generation == i2.generation && results[1].index == i2.index);
+
+        free(results);
+
+        giarray_clear(&arr);
+        giallocator_clear(&alloc);
+
+    TEST_END();
+    TEST_BEGIN("GenerationalIndexArray remove element works, destructor not called twice");
+
+        GenerationalIndexAllocator alloc = giallocator_empty();
+        GenerationalIndexArray arr = giarray_empty(sizeof(float), test_destructor);
+        GenerationalIndex i = giallocator_allocate(&alloc);
+
+        test_destructor_call_count = 0;
+
+        giarray_set_copy_or_zeroed(&arr, i, 0);
+        TEST_ASSERT(giarray_at(&arr, i));
+
+        giarray_remove(&arr, i);
+        TEST_ASSERT(!giarray_at(&arr, i));
+
+        TEST_ASSERT(test_destructor_call_count == 1);
+
+        giarray_clear(&arr);
+        giallocator_clear(&alloc);
+
+        TEST_ASSERT(test_destructor_call_count == 1);
+
+    TEST_END();
+    TEST_BEGIN("GenerationalIndexArray remove swaps the last index in to the hole and leaves items in place");
+
+        GenerationalIndexAllocator alloc = giallocator_empty();
+        GenerationalIndexArray arr = giarray_empty(sizeof(float), NULL);
+        GenerationalIndex i0 = giallocator_allocate(&alloc);
+        GenerationalIndex i1 = giallocator_allocate(&alloc);
+        GenerationalIndex i2 = giallocator_allocate(&alloc);
+
+        float f0 = 1.f, f1 = 2.f, f2 = 3.f;
+        giarray_set_copy_or_zeroed(&arr, i0, &f0);
+        giarray_set_copy_or_zeroed(&arr, i1, &f1);
+        const float *item2 = giarray_set_copy_or_zeroed(&arr, i2, &f2);
+
+        giarray_remove(&arr, i0);
+
+        TEST_ASSERT(arr.dense_indices.item_count == 2);
+        TEST_ASSERT(!giarray_at(&arr, i0));
+        TEST_ASSERT(((GenerationalIndex*)arr.dense_indices.data)->index == i2.index);
+        TEST_ASSERT(giarray_at(&arr, i2) == item2 && *item2 == 3.f);
+        TEST_ASSERT(*(float*)giarray_at(&arr, i1) == 2.f);
+
+        giarray_remove(&arr, i2);
+        giarray_remove(&arr, i1);
+
+        TEST_ASSERT(arr.dense_indices.item_count == 0);
+        TEST_ASSERT(!giarray_at(&arr, i1) && !giarray_at(&arr, i2));
+
+        giarray_clear(&arr);
+        giallocator_clear(&alloc);
+
+    TEST_END();
+    TEST_BEGIN("Entity to GenerationalIndex conversion reverses");
+
+        {
+            GenerationalIndex i = { 29, 119 };
+            GenerationalIndex j = entity_to_gi(gi_to_entity(i));
             TEST_ASSERT(i.index == j.index && i.generation == j.generation);
         } {
             GenerationalIndex i = { 0, 0 };
             GenerationalIndex j = entity_to_gi(gi_to_entity(i));
             TEST_ASSERT(i.index == j.index && i.generation == j.generation);
+        } {
+            GenerationalIndex i = { 0xFFFFFFFF, ECS_MAX_ENTITY_COUNT - 1 };
+            GenerationalIndex j = entity_to_gi(gi_to_entity(i));
+            TEST_ASSERT(i.index == j.index && i.generation == j.generation);
+            TEST_ASSERT(!is_pending_entity(gi_to_entity(i)));
+        } {
+            GenerationalIndex i = { 0x01000003, 0x01000007 };
+            GenerationalIndex j = entity_to_gi(gi_to_entity(i));
+            TEST_ASSERT(i.index == j.index && i.generation == j.generation);
+        }
+
+    TEST_END();
+    TEST_BEGIN("ECS add component and get component work");
+
+        ECS *ecs = ecs_new();
+
+        Entity e0 = ecs_create_entity(ecs);
+        Entity e1 = ecs_create_entity(ecs);
+
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, set_float0, ecs, e0);
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, set_float1, ecs, e1);
+
+        ECS_VIEW_COMPONENT_DECL(float, get_float, ecs, e1);
+        TEST_ASSERT(set_float1 == get_float);
+
+        ecs_delete(ecs);
+
+    TEST_END();
+    TEST_BEGIN("ECS find all entities with component works");
+
+        ECS *ecs = ecs_new();
+
+        Entity e0 = ecs_create_entity(ecs);
+        Entity e1 = ecs_create_entity(ecs);
+        Entity e2 = ecs_create_entity(ecs);
+
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, _0, ecs, e0);
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, _1, ecs, e2);
+        ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, _2, ecs, e0);
+        ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, _3, ecs, e1);
+        ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, _4, ecs, e2);
+
+        ECS_VIEW_COMPONENT_DECL(float, floaty0, ecs, e0);
+        ECS_VIEW_COMPONENT_DECL(float, floaty2, ecs, e2);
+
+        size_t result_count;
+        Entity *entities = ECS_FIND_ALL_ENTITIES_WITH_COMPONENT_ALLOC(float, ecs, &result_count);
+
+        TEST_ASSERT(result_count == 2);
+
+        ECS_VIEW_COMPONENT_DECL(float, get0, ecs, entities[0]);
+        ECS_VIEW_COMPONENT_DECL(float, get1, ecs, entities[1]);
+
+        TEST_ASSERT(entities[0] == e0 && get0 == floaty0);
+        TEST_ASSERT(entities[1] == e2 && get1 == floaty2);
+
+        free(entities);
+
+        ecs_delete(ecs);
+
+    TEST_END();
+    TEST_BEGIN("ECS find first entity with component works");
+
+        ECS *ecs = ecs_new();
+
+        Entity e0 = ecs_create_entity(ecs);
+        Entity e1 = ecs_create_entity(ecs);
+        Entity entity;
+        bool did_find;
+
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, _0, ecs, e0);
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, _1, ecs, e1);
+        ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, _2, ecs, e1);
+
+        did_find = ECS_FIND_FIRST_ENTITY_WITH_COMPONENT(uint32_t, ecs, &entity);
+        TEST_ASSERT(did_find);
+        TEST_ASSERT(entity == e1);
+
+        did_find = ECS_FIND_FIRST_ENTITY_WITH_COMPONENT(int16_t, ecs, &entity);
+        TEST_ASSERT(!did_find);
+
+        ecs_delete(ecs);
+
+    TEST_END();
+    TEST_BEGIN("ECS remove component works");
+
+        ECS *ecs = ecs_new();
+        Entity e0 = ecs_create_entity(ecs);
+        Entity e1 = ecs_create_entity(ecs);
+        Entity e2 = ecs_create_entity(ecs);
+
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, floaty_set, ecs, e0);
+        ECS_VIEW_COMPONENT_DECL(float, floaty_get, ecs, e0);
+        TEST_ASSERT(floaty_get == floaty_set);
+
+        ECS_REMOVE_COMPONENT(float, ecs, e0);
+        ECS_VIEW_COMPONENT_DECL(float, floaty_get_again, ecs, e0);
+        TEST_ASSERT(!floaty_get_again);
+
+        ecs_delete(ecs);
+
+    TEST_END();
+    TEST_BEGIN("ECS string keyed component access agrees with component IDs");
+
+        ECS *ecs = ecs_new();
+        Entity e0 = ecs_create_entity(ecs);
+        ECSComponentID id;
+
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+
+        TEST_ASSERT(ecs_find_component_id(ecs, "uint32_t", &id) && id == uint32_t_id);
+        TEST_ASSERT(!ecs_find_component_id(ecs, "float", &id));
+
+        uint32_t *by_name = ecs_add_component_zeroed_by_name(ecs, e0, "uint32_t", __FILE__, __LINE__);
+        ECS_RETURN_COMPONENT(ecs, by_name);
+        ECS_VIEW_COMPONENT_DECL(uint32_t, by_id, ecs, e0);
+
+        TEST_ASSERT(by_name == by_id);
+        TEST_ASSERT(ecs_view_component_by_name(ecs, e0, "uint32_t") == by_id);
+        TEST_ASSERT(!ecs_view_component_by_name(ecs, e0, "float"));
+
+        ecs_remove_component_by_name(ecs, e0, "uint32_t");
+        TEST_ASSERT(!ecs_view_component(ecs, e0, uint32_t_id));
+
+        ecs_delete(ecs);
+
+    TEST_END();
+    TEST_BEGIN("ECS groups iterate only entities with every grouped component");
+
+        ECS *ecs = ecs_new();
+        Entity e0 = ecs_create_entity(ecs);
+        Entity e1 = ecs_create_entity(ecs);
+        Entity e2 = ecs_create_entity(ecs);
+        Entity e3 = ecs_create_entity(ecs);
+
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, f0, ecs, e0); *f0 = 0.f; ECS_RETURN_COMPONENT(ecs, f0);
+        ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, u0, ecs, e0); *u0 = 0; ECS_RETURN_COMPONENT(ecs, u0);
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, f1, ecs, e1); *f1 = 1.f; ECS_RETURN_COMPONENT(ecs, f1);
+
+        ECS_REGISTER_GROUP(ecs, uint32_t, float);
+
+        ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, u2, ecs, e2); *u2 = 2; ECS_RETURN_COMPONENT(ecs, u2);
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, f3, ecs, e3); *f3 = 3.f; ECS_RETURN_COMPONENT(ecs, f3);
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, f2, ecs, e2); *f2 = 2.f; ECS_RETURN_COMPONENT(ecs, f2);
+        ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, u3, ecs, e3); *u3 = 3; ECS_RETURN_COMPONENT(ecs, u3);
+
+        ECS_REMOVE_COMPONENT(float, ecs, e0);
+
+        int visited = 0;
+
+        ECS_EACH(query, ecs, uint32_t, float)
+        {
+            uint32_t u = *(uint32_t*)query.components[0];
+            float f = *(float*)query.components[1];
+
+            TEST_ASSERT(query.group_);
+            TEST_ASSERT(query.entity == e2 || query.entity == e3);
+            TEST_ASSERT((float)u == f);
+            TEST_ASSERT(ecs_view_component(ecs, query.entity, float_id) == query.components[1]);
+            visited++;
+        }
+
+        TEST_ASSERT(visited == 2);
+
+        ECS_VIEW_COMPONENT_DECL(float, f1_view, ecs, e1);
+        ECS_VIEW_COMPONENT_DECL(uint32_t, u0_view, ecs, e0);
+        TEST_ASSERT(*f1_view == 1.f && *u0_view == 0);
+
+        ecs_delete(ecs);
+
+    TEST_END();
+    TEST_BEGIN("ECS queries join ungrouped components and skip destroyed entities");
+
+        ECS *ecs = ecs_new();
+        Entity e0 = ecs_create_entity(ecs);
+        Entity e1 = ecs_create_entity(ecs);
+        Entity e2 = ecs_create_entity(ecs);
+
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, f0, ecs, e0);
+        ECS_RETURN_COMPONENT(ecs, f0);
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, f1, ecs, e1);
+        ECS_RETURN_COMPONENT(ecs, f1);
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, f2, ecs, e2);
+        ECS_RETURN_COMPONENT(ecs, f2);
+        ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, u1, ecs, e1);
+        ECS_RETURN_COMPONENT(ecs, u1);
+        ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, u2, ecs, e2);
+        ECS_RETURN_COMPONENT(ecs, u2);
+
+        ecs_destroy_entity(ecs, e2);
+
+        int visited = 0;
+
+        ECS_EACH(query, ecs, float, uint32_t)
+        {
+            TEST_ASSERT(query.entity == e1);
+            TEST_ASSERT(query.components[0] == ecs_view_component(ecs, e1, float_id));
+            TEST_ASSERT(query.components[1] == ecs_view_component(ecs, e1, uint32_t_id));
+            visited++;
+        }
+
+        TEST_ASSERT(visited == 1);
+
+        visited = 0;
+        ECS_EACH(query, ecs, int16_t) visited++;
+        TEST_ASSERT(visited == 0);
+
+        ECS_EACH_ENTITY(query, ecs)
+        {
+            TEST_ASSERT(query.entity == e0 || query.entity == e1);
+            visited++;
+        }
+
+        TEST_ASSERT(visited == 2);
+
+        ecs_delete(ecs);
+
+    TEST_END();
+
+    TEST_BEGIN("ECS batch creates, fills and destroys entities");
+
+        ECS *ecs = ecs_new();
+        Entity entities[300];
+
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+        ECS_REGISTER_GROUP(ecs, float, uint32_t);
+
+        ecs_create_entities(ecs, 150, entities);
+        ecs_destroy_entities(ecs, 100, entities + 50);
+        ecs_create_entities(ecs, 150, entities + 150);
+
+        for (int i = 0; i < 150; ++i)
+            TEST_ASSERT(ecs_is_entity_valid(ecs, entities[i]) == (i < 50));
+        for (int i = 150; i < 300; ++i)
+            TEST_ASSERT(ecs_is_entity_valid(ecs, entities[i]));
+
+        float f = 2.f;
+        uint32_t u = 7;
+        ECS_ADD_COMPONENTS(float, ecs, 150, entities + 150, &f);
+        ECS_ADD_COMPONENTS(uint32_t, ecs, 50, entities, &u);
+        ECS_ADD_COMPONENTS(uint32_t, ecs, 50, entities + 250, &u);
+
+        int visited = 0;
+        ECS_EACH(query, ecs, float, uint32_t)
+        {
+            TEST_ASSERT(*(float*)query.components[0] == 2.f && *(uint32_t*)query.components[1] == 7);
+            visited++;
+        }
+
+        TEST_ASSERT(visited == 50);
+
+        ecs_destroy_entities(ecs, 300, entities);
+
+        visited = 0;
+        ECS_EACH_ENTITY(query, ecs) visited++;
+        TEST_ASSERT(visited == 0);
+
+        ecs_delete(ecs);
+
+    TEST_END();
+
+    TEST_BEGIN("ECS batch adds listing an entity more than once add its component once");
+
+        ECS *ecs = ecs_new();
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+        ECS_REGISTER_QUERY(ecs, float, uint32_t);
+        ECS_REGISTER_EVENT_LISTENER(float, ecs, ECS_EVENT_COMPONENT_ADDED, test_added_event_listener);
+
+        Entity entities[3];
+        ecs_create_entities(ecs, 3, entities);
+
+        float f = 1.f;
+        uint32_t u = 1;
+        ECS_ADD_COMPONENTS(float, ecs, 1, &entities[1], &f);
+        ECS_ADD_COMPONENTS(uint32_t, ecs, 3, entities, &u);
+
+        Entity repeated[5] = { entities[0], entities[1], entities[0], entities[2], entities[2] };
+        test_added_event_count = 0;
+        ECS_ADD_COMPONENTS(float, ecs, 5, repeated, &f);
+
+        TEST_ASSERT(test_added_event_count == 2);
+
+        int visited = 0;
+        ECS_EACH(query, ecs, float, uint32_t) visited++;
+        TEST_ASSERT(visited == 3);
+
+        ECS_REMOVE_EVENT_LISTENER(float, ecs, ECS_EVENT_COMPONENT_ADDED, test_added_event_listener);
+        ecs_delete(ecs);
+
+    TEST_END();
+
+    TEST_BEGIN("ECS destroying entities releases their components and compaction trims dead slots");
+
+        ECS *ecs = ecs_new();
+        Entity entities[10];
+
+        ECS_REGISTER_COMPONENT(float, ecs, test_count_destructor);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+        ECS_REGISTER_GROUP(ecs, float, uint32_t);
+
+        float f = 1.f;
+        uint32_t u = 1;
+        ecs_create_entities(ecs, 10, entities);
+        ECS_ADD_COMPONENTS(float, ecs, 10, entities, &f);
+        ECS_ADD_COMPONENTS(uint32_t, ecs, 10, entities, &u);
+
+        test_destructor_calls = 0;
+        ecs_destroy_entity(ecs, entities[0]);
+        ecs_destroy_entities(ecs, 5, entities + 5);
+
+        TEST_ASSERT(test_destructor_calls == 6);
+        TEST_ASSERT(ecs_view_component(ecs, entities[9], float_id) == NULL);
+
+        int visited = 0;
+        ECS_EACH(query, ecs, float, uint32_t) visited++;
+        TEST_ASSERT(visited == 4);
+
+        ecs_compact(ecs);
+        TEST_ASSERT(ecs->allocator.generations.item_count == 5);
+        TEST_ASSERT(get_component(ecs, float_id)->components.sparse.item_count == 5);
+
+        Entity reused[6];
+        ecs_create_entities(ecs, 6, reused);
+
+        for (int i = 5; i < 10; ++i)
+            TEST_ASSERT(!ecs_is_entity_valid(ecs, entities[i]));
+        for (int i = 0; i < 6; ++i)
+            TEST_ASSERT(ecs_is_entity_valid(ecs, reused[i]));
+
+        ecs_delete(ecs);
+
+    TEST_END();
+
+    TEST_BEGIN("ECS skips IDs that were never registered when walking every component");
+
+        ECS *ecs = ecs_new();
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+
+        uint32_t u = 3;
+        Entity e = ecs_create_entity(ecs);
+        ECS_ADD_COMPONENTS(uint32_t, ecs, 1, &e, &u);
+        ecs_mark_all_changed(ecs);
+
+        ECS *clone = ecs_clone(ecs, NULL);
+        TEST_ASSERT(*(uint32_t*)ecs_view_component(clone, e, uint32_t_id) == 3);
+        ecs_delete(clone);
+
+        ecs_destroy_entity(ecs, e);
+        ecs_compact(ecs);
+
+        TEST_ASSERT(!ecs_is_entity_valid(ecs, e));
+        TEST_ASSERT(ecs->allocator.generations.item_count == 0);
+
+        ecs_delete(ecs);
+
+    TEST_END();
+
+    TEST_BEGIN("ECS clones are independent copies with the same entities");
+
+        ECS *ecs = ecs_new();
+        Entity entities[4];
+
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+        ECS_REGISTER_GROUP(ecs, float, uint32_t);
+
+        float f = 1.f;
+        uint32_t u = 2;
+        ecs_create_entities(ecs, 4, entities);
+        ECS_ADD_COMPONENTS(float, ecs, 4, entities, &f);
+        ECS_ADD_COMPONENTS(uint32_t, ecs, 2, entities + 2, &u);
+        ecs_destroy_entity(ecs, entities[3]);
+
+        test_deep_copied_count = 0;
+        ECS *clone = ecs_clone(ecs, test_deep_copier);
+        TEST_ASSERT(test_deep_copied_count == 4);
+
+        ECS_BORROW_COMPONENT_DECL(float, original_f, ecs, entities[2]);
+        *original_f = 5.f;
+        ECS_RETURN_COMPONENT(ecs, original_f);
+
+        int visited = 0;
+        ECS_EACH(query, clone, float, uint32_t)
+        {
+            TEST_ASSERT(query.entity == entities[2]);
+            TEST_ASSERT(*(float*)query.components[0] == 1.f);
+            visited++;
         }
 
+        TEST_ASSERT(visited == 1);
+        TEST_ASSERT(!ecs_is_entity_valid(clone, entities[3]));
+        TEST_ASSERT(ecs_create_entity(clone) == ecs_create_entity(ecs));
+
+        ECSComponentID id;
+        TEST_ASSERT(ecs_find_component_id(clone, "uint32_t", &id) && id == uint32_t_id);
+
+        ecs_delete(clone);
+        ecs_delete(ecs);
+
     TEST_END();
-    TEST_BEGIN("ECS add component and get component work");
+
+    TEST_BEGIN("ECS command buffers defer structural changes until played back");
 
         ECS *ecs = ecs_new();
+        ECSCommandBuffer *commands = ecs_commands_new();
+
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+
+        Entity existing = ecs_create_entity(ecs);
+        ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, u, ecs, existing);
+        ECS_RETURN_COMPONENT(ecs, u);
+
+        float f = 4.f;
+        Entity pending = ecs_commands_create_entity(commands);
+        Entity doomed = ecs_commands_create_entity(commands);
+        ECS_COMMANDS_ADD_COMPONENT(float, commands, pending, &f);
+        ECS_COMMANDS_ADD_COMPONENT(float, commands, existing, &f);
+        ECS_COMMANDS_REMOVE_COMPONENT(uint32_t, commands, existing);
+        ecs_commands_destroy_entity(commands, doomed);
+        ECS_COMMANDS_ADD_COMPONENT(float, commands, doomed, &f);
+
+        TEST_ASSERT(ecs_view_component(ecs, existing, float_id) == NULL);
+        TEST_ASSERT(ecs_view_component(ecs, existing, uint32_t_id) != NULL);
+
+        ecs_commands_play(commands, ecs);
+
+        int visited = 0;
+        ECS_EACH(query, ecs, float)
+        {
+            TEST_ASSERT(*(float*)query.components[0] == 4.f);
+            TEST_ASSERT(query.entity != existing || ecs_view_component(ecs, existing, uint32_t_id) == NULL);
+            visited++;
+        }
+
+        TEST_ASSERT(visited == 2);
+
+        visited = 0;
+        ECS_EACH_ENTITY(query, ecs) visited++;
+        TEST_ASSERT(visited == 2);
+
+        ecs_commands_play(commands, ecs);
+        ECS_EACH_ENTITY(query, ecs) visited++;
+        TEST_ASSERT(visited == 4);
+
+        ecs_commands_delete(commands);
+        ecs_delete(ecs);
+
+    TEST_END();
+
+    TEST_BEGIN("ECS change ticks filter queries to recently changed components");
 
+        ECS *ecs = ecs_new();
         Entity e0 = ecs_create_entity(ecs);
         Entity e1 = ecs_create_entity(ecs);
 
         ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+        ECS_REGISTER_COMPONENT(int16_t, ecs, NULL);
+        ECS_REGISTER_GROUP(ecs, float, uint32_t);
 
-        ECS_ADD_COMPONENT_ZEROED_DECL(float, set_float0, ecs, e0);
-        ECS_ADD_COMPONENT_ZEROED_DECL(float, set_float1, ecs, e1);
+        ECSTick before_add = ecs_get_change_tick();
 
-        ECS_VIEW_COMPONENT_DECL(float, get_float, ecs, e1);
-        TEST_ASSERT(set_float1 == get_float);
+        for (int i = 0; i < 2; ++i)
+        {
+            Entity e = i ? e1 : e0;
+            ECS_ADD_COMPONENT_ZEROED_DECL(float, f, ecs, e);
+            ECS_RETURN_COMPONENT(ecs, f);
+            ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, u, ecs, e);
+            ECS_RETURN_COMPONENT(ecs, u);
+            ECS_ADD_COMPONENT_ZEROED_DECL(int16_t, s, ecs, e);
+            ECS_RETURN_COMPONENT(ecs, s);
+        }
+
+        ECSTick after_add = ecs_get_change_tick();
+        int visited = 0;
+
+        TEST_ASSERT(ecs_get_component_change_tick(ecs, e0, float_id) > before_add);
+        ECS_EACH_CHANGED_SINCE(query, ecs, before_add, float, uint32_t, int16_t) visited++;
+        TEST_ASSERT(visited == 2);
+
+        visited = 0;
+        ECS_EACH_CHANGED_SINCE(query, ecs, after_add, float, uint32_t, int16_t) visited++;
+        TEST_ASSERT(visited == 0);
+
+        ECS_BORROW_COMPONENT_DECL(int16_t, s1, ecs, e1);
+        ECS_RETURN_COMPONENT(ecs, s1);
+
+        ECS_EACH_CHANGED_SINCE(query, ecs, after_add, float, uint32_t, int16_t)
+        {
+            TEST_ASSERT(query.entity == e1);
+            visited++;
+        }
+
+        TEST_ASSERT(visited == 1);
+
+        ECSTick after_borrow = ecs_get_change_tick();
+        ECS_BORROW_COMPONENT_DECL(uint32_t, u0, ecs, e0);
+        ECS_RETURN_COMPONENT(ecs, u0);
+
+        visited = 0;
+        ECS_EACH_CHANGED_SINCE(query, ecs, after_borrow, float, uint32_t)
+        {
+            TEST_ASSERT(query.entity == e0);
+            visited++;
+        }
+
+        TEST_ASSERT(visited == 1);
 
         ecs_delete(ecs);
 
     TEST_END();
-    TEST_BEGIN("ECS find all entities with component works");
+    TEST_BEGIN("ECS entity queries skip runs of destroyed entities");
 
         ECS *ecs = ecs_new();
+        Entity entities[200];
+        ecs_create_entities(ecs, 200, entities);
+        ecs_destroy_entities(ecs, 130, entities + 1);
+        ecs_destroy_entity(ecs, entities[199]);
 
-        Entity e0 = ecs_create_entity(ecs);
-        Entity e1 = ecs_create_entity(ecs);
-        Entity e2 = ecs_create_entity(ecs);
+        int visited = 0;
+        ECS_EACH_ENTITY(query, ecs)
+        {
+            TEST_ASSERT(query.entity == entities[visited ? visited + 130 : 0]);
+            visited++;
+        }
+
+        TEST_ASSERT(visited == 69);
+
+        ecs_delete(ecs);
 
+    TEST_END();
+    TEST_BEGIN("ECS tags filter queries without storing any data");
+
+        ECS *ecs = ecs_new();
         ECS_REGISTER_COMPONENT(float, ecs, NULL);
-        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+        ECS_REGISTER_TAG(uint32_t, ecs);
+        ECS_REGISTER_TAG(int16_t, ecs);
 
-        ECS_ADD_COMPONENT_ZEROED_DECL(float, _0, ecs, e0);
-        ECS_ADD_COMPONENT_ZEROED_DECL(float, _1, ecs, e2);
-        ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, _2, ecs, e0);
-        ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, _3, ecs, e1);
-        ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, _4, ecs, e2);
+        Entity entities[300];
+        ecs_create_entities(ecs, 300, entities);
 
-        ECS_VIEW_COMPONENT_DECL(float, floaty0, ecs, e0);
-        ECS_VIEW_COMPONENT_DECL(float, floaty2, ecs, e2);
+        float value = 1.f;
+        ECS_ADD_COMPONENTS(float, ecs, 100, entities, &value);
 
-        size_t result_count;
-        Entity *entities = ECS_FIND_ALL_ENTITIES_WITH_COMPONENT_ALLOC(float, ecs, &result_count);
+        for (int i = 0; i < 300; i += 2) ECS_ADD_TAG(uint32_t, ecs, entities[i]);
+        for (int i = 0; i < 300; i += 3) ECS_ADD_TAG(int16_t, ecs, entities[i]);
 
-        TEST_ASSERT(result_count == 2);
+        TEST_ASSERT( ECS_HAS_TAG(uint32_t, ecs, entities[4]));
+        TEST_ASSERT(!ECS_HAS_TAG(uint32_t, ecs, entities[5]));
+        TEST_ASSERT(ecs_view_component(ecs, entities[4], uint32_t_id) == NULL);
 
-        ECS_VIEW_COMPONENT_DECL(float, get0, ecs, entities[0]);
-        ECS_VIEW_COMPONENT_DECL(float, get1, ecs, entities[1]);
+        int visited = 0;
+        ECS_EACH(query, ecs, uint32_t, int16_t)
+        {
+            TEST_ASSERT(query.entity == entities[visited * 6]);
+            TEST_ASSERT(query.components[0] == NULL && query.components[1] == NULL);
+            visited++;
+        }
+        TEST_ASSERT(visited == 50);
 
-        TEST_ASSERT(entities[0] == e0 && get0 == floaty0);
-        TEST_ASSERT(entities[1] == e2 && get1 == floaty2);
+        visited = 0;
+        ECS_EACH(query, ecs, int16_t, float)
+        {
+            TEST_ASSERT(*(float*)query.components[1] == 1.f);
+            visited++;
+        }
+        TEST_ASSERT(visited == 34);
 
-        free(entities);
+        ECS_REMOVE_TAG(int16_t, ecs, entities[6]);
+        ecs_destroy_entity(ecs, entities[12]);
+
+        size_t tagged_count;
+        Entity *tagged = ECS_FIND_ALL_ENTITIES_WITH_COMPONENT_ALLOC(int16_t, ecs, &tagged_count);
+        TEST_ASSERT(tagged_count == 98 && tagged[0] == entities[0] && tagged[1] == entities[3]);
+        free(tagged);
+
+        visited = 0;
+        ECS_EACH(query, ecs, uint32_t, int16_t) visited++;
+        TEST_ASSERT(visited == 48);
 
         ecs_delete(ecs);
 
     TEST_END();
-    TEST_BEGIN("ECS find first entity with component works");
+    TEST_BEGIN("ECS dense joins intersect occupancy bitsets");
 
         ECS *ecs = ecs_new();
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+        ECS_REGISTER_TAG(int16_t, ecs);
 
-        Entity e0 = ecs_create_entity(ecs);
-        Entity e1 = ecs_create_entity(ecs);
-        Entity entity;
-        bool did_find;
+        Entity entities[1000];
+        ecs_create_entities(ecs, 1000, entities);
+
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            float f = (float)i;
+            if (i % 2 == 0) ECS_ADD_COMPONENTS(float, ecs, 1, &entities[i], &f);
+            if (i % 5 == 0) ECS_ADD_COMPONENTS(uint32_t, ecs, 1, &entities[i], &i);
+            if (i % 3 == 0) ECS_ADD_TAG(int16_t, ecs, entities[i]);
+        }
+
+        ECSTick before_borrow = ecs_get_change_tick();
+        ECS_BORROW_COMPONENT_DECL(uint32_t, changed, ecs, entities[990]);
+        ECS_RETURN_COMPONENT(ecs, changed);
+
+        int visited = 0;
+        ECS_EACH(query, ecs, float, uint32_t)
+        {
+            TEST_ASSERT(query.by_bits_);
+            TEST_ASSERT(query.entity == entities[visited * 10]);
+            TEST_ASSERT(*(float*)query.components[0] == (float)(visited * 10));
+            TEST_ASSERT(*(uint32_t*)query.components[1] == visited * 10);
+            visited++;
+        }
+        TEST_ASSERT(visited == 100);
+
+        visited = 0;
+        ECS_EACH(query, ecs, uint32_t, int16_t, float) visited++;
+        TEST_ASSERT(visited == 34);
 
+        visited = 0;
+        ECS_EACH_CHANGED_SINCE(query, ecs, before_borrow, float, uint32_t)
+        {
+            TEST_ASSERT(query.entity == entities[990]);
+            visited++;
+        }
+        TEST_ASSERT(visited == 1);
+
+        ecs_delete(ecs);
+
+    TEST_END();
+    TEST_BEGIN("ECS components keep their address while the world grows and changes");
+
+        ECS *ecs = ecs_new();
         ECS_REGISTER_COMPONENT(float, ecs, NULL);
         ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+        ECS_REGISTER_GROUP(ecs, float, uint32_t);
 
-        ECS_ADD_COMPONENT_ZEROED_DECL(float, _0, ecs, e0);
-        ECS_ADD_COMPONENT_ZEROED_DECL(float, _1, ecs, e1);
-        ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, _2, ecs, e1);
+        Entity first = ecs_create_entity(ecs);
+        ECS_ADD_COMPONENT_ZEROED_DECL(float, held, ecs, first);
+        *held = 42.f;
+        ECS_RETURN_COMPONENT(ecs, held);
 
-        did_find = ECS_FIND_FIRST_ENTITY_WITH_COMPONENT(uint32_t, ecs, &entity);
-        TEST_ASSERT(did_find);
-        TEST_ASSERT(entity == e1);
+        Entity entities[2000];
+        ecs_create_entities(ecs, 2000, entities);
 
-        did_find = ECS_FIND_FIRST_ENTITY_WITH_COMPONENT(int16_t, ecs, &entity);
-        TEST_ASSERT(!did_find);
+        float value = 1.f;
+        uint32_t zero = 0;
+        ECS_ADD_COMPONENTS(float, ecs, 2000, entities, &value);
+        ECS_ADD_COMPONENTS(uint32_t, ecs, 1000, entities + 1000, &zero);
+        ECS_ADD_COMPONENTS(uint32_t, ecs, 1, &first, &zero);
+        ecs_destroy_entities(ecs, 500, entities);
+        ecs_compact(ecs);
+
+        TEST_ASSERT(ecs_view_component(ecs, first, float_id) == held && *held == 42.f);
 
         ecs_delete(ecs);
 
     TEST_END();
-    TEST_BEGIN("ECS remove component works");
+    TEST_BEGIN("ECS singleton components are found without knowing their entity");
 
         ECS *ecs = ecs_new();
-        Entity e0 = ecs_create_entity(ecs);
-        Entity e1 = ecs_create_entity(ecs);
-        Entity e2 = ecs_create_entity(ecs);
+        ECS_REGISTER_SINGLETON_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+
+        Entity others[8];
+        ecs_create_entities(ecs, 8, others);
+        uint32_t zero = 0;
+        ECS_ADD_COMPONENTS(uint32_t, ecs, 8, others, &zero);
+
+        ECS_VIEW_SINGLETON_DECL(float, ecs, missing);
+        TEST_ASSERT(missing == NULL);
+
+        ECS_ENSURE_AND_BORROW_SINGLETON_DECL(float, ecs, created);
+        TEST_ASSERT(*created == float_default);
+        *created = 5.f;
+        ECS_RETURN_COMPONENT(ecs, created);
+
+        ECS_BORROW_SINGLETON_AND_ENTITY_DECL(float, ecs, borrowed, owner);
+        TEST_ASSERT(*borrowed == 5.f);
+        TEST_ASSERT(ecs_view_component(ecs, owner, float_id) == borrowed);
+        ECS_RETURN_COMPONENT(ecs, borrowed);
+
+        Entity first;
+        TEST_ASSERT(ECS_FIND_FIRST_ENTITY_WITH_COMPONENT(float, ecs, &first) && first == owner);
+
+        ecs_destroy_entity(ecs, owner);
+        ECS_VIEW_SINGLETON_DECL(float, ecs, destroyed);
+        TEST_ASSERT(destroyed == NULL);
+
+        float value = 7.f;
+        ECS_ADD_COMPONENTS(float, ecs, 1, &others[3], &value);
+        ECS_VIEW_SINGLETON_DECL(float, ecs, moved);
+        TEST_ASSERT(*moved == 7.f);
+
+        value = 8.f;
+        ECS_ADD_COMPONENTS(float, ecs, 1, &others[3], &value);
+        ECS_VIEW_SINGLETON_DECL(float, ecs, replaced);
+        TEST_ASSERT(replaced == moved && *replaced == 8.f);
+
+        ecs_delete(ecs);
 
+    TEST_END();
+    TEST_BEGIN("ECS registered queries follow structural changes and raise add/remove events");
+
+        ECS *ecs = ecs_new();
         ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+        ECS_REGISTER_TAG(int16_t, ecs);
+        ECS_REGISTER_EVENT_LISTENER(float, ecs, ECS_EVENT_COMPONENT_ADDED, test_added_event_listener);
+        ECS_REGISTER_EVENT_LISTENER(int16_t, ecs, ECS_EVENT_COMPONENT_ADDED, test_added_event_listener);
+        ECS_REGISTER_EVENT_LISTENER(float, ecs, ECS_EVENT_COMPONENT_REMOVED, test_removed_event_listener);
+
+        Entity entities[100];
+        ecs_create_entities(ecs, 100, entities);
+
+        float value = 1.f;
+        uint32_t zero = 0;
+        test_added_event_count = 0;
+        test_removed_event_count = 0;
+
+        ECS_ADD_COMPONENTS(float, ecs, 50, entities, &value);
+        ECS_ADD_COMPONENTS(uint32_t, ecs, 50, entities + 25, &zero);
+        TEST_ASSERT(test_added_event_count == 50);
+
+        ECS_REGISTER_QUERY(ecs, float, uint32_t);
+        ECS_REGISTER_QUERY(ecs, uint32_t, int16_t);
+
+        ECS_REMOVE_COMPONENT(float, ecs, entities[30]);
+        ecs_destroy_entity(ecs, entities[31]);
+        ECS_ADD_COMPONENTS(float, ecs, 1, &entities[70], &value);
+        ECS_ADD_COMPONENTS(float, ecs, 1, &entities[70], &value);
+        for (int i = 0; i < 100; i += 10) ECS_ADD_TAG(int16_t, ecs, entities[i]);
+
+        TEST_ASSERT(test_added_event_count == 61);
+        TEST_ASSERT(test_removed_event_count == 2);
+
+        int visited = 0;
+        bool saw_removed = false, saw_added = false;
+        ECS_EACH(query, ecs, uint32_t, float)
+        {
+            TEST_ASSERT(query.components[0] == ecs_view_component(ecs, query.entity, uint32_t_id));
+            TEST_ASSERT(*(float*)query.components[1] == 1.f);
+            saw_removed |= query.entity == entities[30] || query.entity == entities[31];
+            saw_added |= query.entity == entities[70];
+            visited++;
+        }
+        TEST_ASSERT(visited == 24 && !saw_removed && saw_added);
 
-        ECS_ADD_COMPONENT_ZEROED_DECL(float, floaty_set, ecs, e0);
-        ECS_VIEW_COMPONENT_DECL(float, floaty_get, ecs, e0);
-        TEST_ASSERT(floaty_get == floaty_set);
+        visited = 0;
+        ECS_EACH(query, ecs, int16_t, uint32_t) visited++;
+        TEST_ASSERT(visited == 5);
 
-        ECS_REMOVE_COMPONENT(float, ecs, e0);
-        ECS_VIEW_COMPONENT_DECL(float, floaty_get_again, ecs, e0);
-        TEST_ASSERT(!floaty_get_again);
+        visited = 0;
+        ECS_EACH(query, ecs, float, float) visited++;
+        TEST_ASSERT(visited == 49);
+
+        ECSTick tick = ecs_get_change_tick();
+        ECS_BORROW_COMPONENT_DECL(float, changed, ecs, entities[40]);
+        ECS_RETURN_COMPONENT(ecs, changed);
+
+        visited = 0;
+        ECS_EACH_CHANGED_SINCE(query, ecs, tick, float, uint32_t)
+        {
+            TEST_ASSERT(query.entity == entities[40]);
+            visited++;
+        }
+        TEST_ASSERT(visited == 1);
 
+        ECS *clone = ecs_clone(ecs, NULL);
+        ECS_REMOVE_COMPONENT(uint32_t, ecs, entities[40]);
+
+        visited = 0;
+        ECS_EACH(query, clone, float, uint32_t) visited++;
+        TEST_ASSERT(visited == 24);
+
+        ecs_compact(ecs);
+        visited = 0;
+        ECS_EACH(query, ecs, float, uint32_t) visited++;
+        TEST_ASSERT(visited == 23);
+
+        ecs_delete(clone);
         ecs_delete(ecs);
 
     TEST_END();
@@ -802,6 +3509,226 @@ TestResult ecs_test()
 
         ecs_delete(ecs);
 
+    TEST_END();
+    TEST_BEGIN("ECS side tables are added and removed along with their component");
+
+        ECS *ecs = ecs_new();
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+
+        uint32_t side_default = 7;
+        ecs_register_side_table(ecs, float_id, uint32_t_id, &side_default);
+
+        Entity entities[4];
+        ecs_create_entities(ecs, 4, entities);
+
+        ECS_ADD_COMPONENT_DEFAULT(float, ecs, entities[0]);
+        ECS_ADD_COMPONENTS(float, ecs, 3, entities + 1, &float_default);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            ECS_VIEW_COMPONENT_DECL(uint32_t, side, ecs, entities[i]);
+            TEST_ASSERT(side && *side == 7);
+        }
+
+        ECS_REMOVE_COMPONENT(float, ecs, entities[1]);
+        TEST_ASSERT(ecs_view_component(ecs, entities[1], uint32_t_id) == NULL);
+
+        ECS_BORROW_COMPONENT_DECL(uint32_t, side, ecs, entities[2]);
+        *side = 3;
+        ECS_RETURN_COMPONENT(ecs, side);
+        ECS_ADD_COMPONENT_DEFAULT(float, ecs, entities[2]);
+        TEST_ASSERT(*(const uint32_t*)ecs_view_component(ecs, entities[2], uint32_t_id) == 3);
+
+        ecs_delete(ecs);
+
+    TEST_END();
+    TEST_BEGIN("ECS structure-of-arrays components are stored as one stream per field");
+
+        ECS *ecs = ecs_new();
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ecs_register_soa_component(ecs, TestSoa_id, "TestSoa", sizeof(TestSoa), 3, test_soa_fields);
+
+        Entity entities[300];
+        ecs_create_entities(ecs, 300, entities);
+
+        TestSoa prototype = { 1.f, 2, 3.0 };
+        ECS_ADD_COMPONENTS(TestSoa, ecs, 299, entities, &prototype);
+        ECS_ADD_COMPONENTS(float, ecs, 300, entities, &float_default);
+
+        TEST_ASSERT(ecs_has_component(ecs, entities[298], TestSoa_id));
+        TEST_ASSERT(!ecs_has_component(ecs, entities[299], TestSoa_id));
+        TEST_ASSERT(ecs_view_soa_component(ecs, entities[299], TestSoa_id).page == NULL);
+
+        ECS_VIEW_SOA_COMPONENT_DECL(TestSoa, first, ecs, entities[0]);
+        ECS_VIEW_SOA_COMPONENT_DECL(TestSoa, second, ecs, entities[1]);
+        TEST_ASSERT(first.page == second.page && &TestSoa_x(second) == &TestSoa_x(first) + 1);
+        TEST_ASSERT(TestSoa_x(second) == 1.f && TestSoa_y(second) == 3.0);
+
+        ECSTick before = ecs_get_change_tick();
+        ECS_BORROW_SOA_COMPONENT_DECL(TestSoa, borrowed, ecs, entities[280]);
+        TestSoa_y(borrowed) = 10.0;
+        ECS_RETURN_SOA_COMPONENT(ecs, borrowed);
+        TEST_ASSERT(ecs_get_component_change_tick(ecs, entities[280], TestSoa_id) > before);
+
+        int count = 0;
+        double y_sum = 0.0;
+        ECS_EACH(query, ecs, float, TestSoa)
+        {
+            ECSSoaRef ref = ECS_QUERY_SOA_REF(query, 1);
+            TestSoa_x(ref) += *(float*)query.components[0];
+            y_sum += TestSoa_y(ref);
+            count++;
+        }
+        TEST_ASSERT(count == 299 && y_sum == 298 * 3.0 + 10.0);
+
+        TestSoa gathered;
+        ecs_read_soa_component(ecs, TestSoa_id, ecs_view_soa_component(ecs, entities[280], TestSoa_id), &gathered);
+        TEST_ASSERT(gathered.x == 3.f && gathered.flag == 2 && gathered.y == 10.0);
+
+        gathered.flag = 9;
+        ecs_write_soa_component(ecs, TestSoa_id, ecs_view_soa_component(ecs, entities[5], TestSoa_id), &gathered);
+        ecs_read_soa_component(ecs, TestSoa_id, ecs_view_soa_component(ecs, entities[5], TestSoa_id), &prototype);
+        TEST_ASSERT(prototype.flag == 9 && prototype.y == 10.0);
+
+        ECS_REMOVE_COMPONENT(TestSoa, ecs, entities[5]);
+        TEST_ASSERT(!ecs_has_component(ecs, entities[5], TestSoa_id));
+
+        ecs_delete(ecs);
+
+    TEST_END();
+    TEST_BEGIN("ECS deferred change events are coalesced and delivered in one batch");
+
+        ECS *ecs = ecs_new();
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_EVENT_LISTENER(float, ecs, ECS_EVENT_COMPONENT_CHANGED, test_change_event_listener);
+        ECS_REGISTER_BATCH_EVENT_LISTENER(float, ecs, ECS_EVENT_COMPONENT_CHANGED, test_batch_event_listener);
+        ecs_set_deferred_change_events(ecs, true);
+
+        Entity entities[10];
+        ecs_create_entities(ecs, 10, entities);
+
+        float value = 1.f;
+        ECS_ADD_COMPONENTS(float, ecs, 10, entities, &value);
+
+        for (int pass = 0; pass < 3; ++pass)
+        {
+            for (int i = 0; i < 10; i += 2)
+            {
+                ECS_BORROW_COMPONENT_DECL(float, f, ecs, entities[i]);
+                ECS_RETURN_COMPONENT(ecs, f);
+            }
+        }
+
+        ecs_destroy_entity(ecs, entities[4]);
+        ECS_REMOVE_COMPONENT(float, ecs, entities[6]);
+
+        test_change_event_listener_sum = 0.f;
+        test_batch_event_calls = 0;
+        test_batch_event_total = 0;
+        ecs_flush_change_events(ecs);
+
+        TEST_ASSERT(test_batch_event_calls == 1 && test_batch_event_total == 8);
+        TEST_ASSERT(test_change_event_listener_sum == 8.f);
+
+        ecs_flush_change_events(ecs);
+        TEST_ASSERT(test_batch_event_calls == 1);
+
+        ECS_BORROW_COMPONENT_DECL(float, f, ecs, entities[0]);
+        ECS_RETURN_COMPONENT(ecs, f);
+        ECS_REMOVE_BATCH_EVENT_LISTENER(float, ecs, ECS_EVENT_COMPONENT_CHANGED, test_batch_event_listener);
+        ecs_set_deferred_change_events(ecs, false);
+        TEST_ASSERT(test_change_event_listener_sum == 9.f && test_batch_event_calls == 1);
+
+        ECS_BORROW_COMPONENT_DECL(float, g, ecs, entities[1]);
+        ECS_RETURN_COMPONENT(ecs, g);
+        TEST_ASSERT(test_change_event_listener_sum == 10.f);
+
+        ecs_delete(ecs);
+
+    TEST_END();
+    TEST_BEGIN("ECS tracks many simultaneous borrows");
+
+        ECS *ecs = ecs_new();
+        Entity entities[100];
+
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+
+        for (int i = 0; i < 100; ++i)
+        {
+            entities[i] = ecs_create_entity(ecs);
+            ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, u, ecs, entities[i]);
+            *u = i;
+            ECS_RETURN_COMPONENT(ecs, u);
+        }
+
+        uint32_t *borrowed[100];
+
+        for (int i = 0; i < 100; ++i)
+            borrowed[i] = ecs_borrow_component(ecs, entities[i], uint32_t_id, __FILE__, __LINE__);
+
+        for (int i = 0; i < 100; i += 2)
+            ECS_RETURN_COMPONENT(ecs, borrowed[i]);
+
+    #ifndef ECS_NO_BORROW_CHECKS
+        TEST_ASSERT(ecs->borrowed_components.count == 50);
+        for (int i = 0; i < 100; ++i)
+            TEST_ASSERT(!borrowset_find(&ecs->borrowed_components, borrowed[i]) == (i % 2 == 0));
+    #endif
+
+        for (int i = 1; i < 100; i += 2)
+        {
+            TEST_ASSERT(*borrowed[i] == (uint32_t)i);
+            ECS_RETURN_COMPONENT(ecs, borrowed[i]);
+        }
+
+    #ifndef ECS_NO_BORROW_CHECKS
+        TEST_ASSERT(ecs->borrowed_components.count == 0);
+    #endif
+
+        ecs_delete(ecs);
+
+    TEST_END();
+    TEST_BEGIN("ECS returns of listened components raise one change event each");
+
+        ECS *ecs = ecs_new();
+        Entity entities[100];
+
+        ECS_REGISTER_COMPONENT(float, ecs, NULL);
+        ECS_REGISTER_COMPONENT(uint32_t, ecs, NULL);
+        ECS_REGISTER_EVENT_LISTENER(float, ecs, ECS_EVENT_COMPONENT_CHANGED, test_change_event_listener);
+
+        for (int i = 0; i < 100; ++i)
+        {
+            entities[i] = ecs_create_entity(ecs);
+            ECS_ADD_COMPONENT_ZEROED_DECL(float, f, ecs, entities[i]);
+            ECS_ADD_COMPONENT_ZEROED_DECL(uint32_t, u, ecs, entities[i]);
+            ECS_RETURN_COMPONENT(ecs, u);
+            ECS_RETURN_COMPONENT(ecs, f);
+        }
+
+        test_change_event_listener_sum = 0.f;
+        float *borrowed[100];
+
+        for (int i = 0; i < 100; ++i)
+        {
+            ECS_BORROW_COMPONENT_DECL(uint32_t, u, ecs, entities[i]);
+            borrowed[i] = ecs_borrow_component(ecs, entities[i], float_id, __FILE__, __LINE__);
+            *borrowed[i] = 1.f;
+            ECS_RETURN_COMPONENT(ecs, u);
+        }
+
+        TEST_ASSERT(ecs->borrowed_components.count == 100);
+
+        for (int i = 0; i < 100; ++i)
+            ECS_RETURN_COMPONENT(ecs, borrowed[i]);
+
+        TEST_ASSERT(test_change_event_listener_sum == 100.f);
+        TEST_ASSERT(ecs->borrowed_components.count == 0);
+
+        ECS_REMOVE_EVENT_LISTENER(float, ecs, ECS_EVENT_COMPONENT_CHANGED, test_change_event_listener);
+        ecs_delete(ecs);
+
     TEST_END();
     // TODO Figure out how to write tests that assert that PANIC is called, and test the BORROW/RETURN component API
     return 0;
@@ -4,105 +4,345 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Added events fire as soon as the component is in place, so a component from ecs_add_component_zeroed is still
+// zeroed; its value follows with the changed event when it is returned. Removed events fire before the
+// component is destructed, including when its entity is destroyed.
 typedef enum ECSComponentEventType
 {
     ECS_EVENT_COMPONENT_CHANGED,
+    ECS_EVENT_COMPONENT_ADDED,
+    ECS_EVENT_COMPONENT_REMOVED,
 }
 ECSComponentEventType;
 
 typedef uint64_t Entity;
+typedef uint32_t ECSComponentID;
+typedef uint64_t ECSTick;
 typedef struct ECS ECS;
+typedef struct ECSCommandBuffer ECSCommandBuffer;
 typedef void (*ECSComponentDestructor)(void*);
 typedef void (*ECSComponentEventListener)(Entity, const void*);
+typedef void (*ECSComponentBatchEventListener)(const Entity *entities, size_t count);
+typedef void (*ECSComponentDeepCopier)(ECSComponentID component_id, void *components, size_t count);
+
+#define ECS_MAX_QUERY_COMPONENTS 4
+#define ECS_PAGE_ITEM_COUNT 256
+#define ECS_MAX_SOA_FIELDS 16
+
+// A field of a structure-of-arrays component, as its offset and size within the component struct.
+typedef struct ECSSoaField
+{
+    size_t offset;
+    size_t size;
+}
+ECSSoaField;
+
+// A structure-of-arrays component is stored as one stream per field in each page of ECS_PAGE_ITEM_COUNT items,
+// so a component is its page plus its lane within the page. Field accessors are generated alongside the
+// component type, e.g. Transform_position(ref).
+typedef struct ECSSoaRef
+{
+    uint8_t *page;
+    uint32_t lane;
+}
+ECSSoaRef;
+
+// Iterator over the live entities that have every component in a set. Queries do not allocate, and the
+// component pointers they yield are not borrowed, so writing through them does not raise change events or
+// bump change ticks. Tags may be queried like components; they only filter, and their pointer is always NULL.
+// Fields ending in an underscore are internal.
+typedef struct ECSQuery
+{
+    Entity entity;
+    void *components[ECS_MAX_QUERY_COMPONENTS]; // in the order the component IDs were passed to ecs_query_begin
+    uint32_t lane; // with the page in components, the ECSSoaRef of a structure-of-arrays component
+
+    ECS *ecs_;
+    bool done_;
+    ECSTick changed_since_;
+    size_t position_;
+    size_t component_count_;
+    size_t driver_;
+    const void *group_;
+    const void *cached_;
+    void *stores_[ECS_MAX_QUERY_COMPONENTS];
+    bool packed_[ECS_MAX_QUERY_COMPONENTS];
+    bool tag_[ECS_MAX_QUERY_COMPONENTS];
+    bool by_bits_;
+    uint64_t block_[4];
+}
+ECSQuery;
 
 extern ECS *ecs_new(void);
 extern void ecs_delete(ECS *ecs);
 
 extern Entity ecs_create_entity(ECS *ecs);
+// Destroying an entity removes and destructs all of its components immediately.
 extern void ecs_destroy_entity(ECS *ecs, Entity entity);
 extern bool ecs_is_entity_valid(const ECS *ecs, Entity entity);
 
-extern void ecs_register_component(ECS *ecs, const char *component_type, size_t component_size, ECSComponentDestructor destructor);
-extern const void *ecs_view_component(const ECS *ecs, Entity entity, const char *component_type);
-extern void *ecs_add_component_zeroed(ECS *ecs, Entity entity, const char *component_type, const char *debug_file, int debug_line);
-extern void ecs_remove_component(ECS *ecs, Entity entity, const char *component_type);
+// Batch variants which grow storage once for the whole batch. ecs_add_components copies the prototype bytewise
+// in to every entity without borrowing, so the prototype must not own heap memory. An entity listed more than once
+// is added, and raises ECS_EVENT_COMPONENT_ADDED, once.
+extern void ecs_create_entities(ECS *ecs, size_t count, Entity *out_entities);
+extern void ecs_destroy_entities(ECS *ecs, size_t count, const Entity *entities);
+extern void ecs_add_components(ECS *ecs, size_t count, const Entity *entities, ECSComponentID component_id, const void *prototype);
+
+// Copies the whole ECS, keeping entity handles, with bulk copies of each component type's arrays and pages.
+// Components are copied bytewise, then deep_copy, if given, is called for each run of neighbouring components
+// to replace any memory the copies still share with the original. Borrows are not copied.
+extern ECS *ecs_clone(const ECS *ecs, ECSComponentDeepCopier deep_copy);
+
+// Stamps every component with a new change tick, e.g. after swapping in a different ECS.
+extern void ecs_mark_all_changed(ECS *ecs);
+
+// Returns memory held for destroyed entities at the end of the entity and component tables. Does nothing if no
+// entities were destroyed since the last call, so it is cheap to call every frame.
+extern void ecs_compact(ECS *ecs);
 
-extern void *ecs_borrow_component(ECS *ecs, Entity entity, const char *component_type, const char *debug_file, int debug_line);
+extern void ecs_register_component(ECS *ecs, ECSComponentID component_id, const char *component_type, size_t component_size, ECSComponentDestructor destructor);
+// A singleton component can be added to at most one entity, and lives in a fixed slot of its storage so it can
+// be found without knowing which entity owns it. Singletons cannot be owned by a group.
+extern void ecs_register_singleton_component(ECS *ecs, ECSComponentID component_id, const char *component_type, size_t component_size, ECSComponentDestructor destructor);
+// Structure-of-arrays components must be plain data. They have no address of their own, so they are accessed
+// through the soa functions below, added with ecs_add_components or a command buffer, and raise events with a
+// NULL component.
+extern void ecs_register_soa_component(ECS *ecs, ECSComponentID component_id, const char *component_type, size_t component_size, size_t field_count, const ECSSoaField *fields);
+// A side table is a second component type holding the rarely used fields of another, so that iterating the
+// component itself touches less memory. Adding the component adds its side table too, copied bytewise from the
+// prototype, and removing the component removes it.
+extern void ecs_register_side_table(ECS *ecs, ECSComponentID component_id, ECSComponentID side_table_id, const void *prototype);
+extern bool ecs_find_component_id(const ECS *ecs, const char *component_type, ECSComponentID *out_id);
+
+// Tags are components without data, stored as one bit per entity, for cheap filters such as "static" or
+// "dirty". They share the component ID space, are removed with ecs_remove_component, and have no change ticks
+// or change events, though adding and removing them raises add and remove events with a NULL component. Adding
+// a tag through the component functions is an error.
+extern void ecs_register_tag(ECS *ecs, ECSComponentID tag_id, const char *tag_type);
+extern void ecs_add_tag(ECS *ecs, Entity entity, ECSComponentID tag_id);
+extern bool ecs_has_tag(const ECS *ecs, Entity entity, ECSComponentID tag_id);
+
+// A component stays at the same address from when it is added until it is removed or its entity is destroyed,
+// whatever else is added, removed or grouped meanwhile.
+extern const void *ecs_view_component(const ECS *ecs, Entity entity, ECSComponentID component_id);
+extern void *ecs_add_component_zeroed(ECS *ecs, Entity entity, ECSComponentID component_id, const char *debug_file, int debug_line);
+extern void ecs_remove_component(ECS *ecs, Entity entity, ECSComponentID component_id);
+extern bool ecs_has_component(const ECS *ecs, Entity entity, ECSComponentID component_id);
+
+// Records structural changes to play back later, e.g. from systems running on scheduler worker threads, which
+// must not create or destroy entities or add or remove components directly. Entities returned by
+// ecs_commands_create_entity are placeholders which only this buffer understands until it is played back.
+// Added component values are copied in to the buffer, and ownership of anything they point to moves to the ECS
+// on playback.
+extern ECSCommandBuffer *ecs_commands_new(void);
+extern Entity ecs_commands_create_entity(ECSCommandBuffer *commands);
+extern void ecs_commands_destroy_entity(ECSCommandBuffer *commands, Entity entity);
+extern void ecs_commands_add_component(ECSCommandBuffer *commands, Entity entity, ECSComponentID component_id, size_t component_size, const void *value);
+extern void ecs_commands_remove_component(ECSCommandBuffer *commands, Entity entity, ECSComponentID component_id);
+extern void ecs_commands_play(ECSCommandBuffer *commands, ECS *ecs);
+extern void ecs_commands_delete(ECSCommandBuffer *commands);
+
+// Components may be viewed, borrowed and returned from several threads at once, as long as no two threads touch
+// the same component type and nothing is creating or destroying entities or adding or removing components.
+// Change listeners run on whichever thread returned the component, or while change events are deferred, on the
+// thread which flushes them.
+// Borrowed components are tracked so double borrows and stray returns can be caught. Defining ECS_NO_BORROW_CHECKS
+// compiles the tracking out; returns still raise change events for component types that have listeners.
+extern void *ecs_borrow_component(ECS *ecs, Entity entity, ECSComponentID component_id, const char *debug_file, int debug_line);
 extern void ecs_return_component(ECS *ecs, void *component, const char *debug_file, int debug_line);
 
-extern bool ecs_find_first_entity_with_component(const ECS *ecs, const char *component_type, Entity *out_entity);
-extern Entity *ecs_find_all_entities_with_component_alloc(const ECS *ecs, const char *component_type, size_t *result_length);
+// A NULL page means the entity does not have the component. Read and write gather and scatter a whole component.
+extern ECSSoaRef ecs_view_soa_component(const ECS *ecs, Entity entity, ECSComponentID component_id);
+extern ECSSoaRef ecs_borrow_soa_component(ECS *ecs, Entity entity, ECSComponentID component_id, const char *debug_file, int debug_line);
+extern void ecs_return_soa_component(ECS *ecs, ECSSoaRef ref, const char *debug_file, int debug_line);
+extern void ecs_read_soa_component(const ECS *ecs, ECSComponentID component_id, ECSSoaRef ref, void *out);
+extern void ecs_write_soa_component(ECS *ecs, ECSComponentID component_id, ECSSoaRef ref, const void *value);
+
+// String keyed variants of the above, for the editor and serialization where only a type name is at hand.
+extern const void *ecs_view_component_by_name(const ECS *ecs, Entity entity, const char *component_type);
+extern void *ecs_add_component_zeroed_by_name(ECS *ecs, Entity entity, const char *component_type, const char *debug_file, int debug_line);
+extern void ecs_remove_component_by_name(ECS *ecs, Entity entity, const char *component_type);
+extern void *ecs_borrow_component_by_name(ECS *ecs, Entity entity, const char *component_type, const char *debug_file, int debug_line);
+
+// A group takes ownership of the storage of 2 to ECS_MAX_QUERY_COMPONENTS component types and keeps the entities
+// that have all of them packed at the front of each type's dense arrays, so queries covering the group skip
+// membership checks and read change ticks by position. Component data stays paged by entity index, so the
+// walk is not contiguous in memory. A component type can belong to at most one group.
+extern void ecs_register_group(ECS *ecs, size_t component_count, const ECSComponentID *component_ids);
+
+// Registers a persistent query over 1 to ECS_MAX_QUERY_COMPONENTS components. The ECS keeps the list of matching
+// entities up to date as components are added and removed, and from then on any query for exactly that set of
+// components, in any order, walks the list instead of searching the component stores. Register queries that
+// run every frame over sets of entities which rarely change.
+extern void ecs_register_query(ECS *ecs, size_t component_count, const ECSComponentID *component_ids);
+
+// Passing no component IDs queries every live entity.
+extern ECSQuery ecs_query_begin(ECS *ecs, size_t component_count, const ECSComponentID *component_ids);
+// Only yields entities where at least one of the queried components changed after the given tick.
+extern ECSQuery ecs_query_begin_changed_since(ECS *ecs, ECSTick tick, size_t component_count, const ECSComponentID *component_ids);
+extern bool ecs_query_next(ECSQuery *query);
+
+// Borrowing or adding a component stamps it with a new change tick. Ticks increase monotonically and are
+// shared between ECS instances, so a tick read while one ECS is in use is still a valid baseline after it is
+// replaced. The current tick can be read from any thread.
+extern ECSTick ecs_get_change_tick(void);
+extern ECSTick ecs_get_component_change_tick(const ECS *ecs, Entity entity, ECSComponentID component_id);
+
+// O(1) access to a singleton component and, if out_entity is not NULL, the entity which owns it. Returns NULL
+// when no entity has the component. For other components these return whichever instance is stored first.
+extern const void *ecs_view_singleton(const ECS *ecs, ECSComponentID component_id, Entity *out_entity);
+extern void *ecs_borrow_singleton(ECS *ecs, ECSComponentID component_id, Entity *out_entity, const char *debug_file, int debug_line);
+
+extern bool ecs_find_first_entity_with_component(const ECS *ecs, ECSComponentID component_id, Entity *out_entity);
+extern Entity *ecs_find_all_entities_with_component_alloc(const ECS *ecs, ECSComponentID component_id, size_t *result_length);
 extern Entity *ecs_find_all_entities_alloc(const ECS *ecs, size_t *result_length);
 
-extern void ecs_register_event_listener(ECS *ecs, ECSComponentEventType event_type, const char *component_type, ECSComponentEventListener listener);
-extern void ecs_remove_event_listener(ECS *ecs, ECSComponentEventType event_type, const char *component_type, ECSComponentEventListener listener);
+extern void ecs_register_event_listener(ECS *ecs, ECSComponentEventType event_type, ECSComponentID component_id, ECSComponentEventListener listener);
+extern void ecs_remove_event_listener(ECS *ecs, ECSComponentEventType event_type, ECSComponentID component_id, ECSComponentEventListener listener);
+
+// Batch listeners are handed every entity an event applies to in one call. Outside of a flush of deferred
+// change events that is always a single entity.
+extern void ecs_register_batch_event_listener(ECS *ecs, ECSComponentEventType event_type, ECSComponentID component_id, ECSComponentBatchEventListener listener);
+extern void ecs_remove_batch_event_listener(ECS *ecs, ECSComponentEventType event_type, ECSComponentID component_id, ECSComponentBatchEventListener listener);
+
+// While change events are deferred, returning a component only queues its entity, once per component type
+// however often it is borrowed, and ecs_flush_change_events delivers each type's queue in one batch. Entities
+// which lost the component before the flush are left out. Add and remove events are never deferred. Turning
+// deferral off flushes anything still queued.
+extern void ecs_set_deferred_change_events(ECS *ecs, bool deferred);
+extern void ecs_flush_change_events(ECS *ecs);
+
+// Every component type T used with the macros below needs a matching compile time constant T##_id,
+// which generate_component_defs.js emits for all generated components.
 
 #define ECS_REGISTER_COMPONENT(T, ecs_ptr, destructor) \
-    ecs_register_component((ecs_ptr), #T, sizeof(T), destructor)
+    ecs_register_component((ecs_ptr), T##_id, #T, sizeof(T), destructor)
+
+#define ECS_REGISTER_SINGLETON_COMPONENT(T, ecs_ptr, destructor) \
+    ecs_register_singleton_component((ecs_ptr), T##_id, #T, sizeof(T), destructor)
 
 #define ECS_BORROW_COMPONENT_DECL(T, var_name, ecs_ptr, entity) \
-    T *var_name = ecs_borrow_component((ecs_ptr), (entity), #T, __FILE__, __LINE__)
+    T *var_name = ecs_borrow_component((ecs_ptr), (entity), T##_id, __FILE__, __LINE__)
 
 #define ECS_VIEW_COMPONENT_DECL(T, var_name, ecs_ptr, entity) \
-    const T *var_name = ecs_view_component((ecs_ptr), (entity), #T)
+    const T *var_name = ecs_view_component((ecs_ptr), (entity), T##_id)
 
 #define ECS_RETURN_COMPONENT(ecs_ptr, component) \
     ecs_return_component((ecs_ptr), (component), __FILE__, __LINE__)
 
+#define ECS_VIEW_SOA_COMPONENT_DECL(T, var_name, ecs_ptr, entity) \
+    ECSSoaRef var_name = ecs_view_soa_component((ecs_ptr), (entity), T##_id)
+
+#define ECS_BORROW_SOA_COMPONENT_DECL(T, var_name, ecs_ptr, entity) \
+    ECSSoaRef var_name = ecs_borrow_soa_component((ecs_ptr), (entity), T##_id, __FILE__, __LINE__)
+
+#define ECS_RETURN_SOA_COMPONENT(ecs_ptr, ref) \
+    ecs_return_soa_component((ecs_ptr), (ref), __FILE__, __LINE__)
+
+#define ECS_QUERY_SOA_REF(query, i) \
+    ((ECSSoaRef){ (uint8_t*)(query).components[i], (query).lane })
+
 #define ECS_ADD_COMPONENT_ZEROED_DECL(T, var_name, ecs_ptr, entity) \
-    T *var_name = ecs_add_component_zeroed((ecs_ptr), (entity), #T, __FILE__, __LINE__)
+    T *var_name = ecs_add_component_zeroed((ecs_ptr), (entity), T##_id, __FILE__, __LINE__)
 
 #define ECS_ADD_COMPONENT_DEFAULT(T, ecs_ptr, entity) do { \
-    T *comp_ = ecs_add_component_zeroed((ecs_ptr), (entity), #T, __FILE__, __LINE__); \
+    T *comp_ = ecs_add_component_zeroed((ecs_ptr), (entity), T##_id, __FILE__, __LINE__); \
     *comp_ = T##_default; \
     ecs_return_component((ecs_ptr), comp_, __FILE__, __LINE__); \
 } while (0)
 
+#define ECS_ADD_COMPONENTS(T, ecs_ptr, count, entities, prototype_ptr) \
+    ecs_add_components((ecs_ptr), (count), (entities), T##_id, (const T*)(prototype_ptr))
+
 #define ECS_REMOVE_COMPONENT(T, ecs_ptr, entity) \
-    ecs_remove_component((ecs_ptr), (entity), #T)
+    ecs_remove_component((ecs_ptr), (entity), T##_id)
+
+#define ECS_REGISTER_TAG(T, ecs_ptr) \
+    ecs_register_tag((ecs_ptr), T##_id, #T)
+
+#define ECS_ADD_TAG(T, ecs_ptr, entity) \
+    ecs_add_tag((ecs_ptr), (entity), T##_id)
+
+#define ECS_HAS_TAG(T, ecs_ptr, entity) \
+    ecs_has_tag((ecs_ptr), (entity), T##_id)
+
+#define ECS_REMOVE_TAG(T, ecs_ptr, entity) \
+    ecs_remove_component((ecs_ptr), (entity), T##_id)
+
+#define ECS_COMMANDS_ADD_TAG(T, commands, entity) \
+    ecs_commands_add_component((commands), (entity), T##_id, 0, NULL)
+
+#define ECS_COMMANDS_ADD_COMPONENT(T, commands, entity, value_ptr) \
+    ecs_commands_add_component((commands), (entity), T##_id, sizeof(T), (value_ptr))
+
+#define ECS_COMMANDS_ADD_COMPONENT_DEFAULT(T, commands, entity) \
+    ecs_commands_add_component((commands), (entity), T##_id, sizeof(T), &T##_default)
+
+#define ECS_COMMANDS_REMOVE_COMPONENT(T, commands, entity) \
+    ecs_commands_remove_component((commands), (entity), T##_id)
 
 #define ECS_FIND_FIRST_ENTITY_WITH_COMPONENT(T, ecs_ptr, out_entity_ptr) \
-    ecs_find_first_entity_with_component((ecs_ptr), #T, out_entity_ptr)
+    ecs_find_first_entity_with_component((ecs_ptr), T##_id, out_entity_ptr)
 
 #define ECS_FIND_ALL_ENTITIES_WITH_COMPONENT_ALLOC(T, ecs_ptr, result_length) \
-    ecs_find_all_entities_with_component_alloc((ecs_ptr), #T, (result_length))
+    ecs_find_all_entities_with_component_alloc((ecs_ptr), T##_id, (result_length))
 
 #define ECS_REGISTER_EVENT_LISTENER(T, ecs_ptr, event_type, listener) \
-    ecs_register_event_listener((ecs_ptr), (event_type), #T, (listener))
+    ecs_register_event_listener((ecs_ptr), (event_type), T##_id, (listener))
 
 #define ECS_REMOVE_EVENT_LISTENER(T, ecs_ptr, event_type, listener) \
-    ecs_remove_event_listener((ecs_ptr), (event_type), #T, (listener))
+    ecs_remove_event_listener((ecs_ptr), (event_type), T##_id, (listener))
+
+#define ECS_REGISTER_BATCH_EVENT_LISTENER(T, ecs_ptr, event_type, listener) \
+    ecs_register_batch_event_listener((ecs_ptr), (event_type), T##_id, (listener))
+
+#define ECS_REMOVE_BATCH_EVENT_LISTENER(T, ecs_ptr, event_type, listener) \
+    ecs_remove_batch_event_listener((ecs_ptr), (event_type), T##_id, (listener))
+
+#define ECS_EXPAND_(x) x
+#define ECS_COUNT_ARGS_(_1, _2, _3, _4, n, ...) n
+#define ECS_COUNT_ARGS(...) ECS_EXPAND_(ECS_COUNT_ARGS_(__VA_ARGS__, 4, 3, 2, 1, 0))
+#define ECS_IDS_1_(a) a##_id
+#define ECS_IDS_2_(a, b) a##_id, b##_id
+#define ECS_IDS_3_(a, b, c) a##_id, b##_id, c##_id
+#define ECS_IDS_4_(a, b, c, d) a##_id, b##_id, c##_id, d##_id
+#define ECS_IDS_N_(n) ECS_IDS_##n##_
+#define ECS_IDS_SELECT_(n) ECS_IDS_N_(n)
+#define ECS_COMPONENT_IDS(...) ECS_EXPAND_(ECS_IDS_SELECT_(ECS_COUNT_ARGS(__VA_ARGS__))(__VA_ARGS__))
+
+#define ECS_REGISTER_GROUP(ecs_ptr, ...) \
+    ecs_register_group((ecs_ptr), ECS_COUNT_ARGS(__VA_ARGS__), (const ECSComponentID[]){ ECS_COMPONENT_IDS(__VA_ARGS__) })
+
+#define ECS_REGISTER_QUERY(ecs_ptr, ...) \
+    ecs_register_query((ecs_ptr), ECS_COUNT_ARGS(__VA_ARGS__), (const ECSComponentID[]){ ECS_COMPONENT_IDS(__VA_ARGS__) })
+
+#define ECS_EACH(query_var, ecs_ptr, ...) \
+    for (ECSQuery query_var = ecs_query_begin((ecs_ptr), ECS_COUNT_ARGS(__VA_ARGS__), (const ECSComponentID[]){ ECS_COMPONENT_IDS(__VA_ARGS__) }); \
+         ecs_query_next(&query_var); )
+
+#define ECS_EACH_CHANGED_SINCE(query_var, ecs_ptr, tick, ...) \
+    for (ECSQuery query_var = ecs_query_begin_changed_since((ecs_ptr), (tick), ECS_COUNT_ARGS(__VA_ARGS__), (const ECSComponentID[]){ ECS_COMPONENT_IDS(__VA_ARGS__) }); \
+         ecs_query_next(&query_var); )
+
+#define ECS_EACH_ENTITY(query_var, ecs_ptr) \
+    for (ECSQuery query_var = ecs_query_begin((ecs_ptr), 0, NULL); ecs_query_next(&query_var); )
 
 #define ECS_ENSURE_AND_BORROW_SINGLETON_DECL(T, ecs_ptr, var_name) \
-    T *var_name; \
-    { \
-        Entity entity_; \
-        if (!ecs_find_first_entity_with_component((ecs_ptr), #T, &entity_)) { \
-            entity_ = ecs_create_entity(ecs_ptr); \
-            var_name = ecs_add_component_zeroed((ecs_ptr), entity_, #T, __FILE__, __LINE__); \
-            *var_name = T##_default; \
-        } else { \
-            var_name = ecs_borrow_component((ecs_ptr), entity_, #T, __FILE__, __LINE__); \
-        } \
+    T *var_name = ecs_borrow_singleton((ecs_ptr), T##_id, NULL, __FILE__, __LINE__); \
+    if (!var_name) { \
+        var_name = ecs_add_component_zeroed((ecs_ptr), ecs_create_entity(ecs_ptr), T##_id, __FILE__, __LINE__); \
+        *var_name = T##_default; \
     }
 
 #define ECS_BORROW_SINGLETON_DECL(T, ecs_ptr, var_name) \
-    T *var_name = NULL; \
-    { \
-        Entity entity_; \
-        if (ecs_find_first_entity_with_component((ecs_ptr), #T, &entity_)) { \
-            var_name = ecs_borrow_component((ecs_ptr), entity_, #T, __FILE__, __LINE__); \
-        } \
-    }
+    T *var_name = ecs_borrow_singleton((ecs_ptr), T##_id, NULL, __FILE__, __LINE__)
 
 #define ECS_VIEW_SINGLETON_DECL(T, ecs_ptr, var_name) \
-    const T *var_name = NULL; \
-    { \
-        Entity entity_; \
-        if (ecs_find_first_entity_with_component((ecs_ptr), #T, &entity_)) { \
-            var_name = ecs_view_component((ecs_ptr), entity_, #T); \
-        } \
-    }
+    const T *var_name = ecs_view_singleton((ecs_ptr), T##_id, NULL)
+
+#define ECS_BORROW_SINGLETON_AND_ENTITY_DECL(T, ecs_ptr, var_name, entity_var_name) \
+    Entity entity_var_name = 0; \
+    T *var_name = ecs_borrow_singleton((ecs_ptr), T##_id, &entity_var_name, __FILE__, __LINE__)
 
 #ifdef RUN_TESTS
 #include "../testing.h"
@@ -1,5 +1,3 @@
-#define _CRT_SECURE_NO_WARNINGS
-
 #include "hashtable.h"
 
 #include <stdlib.h>
@@ -8,134 +6,216 @@
 
 #include "../utils.h"
 
-#ifdef _MSC_VER
-    #define strdup _strdup
-#endif
+// Grow once more than 7/8 of the slots are taken.
+#define HASHTABLE_MAX_LOAD_NUM 7
+#define HASHTABLE_MAX_LOAD_DEN 8
+#define HASHTABLE_MIN_CAPACITY 8
 
-HashTable hashtable_empty(size_t table_size, size_t item_size)
+HashTable hashtable_empty(size_t initial_capacity, size_t item_size)
 {
-    return (HashTable) { table_size, item_size, NULL };
+    return (HashTable) {
+        .initial_capacity = initial_capacity,
+        .item_size = item_size,
+        .value_pages = vec_empty(sizeof(uint8_t*)),
+        .free_values = vec_empty(sizeof(uint32_t)),
+        .keys = vec_empty(sizeof(char)),
+    };
 }
 
-static uint32_t hash_fn(const char *string, uint32_t max_len)
+static uint8_t *value_at_index(const HashTable *table, uint32_t index)
 {
-    if (!string) return 0;
-    int len = (int)strlen(string);
-    if (len == 0) return 1;
-    Hash hash = utils_hash(string, len);
-    return hash % max_len;
+    uint8_t *page = *(uint8_t**)vec_at_const(&table->value_pages, index / HASHTABLE_PAGE_ITEM_COUNT);
+    return page + (index % HASHTABLE_PAGE_ITEM_COUNT) * table->item_size;
 }
 
-void *hashtable_at(HashTable *table, const char *key)
+static uint8_t *value_at(const HashTable *table, size_t slot)
 {
-    if (!table->table) return NULL;
+    return value_at_index(table, table->slots[slot].value_index);
+}
 
-    uint32_t bin = hash_fn(key, (uint32_t)table->table_size);
+static uint32_t alloc_value(HashTable *table)
+{
+    uint32_t index;
+    if (vec_pop(&table->free_values, &index)) return index;
 
-    for (HashTableEntry *entry = table->table[bin]; entry; entry = entry->next)
-        if (strcmp(key, entry->key) == 0)
-            return entry->value;
+    if (table->value_count % HASHTABLE_PAGE_ITEM_COUNT == 0)
+    {
+        uint8_t *page = malloc(HASHTABLE_PAGE_ITEM_COUNT * table->item_size);
+        vec_push_copy(&table->value_pages, &page);
+    }
 
-    return NULL;
+    return table->value_count++;
 }
 
-const void *hashtable_at_const(const HashTable *table, const char *key)
+static const char *key_at(const HashTable *table, const HashTableSlot *slot)
 {
-    return hashtable_at((HashTable*)table, key);
+    return (const char*)table->keys.data + slot->key_offset;
 }
 
-void *hashtable_set_copy(HashTable *table, const char *key, void *item_ref)
+static size_t find_slot(const HashTable *table, const char *key, uint64_t hash)
 {
-    if (!table->table)
-        table->table = calloc(table->table_size, sizeof(HashTableEntry*));
+    if (!table->capacity) return SIZE_MAX;
 
-    uint32_t bin = hash_fn(key, (uint32_t)table->table_size);
+    size_t mask = table->capacity - 1;
 
-    HashTableEntry *parent = NULL;
-    HashTableEntry *entry = table->table[bin];
+    // Past an entry closer to its home than the probe is, the key would have taken that slot when it was set.
+    for (size_t i = hash & mask, distance = 1;; i = (i + 1) & mask, distance++)
+    {
+        const HashTableSlot *slot = &table->slots[i];
 
-    bool key_match_found = false;
+        if (slot->distance < distance) return SIZE_MAX;
+        if (slot->hash == hash && strcmp(key_at(table, slot), key) == 0) return i;
+    }
+}
+
+// Places an entry known not to be in the table, which must have a free slot. Its value stays where it is.
+static void insert_slot(HashTable *table, HashTableSlot entry)
+{
+    size_t mask = table->capacity - 1;
+    entry.distance = 1;
 
-    while (entry)
+    for (size_t i = entry.hash & mask;; i = (i + 1) & mask, entry.distance++)
     {
-        key_match_found = strcmp(key, entry->key) == 0;
-        if (key_match_found) break;
+        HashTableSlot *slot = &table->slots[i];
 
-        parent = entry;
-        entry = entry->next;
+        if (slot->distance == 0)
+        {
+            *slot = entry;
+            return;
+        }
+
+        if (slot->distance < entry.distance)
+        {
+            HashTableSlot displaced = *slot;
+            *slot = entry;
+            entry = displaced;
+        }
     }
+}
+
+// Moves every entry in to a table of the given capacity, rebuilding the key arena without removed keys.
+static void rehash(HashTable *table, size_t capacity)
+{
+    HashTable old = *table;
+
+    table->capacity = capacity;
+    table->slots = calloc(capacity, sizeof(HashTableSlot));
+    table->keys = vec_empty(sizeof(char));
+    table->dead_key_bytes = 0;
+
+    vec_reserve(&table->keys, old.keys.item_count - old.dead_key_bytes);
 
-    if (! key_match_found)
+    for (size_t i = 0; i < old.capacity; ++i)
     {
-        entry = malloc(sizeof(HashTableEntry) + table->item_size);
-        entry->key = strdup(key);
-        entry->next = NULL;
-
-        if (parent)
-            parent->next = entry;
-        else
-            table->table[bin] = entry;
+        HashTableSlot entry = old.slots[i];
+        if (!entry.distance) continue;
+
+        const char *key = key_at(&old, &entry);
+        entry.key_offset = (uint32_t)table->keys.item_count;
+        vec_push_many(&table->keys, strlen(key) + 1, key);
+
+        insert_slot(table, entry);
     }
 
-    memcpy(entry->value, item_ref, table->item_size);
+    free(old.slots);
+    vec_clear(&old.keys);
+}
 
-    return entry->value;
+void *hashtable_at(HashTable *table, const char *key)
+{
+    size_t slot = find_slot(table, key, utils_hash(key, strlen(key)));
+    return slot == SIZE_MAX ? NULL : value_at(table, slot);
 }
 
-bool hashtable_remove(HashTable *table, const char *key)
+const void *hashtable_at_const(const HashTable *table, const char *key)
 {
-    if (!table->table) return false;
+    return hashtable_at((HashTable*)table, key);
+}
 
-    uint32_t bin = hash_fn(key, (uint32_t)table->table_size);
+void *hashtable_set_copy(HashTable *table, const char *key, void *item_ref)
+{
+    size_t length = strlen(key);
+    uint64_t hash = utils_hash(key, length);
+    size_t slot = find_slot(table, key, hash);
 
-    HashTableEntry *parent = NULL;
-    HashTableEntry *entry = table->table[bin];
+    if (slot != SIZE_MAX)
+    {
+        memcpy(value_at(table, slot), item_ref, table->item_size);
+        return value_at(table, slot);
+    }
 
-    while (entry)
+    if ((table->item_count + 1) * HASHTABLE_MAX_LOAD_DEN > table->capacity * HASHTABLE_MAX_LOAD_NUM)
     {
-        if (strcmp(key, entry->key) == 0)
-        {
-            if (parent)
-                parent->next = entry->next;
-            else
-                table->table[bin] = entry->next;
+        size_t wanted = table->capacity ? table->item_count + 1 : table->initial_capacity;
+        size_t capacity = table->capacity ? table->capacity * 2 : HASHTABLE_MIN_CAPACITY;
 
-            free(entry->key);
-            free(entry);
+        while (wanted * HASHTABLE_MAX_LOAD_DEN > capacity * HASHTABLE_MAX_LOAD_NUM)
+            capacity *= 2;
 
-            return true;
-        }
+        rehash(table, capacity);
+    }
+
+    HashTableSlot entry = { hash, (uint32_t)table->keys.item_count, 0, alloc_value(table) };
+    vec_push_many(&table->keys, length + 1, key);
+    table->item_count++;
+    insert_slot(table, entry);
+
+    uint8_t *value = value_at_index(table, entry.value_index);
+    memcpy(value, item_ref, table->item_size);
+    return value;
+}
+
+bool hashtable_remove(HashTable *table, const char *key)
+{
+    size_t length = strlen(key);
+    size_t slot = find_slot(table, key, utils_hash(key, length));
+    if (slot == SIZE_MAX) return false;
+
+    // Shift the entries after the removed one back a slot, until one is already in its home slot, so that no
+    // probe has to step over a gap.
+    size_t mask = table->capacity - 1;
+    size_t next = (slot + 1) & mask;
+
+    vec_push_copy(&table->free_values, &table->slots[slot].value_index);
+
+    while (table->slots[next].distance > 1)
+    {
+        table->slots[slot] = table->slots[next];
+        table->slots[slot].distance--;
 
-        parent = entry;
-        entry = entry->next;
+        slot = next;
+        next = (next + 1) & mask;
     }
 
-    return false;
+    table->slots[slot].distance = 0;
+    table->item_count--;
+    table->dead_key_bytes += length + 1;
+
+    // Rebuilding the arena costs a pass over every slot, so wait until the garbage outweighs the slots as well
+    // as the live keys.
+    if (table->dead_key_bytes > table->keys.item_count / 2 && table->dead_key_bytes > table->capacity * sizeof(HashTableSlot))
+        rehash(table, table->capacity);
+
+    return true;
 }
 
 static void empty_callback(void *c, void *x) {}
 
 void hashtable_clear_with_callback(HashTable *table, void *context, HashTableCallback cb)
 {
-    if (!table->table) return;
-
-    for (size_t i = 0; i < table->table_size; ++i)
-    {
-        HashTableEntry *entry = table->table[i];
+    for (size_t i = 0; i < table->capacity; ++i)
+        if (table->slots[i].distance)
+            cb(context, value_at(table, i));
 
-        while (entry)
-        {
-            cb(context, entry->value);
+    for (size_t i = 0; i < table->value_pages.item_count; ++i)
+        free(*(uint8_t**)vec_at(&table->value_pages, i));
 
-            HashTableEntry *next = entry->next;
-            free(entry->key);
-            free(entry);
-            entry = next;
-        }
-    }
+    free(table->slots);
+    vec_clear(&table->value_pages);
+    vec_clear(&table->free_values);
+    vec_clear(&table->keys);
 
-    free(table->table);
-    table->table = NULL;
+    *table = hashtable_empty(table->initial_capacity, table->item_size);
 }
 
 void hashtable_clear(HashTable *table)
@@ -204,6 +284,57 @@ TestResult hashtable_test(void)
         TEST_ASSERT(test_clear_callback_calls == 1);
         TEST_ASSERT(test_clear_callback_val == 27);
 
+    TEST_END();
+    TEST_BEGIN("HashTable grows, and keeps every entry in place through removals and arena rebuilds");
+
+        HashTable table = hashtable_empty(4, sizeof(uint32_t));
+        char key[32];
+
+        const uint32_t *kept = hashtable_set_copy(&table, "key 1", &(uint32_t){ 1 });
+
+        for (uint32_t i = 0; i < 5000; ++i)
+        {
+            snprintf(key, sizeof(key), "key %u", i);
+            hashtable_set_copy(&table, key, &i);
+        }
+
+        TEST_ASSERT(table.item_count == 5000);
+        TEST_ASSERT(table.capacity * 7 >= 5000 * 8);
+
+        for (uint32_t i = 0; i < 5000; i += 2)
+        {
+            snprintf(key, sizeof(key), "key %u", i);
+            TEST_ASSERT(hashtable_remove(&table, key));
+        }
+
+        size_t capacity = table.capacity;
+        size_t pushed_key_bytes = table.keys.item_count;
+        for (int pass = 0; pass < 10; ++pass)
+        for (uint32_t i = 0; i < 5000; i += 2)
+        {
+            snprintf(key, sizeof(key), "temp %u", i);
+            hashtable_set_copy(&table, key, &i);
+            TEST_ASSERT(hashtable_remove(&table, key));
+            pushed_key_bytes += strlen(key) + 1;
+        }
+
+        TEST_ASSERT(table.capacity == capacity && table.item_count == 2500);
+        TEST_ASSERT(hashtable_at_const(&table, "key 1") == kept && *kept == 1);
+        TEST_ASSERT(table.keys.item_count < pushed_key_bytes / 2);
+
+        bool all_found = true;
+        for (uint32_t i = 0; i < 5000; ++i)
+        {
+            snprintf(key, sizeof(key), "key %u", i);
+            const uint32_t *value = hashtable_at_const(&table, key);
+            all_found &= i % 2 ? value && *value == i : value == NULL;
+        }
+        TEST_ASSERT(all_found);
+
+        test_clear_callback_calls = 0;
+        hashtable_clear_with_callback(&table, NULL, &test_clear_callback);
+        TEST_ASSERT(test_clear_callback_calls == 2500 && !hashtable_at(&table, "key 1"));
+
     TEST_END();
     return 0;
 }
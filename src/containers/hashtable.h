@@ -4,26 +4,44 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-typedef struct HashTableEntry
+#include "vec.h"
+
+#define HASHTABLE_PAGE_ITEM_COUNT 64
+
+typedef struct HashTableSlot
 {
-    char *key;
-    struct HashTableEntry *next;
-    uint8_t value[];
+    uint64_t hash;
+    uint32_t key_offset; // in to the key arena
+    uint32_t distance; // from the slot the hash maps to, plus one, or zero for an empty slot
+    uint32_t value_index; // in to the value pages
 }
-HashTableEntry;
+HashTableSlot;
 
+// Open addressing with Robin Hood probing: an entry being inserted takes the slot of any entry closer to its
+// home slot, which keeps probe lengths short and even, so tables can run at a high load factor. Full hashes are
+// stored beside the key offsets, so most mismatches are rejected without touching the keys, which live together
+// in one arena. Only the slots move as entries are set and removed. Values live in fixed-size pages which are
+// never reallocated, so a pointer from hashtable_at or hashtable_set_copy stays valid until its entry is removed.
 typedef struct HashTable
 {
-	size_t table_size;
+    size_t initial_capacity;
     size_t item_size;
-    HashTableEntry **table;
+    size_t item_count;
+    size_t capacity; // in slots, a power of two, or zero until the first set
+    HashTableSlot *slots;
+    Vec value_pages; // of uint8_t*, each holding HASHTABLE_PAGE_ITEM_COUNT values
+    Vec free_values; // of uint32_t, indices of removed values to reuse
+    uint32_t value_count; // value indices handed out so far
+    Vec keys; // of char, each key NUL terminated
+    size_t dead_key_bytes; // arena bytes held by removed keys, reclaimed when the arena is rebuilt
 }
 HashTable;
 
 // First arg is arbitrary context, second arg is the element operated on
 typedef void (*HashTableCallback)(void*, void*);
 
-extern HashTable hashtable_empty(size_t table_size, size_t item_size);
+// The table starts with room for initial_capacity items, and grows as needed.
+extern HashTable hashtable_empty(size_t initial_capacity, size_t item_size);
 
 extern void *hashtable_at(HashTable *table, const char *key);
 extern const void *hashtable_at_const(const HashTable *table, const char *key);
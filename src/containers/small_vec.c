@@ -0,0 +1,148 @@
+#include "small_vec.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint8_t *items(SmallVec *vec)
+{
+    return vec->data ? vec->data : (uint8_t*)(vec + 1);
+}
+
+void *small_vec_at(SmallVec *vec, size_t index)
+{
+    return items(vec) + vec->item_size * index;
+}
+
+const void *small_vec_at_const(const SmallVec *vec, size_t index)
+{
+    return small_vec_at((SmallVec*)vec, index);
+}
+
+static void grow(SmallVec *vec)
+{
+    uint32_t capacity = vec->capacity < 2 ? 4 : vec->capacity * 2;
+
+    if (vec->data)
+    {
+        vec->data = realloc(vec->data, vec->item_size * capacity);
+    }
+    else
+    {
+        vec->data = malloc(vec->item_size * capacity);
+        memcpy(vec->data, vec + 1, vec->item_size * vec->item_count);
+    }
+
+    vec->capacity = capacity;
+}
+
+void *small_vec_push_copy(SmallVec *vec, const void *item_ref)
+{
+    if (vec->item_count == vec->capacity) grow(vec);
+
+    void *result = small_vec_at(vec, vec->item_count++);
+    memcpy(result, item_ref, vec->item_size);
+    return result;
+}
+
+void small_vec_remove(SmallVec *vec, size_t index)
+{
+    if (index >= vec->item_count) return;
+
+    if (index < vec->item_count - 1)
+        memmove(small_vec_at(vec, index), small_vec_at(vec, index + 1), (vec->item_count - 1 - index) * vec->item_size);
+
+    if (--vec->item_count == 0)
+        small_vec_clear(vec);
+}
+
+int small_vec_find_index(const SmallVec *vec, void *context, VecItemChecker check)
+{
+    for (int i = 0; i < vec->item_count; ++i)
+        if (check(context, small_vec_at_const(vec, i)))
+            return i;
+
+    return -1;
+}
+
+void small_vec_deep_copy(SmallVec *vec)
+{
+    if (!vec->data) return;
+
+    void *copy = malloc(vec->item_size * vec->capacity);
+    memcpy(copy, vec->data, vec->item_size * vec->item_count);
+    vec->data = copy;
+}
+
+void small_vec_clear(SmallVec *vec)
+{
+    free(vec->data);
+    vec->data = NULL;
+    vec->item_count = 0;
+    vec->capacity = vec->inline_capacity;
+}
+
+#ifdef RUN_TESTS
+static bool test_find_callback(const uint16_t *a, const uint16_t *b)
+{
+    return *a == *b;
+}
+
+TestResult small_vec_test(void)
+{
+    TEST_BEGIN("SmallVec keeps items inline until it outgrows them");
+
+        SMALL_VEC(uint16_t, 3) v = SMALL_VEC_EMPTY(uint16_t, 3);
+
+        for (uint16_t i = 0; i < 3; ++i)
+            small_vec_push_copy(&v.vec, &i);
+
+        TEST_ASSERT(v.vec.data == NULL && v.items_[2] == 2);
+        TEST_ASSERT(small_vec_at(&v.vec, 1) == &v.items_[1]);
+
+        uint16_t a = 3;
+        small_vec_push_copy(&v.vec, &a);
+
+        TEST_ASSERT(v.vec.data != NULL && v.vec.item_count == 4);
+        TEST_ASSERT(*(uint16_t*)small_vec_at(&v.vec, 0) == 0 && *(uint16_t*)small_vec_at(&v.vec, 3) == 3);
+
+        a = 2;
+        TEST_ASSERT(small_vec_find_index(&v.vec, &a, test_find_callback) == 2);
+        small_vec_remove(&v.vec, 0);
+        TEST_ASSERT(small_vec_find_index(&v.vec, &a, test_find_callback) == 1);
+
+        while (v.vec.item_count > 0)
+            small_vec_remove(&v.vec, v.vec.item_count - 1);
+
+        TEST_ASSERT(v.vec.data == NULL && v.vec.capacity == 3);
+
+    TEST_END();
+    TEST_BEGIN("SmallVec copies bytewise, and deep copies only when spilled");
+
+        SMALL_VEC(uint16_t, 2) v = SMALL_VEC_EMPTY(uint16_t, 2);
+
+        uint16_t a = 7;
+        small_vec_push_copy(&v.vec, &a);
+
+        SMALL_VEC(uint16_t, 2) u;
+        memcpy(&u, &v, sizeof(u));
+        small_vec_deep_copy(&u.vec);
+
+        a = 8;
+        small_vec_push_copy(&u.vec, &a);
+
+        TEST_ASSERT(v.vec.item_count == 1 && u.vec.item_count == 2);
+        TEST_ASSERT(*(uint16_t*)small_vec_at(&u.vec, 0) == 7 && u.vec.data == NULL);
+
+        small_vec_push_copy(&u.vec, &a);
+        memcpy(&v, &u, sizeof(v));
+        small_vec_deep_copy(&v.vec);
+
+        TEST_ASSERT(v.vec.data != u.vec.data && *(uint16_t*)small_vec_at(&v.vec, 2) == 8);
+
+        small_vec_clear(&u.vec);
+        small_vec_clear(&v.vec);
+
+    TEST_END();
+    return 0;
+}
+#endif
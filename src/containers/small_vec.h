@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vec.h"
+
+// A list with room for a few items inside the struct itself, which only allocates once it outgrows them. The
+// inline items directly follow the header and are found by their offset from it rather than through data, so a
+// SmallVec can be copied bytewise like any other component field. data stays NULL until the items spill to the
+// heap, and emptying the list returns them to the inline storage.
+typedef struct SmallVec
+{
+    size_t item_size;
+    size_t item_count;
+    void *data;
+    uint32_t capacity; // in items, the inline capacity until the items spill
+    uint32_t inline_capacity;
+}
+SmallVec;
+
+// Declares a SmallVec of T with room for n items inline. Pass the header, e.g. small_vec_push_copy(&x.vec, &item),
+// to the functions below. T may not be aligned to more than sizeof(SmallVec), so that the items start right
+// after the header.
+#define SMALL_VEC(T, n) struct { SmallVec vec; T items_[n]; }
+#define SMALL_VEC_EMPTY(T, n) { { sizeof(T), 0, NULL, (n), (n) } }
+
+extern void *small_vec_at(SmallVec *vec, size_t index);
+extern const void *small_vec_at_const(const SmallVec *vec, size_t index);
+
+extern void *small_vec_push_copy(SmallVec *vec, const void *item_ref);
+extern void small_vec_remove(SmallVec *vec, size_t index);
+extern int small_vec_find_index(const SmallVec *vec, void *context, VecItemChecker check);
+
+// Replaces the heap storage a bytewise copy shares with the original with a copy of its own.
+extern void small_vec_deep_copy(SmallVec *vec);
+extern void small_vec_clear(SmallVec *vec);
+
+#ifdef RUN_TESTS
+#include "../testing.h"
+extern TestResult small_vec_test(void);
+#endif
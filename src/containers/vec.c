@@ -5,9 +5,42 @@
 #include <stdbool.h>
 #include <string.h>
 
+#define VEC_MIN_CAPACITY 4
+
 Vec vec_empty(size_t item_size)
 {
-    return (Vec){ item_size, 0, NULL };
+    return (Vec){ item_size, 0, NULL, 0 };
+}
+
+static void set_capacity(Vec *vec, size_t capacity)
+{
+    vec->data = realloc(vec->data, vec->item_size * capacity);
+    vec->capacity = capacity;
+}
+
+void vec_grow(Vec *vec, size_t item_count)
+{
+    if (item_count <= vec->capacity) return;
+
+    size_t capacity = vec->capacity * 2;
+    if (capacity < VEC_MIN_CAPACITY) capacity = VEC_MIN_CAPACITY;
+    if (capacity < item_count) capacity = item_count;
+
+    set_capacity(vec, capacity);
+}
+
+void vec_reserve(Vec *vec, size_t capacity)
+{
+    if (capacity > vec->capacity)
+        set_capacity(vec, capacity);
+}
+
+void vec_shrink_to_fit(Vec *vec)
+{
+    if (vec->item_count == 0)
+        vec_clear(vec);
+    else if (vec->capacity > vec->item_count)
+        set_capacity(vec, vec->item_count);
 }
 
 void *vec_at(Vec *vec, size_t index)
@@ -27,12 +60,25 @@ void vec_set_copy(Vec *vec, size_t index, const void *item_ref)
 
 void *vec_push_copy(Vec *vec, const void *item_ref)
 {
+    vec_grow(vec, vec->item_count + 1);
     vec->item_count++;
-    vec->data = realloc(vec->data, vec->item_size * vec->item_count);
     vec_set_copy(vec, vec->item_count - 1, item_ref);
     return (uint8_t*)vec->data + vec->item_size * (vec->item_count - 1);
 }
 
+void *vec_push_many(Vec *vec, size_t count, const void *items)
+{
+    if (count == 0) return NULL;
+
+    vec_grow(vec, vec->item_count + count);
+
+    void *first = vec_at(vec, vec->item_count);
+    memcpy(first, items, count * vec->item_size);
+    vec->item_count += count;
+
+    return first;
+}
+
 void vec_insert_copy(Vec *vec, size_t index, const void *item_ref)
 {
     if (index < vec->item_count)
@@ -57,6 +103,16 @@ void vec_remove(Vec *vec, size_t index)
     vec_resize(vec, vec->item_count - 1);
 }
 
+void vec_swap_remove(Vec *vec, size_t index)
+{
+    if (index >= vec->item_count) return;
+
+    if (index < vec->item_count - 1)
+        memcpy(vec_at(vec, index), vec_at(vec, vec->item_count - 1), vec->item_size);
+
+    vec_resize(vec, vec->item_count - 1);
+}
+
 bool vec_pop(Vec *vec, void *result)
 {
     if (vec->item_count == 0) return false;
@@ -64,9 +120,7 @@ bool vec_pop(Vec *vec, void *result)
     vec->item_count--;
     memcpy(result, vec_at(vec, vec->item_count), vec->item_size);
 
-    if (vec->item_count > 0)
-        vec->data = realloc(vec->data, vec->item_size * vec->item_count);
-    else
+    if (vec->item_count == 0)
         vec_clear(vec);
 
     return true;
@@ -84,8 +138,10 @@ int vec_find_index(const Vec *vec, void *context, VecItemChecker check)
 Vec vec_clone(const Vec *vec)
 {
     Vec result = vec_empty(vec->item_size);
+    if (vec->item_count == 0) return result;
+
+    set_capacity(&result, vec->item_count);
     result.item_count = vec->item_count;
-    result.data = malloc(result.item_count * result.item_size);
     memcpy(result.data, vec->data, result.item_count * result.item_size);
     return result;
 }
@@ -103,8 +159,8 @@ void vec_resize(Vec *vec, size_t new_item_count)
         : 0;
 
     size_t old_item_count = vec->item_count;
+    vec_grow(vec, new_item_count);
     vec->item_count = new_item_count;
-    vec->data = realloc(vec->data, vec->item_size * vec->item_count);
 
     if (additional_item_count > 0)
         memset((uint8_t*)vec->data + old_item_count * vec->item_size, 0, additional_item_count * vec->item_size);
@@ -115,6 +171,7 @@ void vec_clear(Vec *vec)
     free(vec->data);
     vec->data = 0;
     vec->item_count = 0;
+    vec->capacity = 0;
 }
 
 void vec_clear_with_callback(Vec *vec, void *context, VecCallback cb)
@@ -140,6 +197,15 @@ static bool test_find_callback(const uint8_t *a, const uint8_t *b)
     return *a == *b;
 }
 
+typedef struct TestPair
+{
+    uint16_t a;
+    float b;
+}
+TestPair;
+
+VEC_DECLARE(TestPair)
+
 TestResult vec_test(void)
 {
     TEST_BEGIN("Vec at, push, and pop work correctly");
@@ -278,6 +344,88 @@ TestResult vec_test(void)
         vec_clear(&v);
         vec_clear(&u);
 
+    TEST_END();
+    TEST_BEGIN("Vec grows geometrically and keeps its storage until emptied");
+
+        Vec v = vec_empty(sizeof(uint32_t));
+
+        size_t reallocs = 0;
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            void *before = v.data;
+            size_t capacity = v.capacity;
+            vec_push_copy(&v, &i);
+            if (v.capacity != capacity || v.data != before) reallocs++;
+        }
+
+        TEST_ASSERT(reallocs < 12);
+        TEST_ASSERT(v.capacity >= 1000);
+
+        size_t capacity = v.capacity;
+        uint32_t popped;
+        vec_pop(&v, &popped);
+        vec_remove(&v, 0);
+        vec_resize(&v, 10);
+        TEST_ASSERT(v.capacity == capacity && popped == 999);
+
+        vec_shrink_to_fit(&v);
+        TEST_ASSERT(v.capacity == 10 && *(uint32_t*)vec_at(&v, 9) == 10);
+
+        vec_reserve(&v, 64);
+        TEST_ASSERT(v.capacity == 64 && v.item_count == 10);
+
+        vec_resize(&v, 0);
+        TEST_ASSERT(v.capacity == 0 && v.data == 0);
+
+        Vec empty_clone = vec_clone(&v);
+        TEST_ASSERT(empty_clone.data == 0 && empty_clone.item_count == 0);
+
+    TEST_END();
+    TEST_BEGIN("Vec push many and swap remove behave correctly");
+
+        Vec v = vec_empty(sizeof(uint8_t));
+
+        uint8_t items[] = { 0, 1, 2, 3, 4 };
+        uint8_t *first = vec_push_many(&v, 5, items);
+        TEST_ASSERT(first == vec_at(&v, 0) && v.item_count == 5);
+
+        first = vec_push_many(&v, 2, items);
+        TEST_ASSERT(first == vec_at(&v, 5) && *first == 0 && v.item_count == 7); //[0,1,2,3,4,0,1]
+
+        vec_swap_remove(&v, 1); //[0,1,2,3,4,0]
+        TEST_ASSERT(*(uint8_t*)vec_at(&v, 1) == 1 && v.item_count == 6);
+
+        vec_swap_remove(&v, 2); //[0,1,0,3,4]
+        TEST_ASSERT(*(uint8_t*)vec_at(&v, 2) == 0 && *(uint8_t*)vec_at(&v, 4) == 4);
+
+        vec_swap_remove(&v, 4); //[0,1,0,3]
+        TEST_ASSERT(v.item_count == 4 && *(uint8_t*)vec_at(&v, 3) == 3);
+
+        vec_clear(&v);
+
+    TEST_END();
+    TEST_BEGIN("Typed Vec accessors share storage with the untyped functions");
+
+        Vec v = vec_TestPair_empty();
+
+        for (uint16_t i = 0; i < 100; ++i)
+            vec_TestPair_push(&v, (TestPair){ i, i * 0.5f });
+
+        TEST_ASSERT(v.item_count == 100);
+        TEST_ASSERT(vec_TestPair_at(&v, 10) == vec_at(&v, 10));
+        TEST_ASSERT(vec_TestPair_get(&v, 99).a == 99 && vec_TestPair_at_const(&v, 4)->b == 2.f);
+
+        TestPair pair = { 7, 7.f };
+        vec_push_copy(&v, &pair);
+        vec_TestPair_set(&v, 0, pair);
+        TEST_ASSERT(((const TestPair*)vec_at_const(&v, 0))->a == 7);
+
+        TestPair popped;
+        TEST_ASSERT(vec_TestPair_pop(&v, &popped) && popped.b == 7.f && v.item_count == 100);
+
+        while (vec_TestPair_pop(&v, &popped)) {}
+        TEST_ASSERT(popped.a == 7 && v.data == 0);
+
     TEST_END();
     TEST_BEGIN("Vec find index finds item or returns -1");
 
@@ -4,11 +4,14 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Storage grows geometrically, so pushes are amortized O(1). Removing items keeps the storage for reuse until
+// the Vec is emptied, which frees it, or vec_shrink_to_fit is called.
 typedef struct Vec
 {
     size_t item_size;
     size_t item_count;
     void *data;
+    size_t capacity; // in items
 }
 Vec;
 
@@ -24,16 +27,64 @@ extern void vec_set_copy(Vec *vec, size_t index, const void *item_ref);
 
 extern void vec_insert_copy(Vec *vec, size_t index, const void *item_ref);
 extern void vec_remove(Vec *vec, size_t index);
+// Moves the last item in to the removed slot instead of shifting everything after it down.
+extern void vec_swap_remove(Vec *vec, size_t index);
 
 extern void *vec_push_copy(Vec *vec, const void *item_ref);
+// Returns the first pushed item.
+extern void *vec_push_many(Vec *vec, size_t count, const void *items);
 extern bool vec_pop(Vec *vec, void *result);
 
+extern void vec_reserve(Vec *vec, size_t capacity);
+// As vec_reserve, but grows geometrically so that calling it before every push stays amortized O(1).
+extern void vec_grow(Vec *vec, size_t item_count);
+extern void vec_shrink_to_fit(Vec *vec);
+
 extern int vec_find_index(const Vec *vec, void *context, VecItemChecker check);
 extern Vec vec_clone(const Vec *vec);
 extern void vec_resize(Vec *vec, size_t new_item_count);
 extern void vec_clear(Vec *vec);
 extern void vec_clear_with_callback(Vec *vec, void *context, VecCallback cb);
 
+// Declares static inline accessors for a Vec of T, e.g. VEC_DECLARE(Triangle) gives vec_Triangle_at, with the
+// item size known at compile time so that loops over them can be inlined and vectorized. They work on the plain
+// Vec struct, so a Vec of T may be used with both these and the functions above, as long as its item size is
+// sizeof(T). T must be a single identifier, so pointer types need a typedef first.
+#define VEC_DECLARE(T) \
+    static inline Vec vec_##T##_empty(void) \
+    { \
+        return vec_empty(sizeof(T)); \
+    } \
+    static inline T *vec_##T##_at(Vec *vec, size_t index) \
+    { \
+        return (T*)vec->data + index; \
+    } \
+    static inline const T *vec_##T##_at_const(const Vec *vec, size_t index) \
+    { \
+        return (const T*)vec->data + index; \
+    } \
+    static inline T vec_##T##_get(const Vec *vec, size_t index) \
+    { \
+        return ((const T*)vec->data)[index]; \
+    } \
+    static inline void vec_##T##_set(Vec *vec, size_t index, T item) \
+    { \
+        ((T*)vec->data)[index] = item; \
+    } \
+    static inline T *vec_##T##_push(Vec *vec, T item) \
+    { \
+        if (vec->item_count == vec->capacity) vec_grow(vec, vec->item_count + 1); \
+        T *result = (T*)vec->data + vec->item_count++; \
+        *result = item; \
+        return result; \
+    } \
+    static inline bool vec_##T##_pop(Vec *vec, T *result) \
+    { \
+        if (vec->item_count == 0) return false; \
+        *result = ((const T*)vec->data)[--vec->item_count]; \
+        if (vec->item_count == 0) vec_clear(vec); \
+        return true; \
+    }
 
 #ifdef RUN_TESTS
 #include "../testing.h"
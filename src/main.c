@@ -7,6 +7,7 @@
 #endif
 
 #include "shell.h"
+#include "scheduler.h"
 #include "component_defs.h"
 #include "containers/ecs.h"
 #include "containers/hashcache.h"
@@ -30,6 +31,131 @@ static void resources_init( HashCache *resources )
     hashcache_register( resources, "png", texture_load, texture_delete );
 }
 
+typedef struct Frame
+{
+    ShellContext *ctx;
+    HashCache *resources;
+
+    ClockSystem *clock_system;
+    InputSystem *input_system;
+    TransformSystem *transform_system;
+    RenderSystem *render_system;
+    EditorSystem *editor_system;
+    CollisionSystem *collision_system;
+    Game *game;
+
+    bool switching_mode;
+    bool play_mode;
+    EditorSystemUpdateResult editor_update;
+}
+Frame;
+
+static void run_clock( ECS *ecs, ECSCommandBuffer *commands, void *context )
+{
+    Frame *frame = context;
+    clock_sys_run( frame->clock_system, ecs, frame->switching_mode );
+}
+
+static void run_input( ECS *ecs, ECSCommandBuffer *commands, void *context )
+{
+    Frame *frame = context;
+    input_sys_run( frame->input_system, ecs, shell_get_controller( frame->ctx ) );
+}
+
+static void run_collision( ECS *ecs, ECSCommandBuffer *commands, void *context )
+{
+    Frame *frame = context;
+    collision_sys_run( frame->collision_system, ecs, frame->resources );
+}
+
+static void run_game( ECS *ecs, ECSCommandBuffer *commands, void *context )
+{
+    Frame *frame = context;
+
+    if( frame->play_mode )
+    {
+        if( frame->switching_mode ) frame->game = game_new( ecs );
+        game_update( frame->game, ecs );
+    }
+    else if( frame->switching_mode )
+    {
+        game_delete( frame->game );
+        frame->game = NULL;
+    }
+}
+
+static void run_editor( ECS *ecs, ECSCommandBuffer *commands, void *context )
+{
+    Frame *frame = context;
+    frame->editor_update = editor_sys_run( frame->editor_system, ecs );
+}
+
+static void run_transform( ECS *ecs, ECSCommandBuffer *commands, void *context )
+{
+    Frame *frame = context;
+    transform_sys_run( frame->transform_system, ecs );
+}
+
+static void run_render( ECS *ecs, ECSCommandBuffer *commands, void *context )
+{
+    Frame *frame = context;
+    render_sys_run( frame->render_system, ecs, frame->resources, shell_get_aspect( frame->ctx ), frame->editor_update.in_game_view );
+}
+
+// Systems that run concurrently must not create entities, so the singletons they share are created up front.
+static void ensure_engine_singletons( ECS *ecs )
+{
+    ECS_ENSURE_AND_BORROW_SINGLETON_DECL( ClockInfo, ecs, clock );
+    ECS_RETURN_COMPONENT( ecs, clock );
+    ECS_ENSURE_AND_BORROW_SINGLETON_DECL( InputState, ecs, inputs );
+    ECS_RETURN_COMPONENT( ecs, inputs );
+    ECS_ENSURE_AND_BORROW_SINGLETON_DECL( WorldCollisionInfo, ecs, collision );
+    ECS_RETURN_COMPONENT( ecs, collision );
+}
+
+static Scheduler *scheduler_new_for_frame( Frame *frame )
+{
+    int cpu_count = SDL_GetCPUCount();
+    Scheduler *sched = scheduler_new( cpu_count > 2 ? 2 : cpu_count - 1 );
+    const void *resources[] = { frame->resources };
+
+    scheduler_add_system( sched, &(SchedulerSystemDesc){
+        .name = "clock", .run = run_clock, .context = frame,
+        SCHEDULER_WRITES( ClockInfo ),
+    });
+    scheduler_add_system( sched, &(SchedulerSystemDesc){
+        .name = "input", .run = run_input, .context = frame,
+        SCHEDULER_WRITES( InputState ),
+        .main_thread = true,
+    });
+    scheduler_add_system( sched, &(SchedulerSystemDesc){
+        .name = "collision", .run = run_collision, .context = frame,
+        SCHEDULER_READS( MeshCollider, Transform ),
+        SCHEDULER_WRITES( WorldCollisionInfo ),
+        .resource_count = 1, .resources = resources,
+    });
+    scheduler_add_system( sched, &(SchedulerSystemDesc){
+        .name = "game", .run = run_game, .context = frame,
+        .main_thread = true, .exclusive = true,
+    });
+    scheduler_add_system( sched, &(SchedulerSystemDesc){
+        .name = "editor", .run = run_editor, .context = frame,
+        .main_thread = true, .exclusive = true,
+    });
+    scheduler_add_system( sched, &(SchedulerSystemDesc){
+        .name = "transform", .run = run_transform, .context = frame,
+        SCHEDULER_WRITES( Transform, TransformCold ),
+    });
+    scheduler_add_system( sched, &(SchedulerSystemDesc){
+        .name = "render", .run = run_render, .context = frame,
+        SCHEDULER_READS( Camera, MeshRenderer, MeshCollider, Transform ),
+        .resource_count = 1, .resources = resources,
+        .main_thread = true,
+    });
+
+    return sched;
+}
+
 int main( int argc, char **argv )
 {
     #ifdef RUN_TESTS
@@ -42,58 +168,51 @@ int main( int argc, char **argv )
 
     ECS *ecs = components_ecs_new();
 
-    bool switching_mode = false;
-    bool play_mode = false;
+    Frame frame = { 0 };
+    frame.ctx = ctx;
+    frame.resources = resources;
+    frame.clock_system = clock_sys_new();
+    frame.input_system = input_sys_new( ctx );
+    frame.transform_system = transform_sys_new();
+    frame.render_system = render_sys_new( resources );
+    frame.editor_system = editor_sys_new();
+    frame.collision_system = collision_sys_new();
 
-    ClockSystem *clock_system = clock_sys_new();
-    InputSystem *input_system = input_sys_new( ctx );
-    TransformSystem *transform_system = transform_sys_new();
-    RenderSystem *render_system = render_sys_new( resources );
-    EditorSystem *editor_system = editor_sys_new();
-    CollisionSystem *collision_system = collision_sys_new();
-
-    Game *game = NULL;
+    Scheduler *scheduler = scheduler_new_for_frame( &frame );
 
     do
     {
-        clock_sys_run( clock_system, ecs, switching_mode );
-        input_sys_run( input_system, ecs, shell_get_controller( ctx ) );
-        collision_sys_run( collision_system, ecs, resources );
-
-        if( play_mode )
-        {
-            if( switching_mode ) game = game_new( ecs );
-            game_update( game, ecs );
-        }
-        else if( switching_mode )
-        {
-            game_delete( game );
-            game = NULL;
-        }
+        ensure_engine_singletons( ecs );
+        scheduler_run( scheduler, ecs );
+        ecs_flush_change_events( ecs );
+        ecs_compact( ecs );
 
-        EditorSystemUpdateResult editor_update = editor_sys_run( editor_system, ecs );
-        transform_sys_run( transform_system, ecs );
-        render_sys_run( render_system, ecs, resources, shell_get_aspect( ctx ), editor_update.in_game_view );
+        #ifdef PRINT_SCHEDULER_TRACE
+            scheduler_print_trace( scheduler );
+        #endif
 
-        if( editor_update.new_ecs )
+        if( frame.editor_update.new_ecs )
         {
             ecs_delete( ecs );
-            ecs = editor_update.new_ecs;
+            ecs = frame.editor_update.new_ecs;
+            ecs_mark_all_changed( ecs );
         }
 
-        switching_mode = editor_update.in_play_mode != play_mode;
-        play_mode = editor_update.in_play_mode;
+        frame.switching_mode = frame.editor_update.in_play_mode != frame.play_mode;
+        frame.play_mode = frame.editor_update.in_play_mode;
     }
     while( shell_flip_frame_poll_events( ctx ) );
 
-    if( game ) game_delete( game );
+    scheduler_delete( scheduler );
+
+    if( frame.game ) game_delete( frame.game );
 
-    collision_sys_delete( collision_system );
-    editor_sys_delete( editor_system );
-    render_sys_delete( render_system );
-    transform_sys_delete( transform_system );
-    input_sys_delete( input_system );
-    clock_sys_delete( clock_system );
+    collision_sys_delete( frame.collision_system );
+    editor_sys_delete( frame.editor_system );
+    render_sys_delete( frame.render_system );
+    transform_sys_delete( frame.transform_system );
+    input_sys_delete( frame.input_system );
+    clock_sys_delete( frame.clock_system );
 
     hashcache_delete( resources );
     ecs_delete( ecs );
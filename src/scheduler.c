@@ -0,0 +1,461 @@
+#include "scheduler.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ns_clock.h>
+
+#include "gl.h"
+#include "utils.h"
+#include "containers/vec.h"
+
+typedef struct ScheduledSystem
+{
+    SchedulerSystemDesc desc; // reads, writes and resources point in to the Vecs below
+    Vec reads; // of ECSComponentID
+    Vec writes; // of ECSComponentID
+    Vec resources; // of const void*
+    Vec dependencies; // of size_t, indices of earlier systems which must finish first
+    Vec dependents; // of size_t, indices of later systems waiting on this one
+    size_t remaining_dependencies;
+}
+ScheduledSystem;
+
+struct Scheduler
+{
+    Vec systems; // of ScheduledSystem
+    Vec workers; // of SDL_Thread*
+    Vec commands; // of ECSCommandBuffer*, one per thread with the main thread first
+    Vec trace; // of SchedulerTraceEntry, parallel to systems
+
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+    Vec ready; // of size_t, guarded by mutex
+    size_t finished_count; // guarded by mutex
+    bool quitting; // guarded by mutex
+
+    ECS *ecs;
+    uint64_t frame_start;
+};
+
+typedef struct WorkerArgs
+{
+    Scheduler *sched;
+    int thread;
+}
+WorkerArgs;
+
+static bool ids_overlap( const Vec *a, const Vec *b )
+{
+    for( int i = 0; i < a->item_count; ++i )
+    for( int j = 0; j < b->item_count; ++j )
+        if( *(const ECSComponentID*)vec_at_const( a, i ) == *(const ECSComponentID*)vec_at_const( b, j ) )
+            return true;
+
+    return false;
+}
+
+static bool resources_overlap( const Vec *a, const Vec *b )
+{
+    for( int i = 0; i < a->item_count; ++i )
+    for( int j = 0; j < b->item_count; ++j )
+        if( *(const void**)vec_at_const( a, i ) == *(const void**)vec_at_const( b, j ) )
+            return true;
+
+    return false;
+}
+
+static bool systems_conflict( const ScheduledSystem *a, const ScheduledSystem *b )
+{
+    return a->desc.exclusive || b->desc.exclusive
+        || ids_overlap( &a->writes, &b->writes )
+        || ids_overlap( &a->writes, &b->reads )
+        || ids_overlap( &a->reads, &b->writes )
+        || resources_overlap( &a->resources, &b->resources );
+}
+
+static Vec vec_from_array( size_t item_size, size_t count, const void *items )
+{
+    Vec result = vec_empty( item_size );
+    for( size_t i = 0; i < count; ++i )
+        vec_push_copy( &result, (const uint8_t*)items + i * item_size );
+    return result;
+}
+
+// Must be called with the mutex held. Systems are taken in the order they were added, and only the main
+// thread may take systems which need it.
+static bool take_ready_system( Scheduler *sched, bool is_main_thread, size_t *out_index )
+{
+    size_t best = 0;
+    size_t best_index = SIZE_MAX;
+
+    for( int i = 0; i < sched->ready.item_count; ++i )
+    {
+        size_t index = *(size_t*)vec_at( &sched->ready, i );
+        const ScheduledSystem *system = vec_at_const( &sched->systems, index );
+
+        if( system->desc.main_thread && !is_main_thread ) continue;
+
+        if( index < best_index )
+        {
+            best = i;
+            best_index = index;
+        }
+    }
+
+    if( best_index == SIZE_MAX ) return false;
+
+    vec_remove( &sched->ready, best );
+    *out_index = best_index;
+    return true;
+}
+
+// Must be called with the mutex held.
+static void finish_system( Scheduler *sched, size_t index )
+{
+    const ScheduledSystem *system = vec_at_const( &sched->systems, index );
+
+    for( int i = 0; i < system->dependents.item_count; ++i )
+    {
+        size_t dependent_index = *(const size_t*)vec_at_const( &system->dependents, i );
+        ScheduledSystem *dependent = vec_at( &sched->systems, dependent_index );
+
+        if( --dependent->remaining_dependencies == 0 )
+            vec_push_copy( &sched->ready, &dependent_index );
+    }
+
+    sched->finished_count++;
+    SDL_CondBroadcast( sched->cond );
+}
+
+static void run_system( Scheduler *sched, size_t index, int thread )
+{
+    const ScheduledSystem *system = vec_at_const( &sched->systems, index );
+    SchedulerTraceEntry *entry = vec_at( &sched->trace, index );
+
+    ECSCommandBuffer *commands = *(ECSCommandBuffer**)vec_at( &sched->commands, thread );
+
+    entry->thread = thread;
+    entry->start_ns = ns_clock() - sched->frame_start;
+    system->desc.run( sched->ecs, commands, system->desc.context );
+    entry->end_ns = ns_clock() - sched->frame_start;
+}
+
+// Takes and runs ready systems until there is nothing left for this thread to do. Must be called with the
+// mutex held, which is released while each system runs.
+static void run_ready_systems( Scheduler *sched, int thread )
+{
+    size_t index;
+
+    while( take_ready_system( sched, thread == 0, &index ) )
+    {
+        SDL_UnlockMutex( sched->mutex );
+        run_system( sched, index, thread );
+        SDL_LockMutex( sched->mutex );
+        finish_system( sched, index );
+    }
+}
+
+static int worker_main( void *data )
+{
+    WorkerArgs args = *(WorkerArgs*)data;
+    free( data );
+
+    Scheduler *sched = args.sched;
+    SDL_LockMutex( sched->mutex );
+
+    while( !sched->quitting )
+    {
+        run_ready_systems( sched, args.thread );
+        if( !sched->quitting ) SDL_CondWait( sched->cond, sched->mutex );
+    }
+
+    SDL_UnlockMutex( sched->mutex );
+    return 0;
+}
+
+Scheduler *scheduler_new( int worker_count )
+{
+    Scheduler *sched = malloc( sizeof( Scheduler ) );
+
+    sched->systems = vec_empty( sizeof( ScheduledSystem ) );
+    sched->workers = vec_empty( sizeof( SDL_Thread* ) );
+    sched->commands = vec_empty( sizeof( ECSCommandBuffer* ) );
+    sched->trace = vec_empty( sizeof( SchedulerTraceEntry ) );
+    sched->mutex = SDL_CreateMutex();
+    sched->cond = SDL_CreateCond();
+    sched->ready = vec_empty( sizeof( size_t ) );
+    sched->finished_count = 0;
+    sched->quitting = false;
+    sched->ecs = NULL;
+    sched->frame_start = 0;
+
+    for( int i = 0; i <= worker_count; ++i )
+    {
+        ECSCommandBuffer *commands = ecs_commands_new();
+        vec_push_copy( &sched->commands, &commands );
+    }
+
+    for( int i = 0; i < worker_count; ++i )
+    {
+        WorkerArgs *args = malloc( sizeof( WorkerArgs ) );
+        args->sched = sched;
+        args->thread = i + 1;
+
+        SDL_Thread *thread = SDL_CreateThread( worker_main, "scheduler worker", args );
+        if( !thread ) PANIC( "Failed to create scheduler worker thread: %s\n", SDL_GetError() );
+
+        vec_push_copy( &sched->workers, &thread );
+    }
+
+    return sched;
+}
+
+void scheduler_add_system( Scheduler *sched, const SchedulerSystemDesc *desc )
+{
+    ScheduledSystem system;
+
+    system.desc = *desc;
+    system.reads = vec_from_array( sizeof( ECSComponentID ), desc->read_count, desc->reads );
+    system.writes = vec_from_array( sizeof( ECSComponentID ), desc->write_count, desc->writes );
+    system.resources = vec_from_array( sizeof( const void* ), desc->resource_count, desc->resources );
+    system.dependencies = vec_empty( sizeof( size_t ) );
+    system.dependents = vec_empty( sizeof( size_t ) );
+    system.remaining_dependencies = 0;
+
+    system.desc.reads = system.reads.data;
+    system.desc.writes = system.writes.data;
+    system.desc.resources = system.resources.data;
+
+    size_t index = sched->systems.item_count;
+
+    for( size_t i = 0; i < index; ++i )
+    {
+        ScheduledSystem *earlier = vec_at( &sched->systems, i );
+        if( !systems_conflict( earlier, &system ) ) continue;
+
+        vec_push_copy( &system.dependencies, &i );
+        vec_push_copy( &earlier->dependents, &index );
+    }
+
+    vec_push_copy( &sched->systems, &system );
+
+    SchedulerTraceEntry entry = { desc->name, 0, 0, 0, false };
+    vec_push_copy( &sched->trace, &entry );
+}
+
+// Systems are stored in an order consistent with their dependencies, so one forward pass finds the longest
+// chain of durations ending at each system.
+static void mark_critical_path( Scheduler *sched )
+{
+    size_t count = sched->systems.item_count;
+    if( count == 0 ) return;
+
+    uint64_t *chain_ns = malloc( count * sizeof( uint64_t ) );
+    size_t *chain_parent = malloc( count * sizeof( size_t ) );
+    size_t last = 0;
+
+    for( size_t i = 0; i < count; ++i )
+    {
+        const ScheduledSystem *system = vec_at_const( &sched->systems, i );
+        SchedulerTraceEntry *entry = vec_at( &sched->trace, i );
+
+        chain_ns[i] = 0;
+        chain_parent[i] = SIZE_MAX;
+
+        for( int j = 0; j < system->dependencies.item_count; ++j )
+        {
+            size_t dependency = *(const size_t*)vec_at_const( &system->dependencies, j );
+
+            if( chain_ns[dependency] > chain_ns[i] )
+            {
+                chain_ns[i] = chain_ns[dependency];
+                chain_parent[i] = dependency;
+            }
+        }
+
+        chain_ns[i] += entry->end_ns - entry->start_ns;
+        entry->on_critical_path = false;
+
+        if( chain_ns[i] > chain_ns[last] ) last = i;
+    }
+
+    for( size_t i = last; i != SIZE_MAX; i = chain_parent[i] )
+        ((SchedulerTraceEntry*)vec_at( &sched->trace, i ))->on_critical_path = true;
+
+    free( chain_ns );
+    free( chain_parent );
+}
+
+void scheduler_run( Scheduler *sched, ECS *ecs )
+{
+    SDL_LockMutex( sched->mutex );
+
+    sched->ecs = ecs;
+    sched->frame_start = ns_clock();
+    sched->finished_count = 0;
+
+    for( size_t i = 0; i < sched->systems.item_count; ++i )
+    {
+        ScheduledSystem *system = vec_at( &sched->systems, i );
+        system->remaining_dependencies = system->dependencies.item_count;
+
+        if( system->remaining_dependencies == 0 )
+            vec_push_copy( &sched->ready, &i );
+    }
+
+    SDL_CondBroadcast( sched->cond );
+
+    while( sched->finished_count < sched->systems.item_count )
+    {
+        run_ready_systems( sched, 0 );
+
+        if( sched->finished_count < sched->systems.item_count )
+            SDL_CondWait( sched->cond, sched->mutex );
+    }
+
+    sched->ecs = NULL;
+    SDL_UnlockMutex( sched->mutex );
+
+    for( int i = 0; i < sched->commands.item_count; ++i )
+        ecs_commands_play( *(ECSCommandBuffer**)vec_at( &sched->commands, i ), ecs );
+
+    mark_critical_path( sched );
+}
+
+const SchedulerTraceEntry *scheduler_get_trace( const Scheduler *sched, size_t *entry_count )
+{
+    *entry_count = sched->trace.item_count;
+    return sched->trace.data;
+}
+
+void scheduler_print_trace( const Scheduler *sched )
+{
+    for( int i = 0; i < sched->trace.item_count; ++i )
+    {
+        const SchedulerTraceEntry *entry = vec_at_const( &sched->trace, i );
+
+        printf( "%c %-16s thread %d  %8.3f ms -> %8.3f ms\n",
+            entry->on_critical_path ? '*' : ' ',
+            entry->name, entry->thread,
+            (double)entry->start_ns * 1e-6, (double)entry->end_ns * 1e-6 );
+    }
+}
+
+static void clear_scheduled_system( void *x, ScheduledSystem *system )
+{
+    vec_clear( &system->reads );
+    vec_clear( &system->writes );
+    vec_clear( &system->resources );
+    vec_clear( &system->dependencies );
+    vec_clear( &system->dependents );
+}
+
+void scheduler_delete( Scheduler *sched )
+{
+    if( !sched ) return;
+
+    SDL_LockMutex( sched->mutex );
+    sched->quitting = true;
+    SDL_CondBroadcast( sched->cond );
+    SDL_UnlockMutex( sched->mutex );
+
+    for( int i = 0; i < sched->workers.item_count; ++i )
+        SDL_WaitThread( *(SDL_Thread**)vec_at( &sched->workers, i ), NULL );
+
+    SDL_DestroyCond( sched->cond );
+    SDL_DestroyMutex( sched->mutex );
+
+    vec_clear_with_callback( &sched->systems, NULL, clear_scheduled_system );
+    vec_clear( &sched->workers );
+
+    for( int i = 0; i < sched->commands.item_count; ++i )
+        ecs_commands_delete( *(ECSCommandBuffer**)vec_at( &sched->commands, i ) );
+
+    vec_clear( &sched->commands );
+    vec_clear( &sched->trace );
+    vec_clear( &sched->ready );
+
+    free( sched );
+}
+
+#ifdef RUN_TESTS
+
+enum { float_id, uint32_t_id };
+
+typedef struct TestSchedulerLog
+{
+    SDL_mutex *mutex;
+    int order[8];
+    int count;
+}
+TestSchedulerLog;
+
+static TestSchedulerLog s_test_log;
+
+static void test_log_system( ECS *ecs, ECSCommandBuffer *commands, void *context )
+{
+    SDL_LockMutex( s_test_log.mutex );
+    s_test_log.order[s_test_log.count++] = (int)(intptr_t)context;
+    SDL_UnlockMutex( s_test_log.mutex );
+
+    ecs_commands_create_entity( commands );
+}
+
+static int test_log_position( int system )
+{
+    for( int i = 0; i < s_test_log.count; ++i )
+        if( s_test_log.order[i] == system ) return i;
+    return -1;
+}
+
+TestResult scheduler_test( void )
+{
+    TEST_BEGIN( "Scheduler runs conflicting systems in order and marks the critical path" );
+
+        s_test_log.mutex = SDL_CreateMutex();
+
+        for( int workers = 0; workers <= 2; workers += 2 )
+        {
+            ECS *ecs = ecs_new();
+            Scheduler *sched = scheduler_new( workers );
+
+            scheduler_add_system( sched, &(SchedulerSystemDesc){ .name = "write float", .run = test_log_system, .context = (void*)0, SCHEDULER_WRITES( float ) } );
+            scheduler_add_system( sched, &(SchedulerSystemDesc){ .name = "write u32", .run = test_log_system, .context = (void*)1, SCHEDULER_WRITES( uint32_t ) } );
+            scheduler_add_system( sched, &(SchedulerSystemDesc){ .name = "read float", .run = test_log_system, .context = (void*)2, SCHEDULER_READS( float ), .main_thread = true } );
+            scheduler_add_system( sched, &(SchedulerSystemDesc){ .name = "exclusive", .run = test_log_system, .context = (void*)3, .exclusive = true } );
+
+            for( int frame = 0; frame < 10; ++frame )
+            {
+                s_test_log.count = 0;
+                scheduler_run( sched, ecs );
+
+                TEST_ASSERT( s_test_log.count == 4 );
+                TEST_ASSERT( test_log_position( 0 ) < test_log_position( 2 ) );
+                TEST_ASSERT( test_log_position( 3 ) == 3 );
+            }
+
+            size_t entry_count;
+            const SchedulerTraceEntry *trace = scheduler_get_trace( sched, &entry_count );
+
+            TEST_ASSERT( entry_count == 4 );
+            TEST_ASSERT( trace[2].thread == 0 );
+            TEST_ASSERT( trace[3].on_critical_path );
+            TEST_ASSERT( trace[0].end_ns <= trace[2].start_ns );
+            TEST_ASSERT( trace[2].end_ns <= trace[3].start_ns );
+
+            size_t entity_count;
+            free( ecs_find_all_entities_alloc( ecs, &entity_count ) );
+            TEST_ASSERT( entity_count == 40 );
+
+            scheduler_delete( sched );
+            ecs_delete( ecs );
+        }
+
+        SDL_DestroyMutex( s_test_log.mutex );
+
+    TEST_END();
+
+    return 0;
+}
+
+#endif
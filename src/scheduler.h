@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "containers/ecs.h"
+
+typedef struct Scheduler Scheduler;
+
+// Systems which are not exclusive must record structural changes in to the command buffer they are given. Each
+// thread has its own buffer, and all of them are played back once every system in the frame has finished.
+typedef void (*SchedulerSystemFn)( ECS *ecs, ECSCommandBuffer *commands, void *context );
+
+// Describes a system and the state it touches. Two systems conflict when either one writes a component type
+// the other reads or writes, or when they share a resource. Conflicting systems run in the order they were
+// added, and everything else may run concurrently on the worker pool.
+typedef struct SchedulerSystemDesc
+{
+    const char *name;
+    SchedulerSystemFn run;
+    void *context;
+
+    size_t read_count;
+    const ECSComponentID *reads;
+    size_t write_count;
+    const ECSComponentID *writes;
+    size_t resource_count;
+    const void *const *resources; // state outside the ECS that the system uses exclusively, e.g. a HashCache
+
+    bool main_thread; // for systems which touch the window, GL, or imgui
+    bool exclusive;   // for systems which create or destroy entities, add or remove components, or touch anything
+}
+SchedulerSystemDesc;
+
+typedef struct SchedulerTraceEntry
+{
+    const char *name;
+    uint64_t start_ns; // relative to the start of the frame
+    uint64_t end_ns;
+    int thread; // 0 is the main thread
+    bool on_critical_path;
+}
+SchedulerTraceEntry;
+
+// With zero workers every system runs on the calling thread, in the order the systems were added.
+extern Scheduler *scheduler_new( int worker_count );
+extern void scheduler_add_system( Scheduler *sched, const SchedulerSystemDesc *desc );
+extern void scheduler_run( Scheduler *sched, ECS *ecs );
+extern void scheduler_delete( Scheduler *sched );
+
+// Timings of the most recent scheduler_run, one entry per system in the order they were added. The critical
+// path is the chain of dependent systems which determined how long the frame took.
+extern const SchedulerTraceEntry *scheduler_get_trace( const Scheduler *sched, size_t *entry_count );
+extern void scheduler_print_trace( const Scheduler *sched );
+
+// For use inside a SchedulerSystemDesc initializer, e.g. { .name = "transform", SCHEDULER_WRITES( Transform ) }
+#define SCHEDULER_READS( ... ) \
+    .read_count = ECS_COUNT_ARGS( __VA_ARGS__ ), .reads = (const ECSComponentID[]){ ECS_COMPONENT_IDS( __VA_ARGS__ ) }
+
+#define SCHEDULER_WRITES( ... ) \
+    .write_count = ECS_COUNT_ARGS( __VA_ARGS__ ), .writes = (const ECSComponentID[]){ ECS_COMPONENT_IDS( __VA_ARGS__ ) }
+
+#ifdef RUN_TESTS
+#include "testing.h"
+extern TestResult scheduler_test( void );
+#endif
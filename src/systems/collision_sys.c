@@ -1,6 +1,7 @@
 #include "collision_sys.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <cglm/cglm.h>
 
 #include "../resources/mesh.h"
@@ -11,81 +12,72 @@
 typedef struct CachedCollider
 {
     Entity entity;
-    Hash transform_hash;
-    Hash collider_hash;
+    Hash source_hash; // of the mesh path and world matrix the triangles were built from, 0 before the first build
     Vec triangles; // of Triangle
 }
 CachedCollider;
 
+VEC_DECLARE( Triangle )
+VEC_DECLARE( CachedCollider )
+
 struct CollisionSystem
 {
     Vec cached_colliders; // of CachedCollider
+    ECSTick last_run_tick;
 };
 
 CollisionSystem *collision_sys_new( void )
 {
     CollisionSystem *result = malloc( sizeof( CollisionSystem ) );
     result->cached_colliders = vec_empty( sizeof( CachedCollider ) );
+    result->last_run_tick = 0;
     return result;
 }
 
-static CachedCollider *find_or_add_cached( Vec *cached_colliders, Entity entity, const Transform *transform, const MeshCollider *collider, bool *stale )
+static CachedCollider *find_or_add_cached( Vec *cached_colliders, Entity entity )
 {
-    CachedCollider *cached = NULL;
-    int i;
-    for( i = 0; i < cached_colliders->item_count; ++i )
-    {
-        cached = vec_at( cached_colliders, i );
-        if( cached->entity == entity ) break;
-    }
-    if( i == cached_colliders->item_count ) cached = NULL;
-
-    Hash transform_hash = utils_hash( transform, sizeof( Transform ) );
-    Hash collider_hash = utils_hash( collider, sizeof( MeshCollider ) );
-
-    if( !cached )
+    for( int i = 0; i < cached_colliders->item_count; ++i )
     {
-        CachedCollider new;
-        new.transform_hash = transform_hash;
-        new.collider_hash = collider_hash;
-        new.entity = entity;
-        new.triangles = vec_empty( sizeof( Triangle ) );
-        *stale = true;
-        return vec_push_copy( cached_colliders, &new );
+        CachedCollider *cached = vec_CachedCollider_at( cached_colliders, i );
+        if( cached->entity == entity ) return cached;
     }
 
-    *stale = cached->collider_hash != collider_hash || cached->transform_hash != transform_hash;
-    cached->collider_hash = collider_hash;
-    cached->transform_hash = transform_hash;
-
-    if( *stale ) vec_clear( &cached->triangles );
-
-    return cached;
+    CachedCollider new;
+    new.entity = entity;
+    new.source_hash = 0;
+    new.triangles = vec_Triangle_empty();
+    return vec_CachedCollider_push( cached_colliders, new );
 }
 
 void collision_sys_run( CollisionSystem *sys, ECS *ecs, HashCache *resources )
 {
-    size_t collider_count;
-    Entity *collider_entities = ECS_FIND_ALL_ENTITIES_WITH_COMPONENT_ALLOC( MeshCollider, ecs, &collider_count );
-
-    for( int i = 0; i < collider_count; ++i )
+    ECS_EACH_CHANGED_SINCE( colliders, ecs, sys->last_run_tick, MeshCollider, Transform )
     {
-        ECS_VIEW_COMPONENT_DECL( MeshCollider, collider, ecs, collider_entities[i] );
-        ECS_VIEW_COMPONENT_DECL( Transform, transform, ecs, collider_entities[i] );
+        const MeshCollider *collider = colliders.components[0];
 
-        bool cache_stale;
-        CachedCollider *cached = find_or_add_cached( &sys->cached_colliders, collider_entities[i], transform, collider, &cache_stale );
-        if( !cache_stale ) continue;
-
-        Mesh *mesh = hashcache_load( resources, collider->mesh );
-        if( !mesh ) continue;
+        CachedCollider *cached = find_or_add_cached( &sys->cached_colliders, colliders.entity );
 
         mat4 world_matrix;
-     // if( transform )
-     //     glm_mat4_copy( UTILS_UNCONST_MAT( transform->world_matrix ), world_matrix );
+     // if( transform.page ) // with ECSSoaRef transform = ECS_QUERY_SOA_REF( colliders, 1 )
+     //     glm_mat4_copy( Transform_world_matrix( transform ), world_matrix );
      // else
             glm_mat4_identity( world_matrix );
 
+        // A change to some other field of either component leaves the triangles as they were.
+        UtilsHashStream source;
+        utils_hash_stream_begin( &source, 0 );
+        if( collider->mesh ) utils_hash_stream_add( &source, collider->mesh, strlen( collider->mesh ) + 1 );
+        utils_hash_stream_add( &source, world_matrix, sizeof( world_matrix ) );
+        Hash source_hash = utils_hash_stream_end( &source );
+
+        if( source_hash == cached->source_hash ) continue;
+
+        cached->source_hash = source_hash;
+        vec_clear( &cached->triangles );
+
+        Mesh *mesh = hashcache_load( resources, collider->mesh );
+        if( !mesh ) continue;
+
         for( int j = 0; j < mesh->num_submeshes; ++j )
         for( int k = 0; k < mesh->submeshes[j].num_indices; k += 3 )
         {
@@ -95,11 +87,11 @@ void collision_sys_run( CollisionSystem *sys, ECS *ecs, HashCache *resources )
             glm_mat4_mulv3( world_matrix, mesh->vertices[mesh->submeshes[j].indices[k + 1]], 1.f, t.b );
             glm_mat4_mulv3( world_matrix, mesh->vertices[mesh->submeshes[j].indices[k + 2]], 1.f, t.c );
 
-            vec_push_copy( &cached->triangles, &t );
+            vec_Triangle_push( &cached->triangles, t );
         }
     }
 
-    free( collider_entities );
+    sys->last_run_tick = ecs_get_change_tick();
 
     ECS_ENSURE_AND_BORROW_SINGLETON_DECL( WorldCollisionInfo, ecs, info );
     info->info = &sys->cached_colliders;
@@ -128,11 +120,11 @@ bool world_collision_info_raycast( const WorldCollisionInfo *info, const vec3 or
 
     for( int i = 0; i < cached_colliders->item_count; ++i )
     {
-        const CachedCollider *collider = vec_at_const( cached_colliders, i );
+        const CachedCollider *collider = vec_CachedCollider_at_const( cached_colliders, i );
 
         for( int j = 0; j < collider->triangles.item_count; ++j )
         {
-            const Triangle *t = vec_at_const( &collider->triangles, j );
+            const Triangle *t = vec_Triangle_at_const( &collider->triangles, j );
 
             if( geometry_line_seg_intersects_triangle( origin, end_pt, t->a, t->b, t->c, out_intersection ) )
                 return true;
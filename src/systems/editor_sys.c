@@ -41,14 +41,16 @@ EditorSystem *editor_sys_new( void )
     return sys;
 }
 
-static void inspect_transform_tree( EditorSystem *sys, ECS *ecs, Entity entity, Transform *transform )
+static void inspect_transform_tree( EditorSystem *sys, ECS *ecs, Entity entity )
 {
     ImGuiTreeNodeFlags node_flags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_OpenOnDoubleClick;
 
     if( sys->selected_entity == entity )
         node_flags |= ImGuiTreeNodeFlags_Selected;
 
-    if( !transform || transform->children.item_count == 0 )
+    ECS_VIEW_COMPONENT_DECL( TransformCold, cold, ecs, entity );
+
+    if( !cold || cold->children.vec.item_count == 0 )
         node_flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
 
     bool name_from_transform;
@@ -62,21 +64,23 @@ static void inspect_transform_tree( EditorSystem *sys, ECS *ecs, Entity entity,
     if( igIsItemClicked( 0 ) )
         sys->selected_entity = entity;
 
-    if( transform && transform->children.item_count > 0 && node_open )
+    if( cold && cold->children.vec.item_count > 0 && node_open )
     {
-        for( int i = 0; i < transform->children.item_count; ++i )
+        for( int i = 0; i < cold->children.vec.item_count; ++i )
         {
-            Entity *e = vec_at( &transform->children, i );
-            ECS_BORROW_COMPONENT_DECL( Transform, t, ecs, *e );
-            inspect_transform_tree( sys, ecs, *e, t );
+            const Entity *e = small_vec_at_const( &cold->children.vec, i );
+            inspect_transform_tree( sys, ecs, *e );
         }
 
         igTreePop();
     }
 }
 
-static void update_view_drag( EditorSystem *sys, const InputState *inputs, Camera *cam, Transform *transform, float delta_secs )
+static void update_view_drag( EditorSystem *sys, const InputState *inputs, Camera *cam, ECSSoaRef transform, float delta_secs )
 {
+    float *position = Transform_position( transform );
+    float *rotation = Transform_rotation( transform );
+
 // Camera rotation
 
     if( inputs->cur.right_mouse )
@@ -86,21 +90,21 @@ static void update_view_drag( EditorSystem *sys, const InputState *inputs, Camer
 
         versor yaw;
         glm_quatv( yaw, dx, (vec3){ 0, 1, 0 });
-        glm_quat_mul( yaw, transform->rotation, transform->rotation );
+        glm_quat_mul( yaw, rotation, rotation );
 
         vec3 pitch_axis;
         versor pitch;
-        glm_quat_rotatev( transform->rotation, (vec3){ 1, 0, 0 }, pitch_axis );
+        glm_quat_rotatev( rotation, (vec3){ 1, 0, 0 }, pitch_axis );
         glm_quatv( pitch, -dy, pitch_axis );
-        glm_quat_mul( pitch, transform->rotation, transform->rotation );
+        glm_quat_mul( pitch, rotation, rotation );
     }
 
 // Camera movement
 
     vec3 fwd, up, right, drive;
-    glm_quat_rotatev( transform->rotation, (vec3){ 0.f, 0.f, 1.f }, fwd );
-    glm_quat_rotatev( transform->rotation, (vec3){ 0.f, 1.f, 0.f }, up );
-    glm_quat_rotatev( transform->rotation, (vec3){ 1.f, 0.f, 0.f }, right );
+    glm_quat_rotatev( rotation, (vec3){ 0.f, 0.f, 1.f }, fwd );
+    glm_quat_rotatev( rotation, (vec3){ 0.f, 1.f, 0.f }, up );
+    glm_quat_rotatev( rotation, (vec3){ 1.f, 0.f, 0.f }, right );
     glm_vec_zero( drive );
 
     #define X(pos_key, neg_key, pos_vec) do { \
@@ -122,64 +126,55 @@ static void update_view_drag( EditorSystem *sys, const InputState *inputs, Camer
     #undef X
 
     glm_vec_scale( drive, 20.f * delta_secs, drive );
-    glm_vec_add( transform->position, drive, transform->position );
+    glm_vec_add( position, drive, position );
 }
 
 static void reparent_entity( ECS *ecs, Entity this_entity, Entity to_entity )
 {
     if( !this_entity || this_entity == to_entity ) return;
 
-    ECS_BORROW_COMPONENT_DECL( Transform, this_t, ecs, this_entity );
-    if( !this_t ) return;
+    ECS_BORROW_SOA_COMPONENT_DECL( Transform, this_t, ecs, this_entity );
+    if( !this_t.page ) return;
 
     if( !to_entity )
     {
-        this_t->parent = 0;
+        Transform_parent( this_t ) = 0;
         goto end;
     }
 
-    ECS_VIEW_COMPONENT_DECL( Transform, to_t, ecs, to_entity );
-    if( !to_t ) goto end;
+    ECS_VIEW_SOA_COMPONENT_DECL( Transform, to_t, ecs, to_entity );
+    if( !to_t.page ) goto end;
 
-    Entity parent = to_t->parent;
+    Entity parent = Transform_parent( to_t );
     while( parent )
     {
         if( parent == this_entity ) goto end;
-        ECS_VIEW_COMPONENT_DECL( Transform, parent_t, ecs, parent );
-        parent = parent_t->parent;
+        ECS_VIEW_SOA_COMPONENT_DECL( Transform, parent_t, ecs, parent );
+        parent = parent_t.page ? Transform_parent( parent_t ) : 0;
     }
 
-    this_t->parent = to_entity;
+    Transform_parent( this_t ) = to_entity;
 
 end:
-    ECS_RETURN_COMPONENT( ecs, this_t );
+    ECS_RETURN_SOA_COMPONENT( ecs, this_t );
 }
 
-static bool find_editor_camera( ECS *ecs, Camera **out_camera, Transform **out_transform )
+static bool find_editor_camera( ECS *ecs, Camera **out_camera, ECSSoaRef *out_transform )
 {
-    bool result = false;
-    size_t num_cameras;
-    Entity *camera_entities = ECS_FIND_ALL_ENTITIES_WITH_COMPONENT_ALLOC( Camera, ecs, &num_cameras );
-
-    if( num_cameras == 0 ) goto exit;
-
-    for( int i = 0; i < num_cameras; ++i )
+    ECS_EACH( cameras, ecs, Camera )
     {
-        ECS_BORROW_COMPONENT_DECL( Camera, camera, ecs, camera_entities[i] );
-        ECS_BORROW_COMPONENT_DECL( Transform, transform, ecs, camera_entities[i] );
+        const Camera *camera = cameras.components[0];
+        if( !camera->is_editor ) continue;
 
-        if( transform && camera->is_editor )
-        {
-            *out_camera = camera;
-            *out_transform = transform;
-            result = true;
-            break;
-        }
+        ECS_BORROW_SOA_COMPONENT_DECL( Transform, transform, ecs, cameras.entity );
+        if( !transform.page ) continue;
+
+        *out_camera = ecs_borrow_component( ecs, cameras.entity, Camera_id, __FILE__, __LINE__ );
+        *out_transform = transform;
+        return true;
     }
 
-exit:
-    free( camera_entities );
-    return result;
+    return false;
 }
 
 
@@ -238,10 +233,8 @@ EditorSystemUpdateResult editor_sys_run( EditorSystem *sys, ECS *ecs )
             {
                 if( igMenuItemBool( "Play", NULL, false, true ) )
                 {
-                    char *json_scene = components_serialize_scene_alloc( ecs );
-                    sys->pre_play_ecs = components_deserialize_scene_alloc( json_scene );
+                    sys->pre_play_ecs = components_clone_ecs( ecs );
                     sys->game_view = true;
-                    free( json_scene );
                 }
             }
 
@@ -261,12 +254,7 @@ EditorSystemUpdateResult editor_sys_run( EditorSystem *sys, ECS *ecs )
 
     igEndMainMenuBar();
 
-    Entity clock_entity;
-    ECS_FIND_FIRST_ENTITY_WITH_COMPONENT( ClockInfo, ecs, &clock_entity );
-    ECS_BORROW_COMPONENT_DECL( ClockInfo, clock, ecs, clock_entity );
-    size_t num_entities;
-    Entity *entities = ecs_find_all_entities_alloc( ecs, &num_entities );
-
+    ECS_BORROW_SINGLETON_DECL( ClockInfo, ecs, clock );
     if( sys->fps_open )
     {
         if( sys->fps_reset )
@@ -296,7 +284,10 @@ EditorSystemUpdateResult editor_sys_run( EditorSystem *sys, ECS *ecs )
         igBegin( "Hierarchy", &sys->hierarchy_open, 0 );
 
         if( igButton( "Create", (ImVec2){ 0, 0 } ) )
-            ECS_ADD_COMPONENT_DEFAULT( Transform, ecs, ecs_create_entity( ecs ) );
+        {
+            Entity created = ecs_create_entity( ecs );
+            ECS_ADD_COMPONENTS( Transform, ecs, 1, &created, &Transform_default );
+        }
 
         igSameLine( 0, -1 );
 
@@ -339,14 +330,13 @@ EditorSystemUpdateResult editor_sys_run( EditorSystem *sys, ECS *ecs )
 
         igSeparator();
 
-        for( int i = 0; i < num_entities; ++i )
+        ECS_EACH_ENTITY( entities, ecs )
         {
-            ECS_BORROW_COMPONENT_DECL( Transform, t, ecs, entities[i] );
-
-            if( !t || t && !t->parent )
-                inspect_transform_tree( sys, ecs, entities[i], t );
+            ECS_VIEW_SOA_COMPONENT_DECL( Transform, t, ecs, entities.entity );
 
-            ECS_RETURN_COMPONENT( ecs, t );
+            // Children of a destroyed parent show at the root until the transform system clears their parent.
+            if( !t.page || !Transform_parent( t ) || !ecs_has_component( ecs, Transform_parent( t ), Transform_id ) )
+                inspect_transform_tree( sys, ecs, entities.entity );
         }
 
         igEnd();
@@ -361,23 +351,19 @@ EditorSystemUpdateResult editor_sys_run( EditorSystem *sys, ECS *ecs )
         if( !keep_open ) sys->selected_entity = 0;
     }
 
-    free( entities );
-
     if( !sys->game_view )
     {
         Camera *camera;
-        Transform *camera_transform;
+        ECSSoaRef camera_transform;
 
         if( find_editor_camera( ecs, &camera, &camera_transform ) )
         {
-            Entity inputs_entity;
-            ECS_FIND_FIRST_ENTITY_WITH_COMPONENT( InputState, ecs, &inputs_entity );
-            ECS_VIEW_COMPONENT_DECL( InputState, inputs, ecs, inputs_entity );
+            ECS_VIEW_SINGLETON_DECL( InputState, ecs, inputs );
             if( inputs )
                 update_view_drag( sys, inputs, camera, camera_transform, clock->delta_secs );
 
             ECS_RETURN_COMPONENT( ecs, camera );
-            ECS_RETURN_COMPONENT( ecs, camera_transform );
+            ECS_RETURN_SOA_COMPONENT( ecs, camera_transform );
         }
     }
 
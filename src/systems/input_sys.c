@@ -1,7 +1,7 @@
 #include "input_sys.h"
 
 #include "../component_defs.h"
-#include "../containers/vec.h"
+#include "../containers/small_vec.h"
 
 static InputFrame s_latest_inputs;
 
@@ -34,23 +34,21 @@ static void shell_event_callback( float window_width, float window_height, SDL_E
         break;
 
     case SDL_KEYDOWN:
-        if( vec_find_index( &s_latest_inputs.keys, &event->key.keysym.sym, compare_sdl_key_codes ) < 0 )
-            vec_push_copy( &s_latest_inputs.keys, &event->key.keysym.sym );
+        if( small_vec_find_index( &s_latest_inputs.keys.vec, &event->key.keysym.sym, compare_sdl_key_codes ) < 0 )
+            small_vec_push_copy( &s_latest_inputs.keys.vec, &event->key.keysym.sym );
         break;
 
     case SDL_KEYUP: {}
-        int index = vec_find_index( &s_latest_inputs.keys, &event->key.keysym.sym, compare_sdl_key_codes );
+        int index = small_vec_find_index( &s_latest_inputs.keys.vec, &event->key.keysym.sym, compare_sdl_key_codes );
         if( index >= 0 )
-            vec_remove( &s_latest_inputs.keys, index );
+            small_vec_remove( &s_latest_inputs.keys.vec, index );
         break;
     }
 }
 
 InputSystem *input_sys_new( ShellContext *shell )
 {
-    s_latest_inputs.keys = vec_empty( sizeof( SDL_Keycode ) );
-    s_latest_inputs.has_gamepad = false;
-    s_latest_inputs.gamepad.buttons = vec_empty( sizeof( SDL_GameControllerButton ) );
+    s_latest_inputs = InputFrame_default;
 
     shell_bind_event_handler( shell, shell_event_callback );
 
@@ -64,11 +62,11 @@ static float read_axis( int16_t val )
 
 static void read_gamepad( SDL_GameController *controller, GamepadInputFrame *result )
 {
-    vec_clear( &result->buttons );
+    small_vec_clear( &result->buttons.vec );
 
     for( int i = 0; i < SDL_CONTROLLER_BUTTON_MAX; ++i )
         if( SDL_GameControllerGetButton( controller, i ) )
-            vec_push_copy( &result->buttons, &i );
+            small_vec_push_copy( &result->buttons.vec, &i );
 
     result-> left_stick[0] = read_axis( SDL_GameControllerGetAxis( controller, SDL_CONTROLLER_AXIS_LEFTX ) );
     result-> left_stick[1] = read_axis( SDL_GameControllerGetAxis( controller, SDL_CONTROLLER_AXIS_LEFTY ) );
@@ -90,13 +88,14 @@ void input_sys_run( InputSystem *sys, ECS *ecs, SDL_GameController *controller )
 
     ECS_ENSURE_AND_BORROW_SINGLETON_DECL( InputState, ecs, inputs );
 
-    vec_clear( &inputs->prev.keys );
-    vec_clear( &inputs->prev.gamepad.buttons );
+    // Few enough keys and buttons are held at once that they fit inline, so these copies rarely allocate.
+    small_vec_clear( &inputs->prev.keys.vec );
+    small_vec_clear( &inputs->prev.gamepad.buttons.vec );
     inputs->prev = inputs->cur;
     
     inputs->cur = s_latest_inputs;
-    inputs->cur.keys = vec_clone( &s_latest_inputs.keys );
-    inputs->cur.gamepad.buttons = vec_clone( &s_latest_inputs.gamepad.buttons );
+    small_vec_deep_copy( &inputs->cur.keys.vec );
+    small_vec_deep_copy( &inputs->cur.gamepad.buttons.vec );
 
     ECS_RETURN_COMPONENT( ecs, inputs );
 }
@@ -112,5 +111,5 @@ static bool find_sdl_key_index( const SDL_Keycode *a, const SDL_Keycode *b )
 
 bool input_state_is_key_down( const InputState *inputs, SDL_Keycode key )
 {
-    return vec_find_index( &inputs->cur.keys, &key, find_sdl_key_index ) >= 0;
+    return small_vec_find_index( &inputs->cur.keys.vec, &key, find_sdl_key_index ) >= 0;
 }
@@ -52,6 +52,12 @@ static void load_vao( MeshVAO *vao, Mesh *mesh )
 
     vao->wireframe_lines = vec_empty( sizeof( uint16_t ) );
 
+    size_t line_index_count = 0;
+    for( int i = 0; i < mesh->num_submeshes; ++i )
+        line_index_count += mesh->submeshes[i].num_indices / 3 * 6;
+
+    vec_reserve( &vao->wireframe_lines, line_index_count );
+
     for( int i = 0; i < mesh->num_submeshes; ++i )
     for( int j = 0; j < mesh->submeshes[i].num_indices - 2; j += 3 )
     {
@@ -59,12 +65,8 @@ static void load_vao( MeshVAO *vao, Mesh *mesh )
         uint16_t b = mesh->submeshes[i].indices[j+1];
         uint16_t c = mesh->submeshes[i].indices[j+2];
 
-        vec_push_copy( &vao->wireframe_lines, &a );
-        vec_push_copy( &vao->wireframe_lines, &b );
-        vec_push_copy( &vao->wireframe_lines, &b );
-        vec_push_copy( &vao->wireframe_lines, &c );
-        vec_push_copy( &vao->wireframe_lines, &c );
-        vec_push_copy( &vao->wireframe_lines, &a );
+        uint16_t lines[] = { a, b, b, c, c, a };
+        vec_push_many( &vao->wireframe_lines, 6, lines );
     }
 }
 
@@ -105,7 +107,7 @@ RenderSystem *render_sys_new( HashCache *resources )
     return sys;
 }
 
-static void draw_camera( RenderSystem *sys, ECS *ecs, HashCache *resources, float aspect_ratio, const Transform *camera_transform, const Camera *camera, bool show_editor_layer )
+static void draw_camera( RenderSystem *sys, ECS *ecs, HashCache *resources, float aspect_ratio, ECSSoaRef camera_transform, const Camera *camera, bool show_editor_layer )
 {
     mat4 projection;
     glm_perspective( camera->fov, aspect_ratio, camera->near_clip, camera->far_clip, projection );
@@ -113,15 +115,12 @@ static void draw_camera( RenderSystem *sys, ECS *ecs, HashCache *resources, floa
     projection[2][3] *= -1.f;
 
     mat4 view;
-    glm_mat4_inv( UTILS_UNCONST_MAT( camera_transform->world_matrix ), view );
+    glm_mat4_inv( Transform_world_matrix( camera_transform ), view );
 
-    size_t num_renderers;
-    Entity *renderers = ECS_FIND_ALL_ENTITIES_WITH_COMPONENT_ALLOC( MeshRenderer, ecs, &num_renderers );
-
-    for( int i = 0; i < num_renderers; ++i )
+    ECS_EACH( renderers, ecs, MeshRenderer, Transform )
     {
-        ECS_VIEW_COMPONENT_DECL( Transform, renderer_transform, ecs, renderers[i] );
-        ECS_VIEW_COMPONENT_DECL( MeshRenderer, renderer_comp, ecs, renderers[i] );
+        const MeshRenderer *renderer_comp = renderers.components[0];
+        ECSSoaRef renderer_transform = ECS_QUERY_SOA_REF( renderers, 1 );
 
         MeshVAO *vao = get_vao( &sys->vaos_for_meshes, resources, renderer_comp->mesh );
         Mesh *mesh = hashcache_load( resources, renderer_comp->mesh );
@@ -163,7 +162,7 @@ static void draw_camera( RenderSystem *sys, ECS *ecs, HashCache *resources, floa
 
             glUniformMatrix4fv( glGetUniformLocation( shader_handle, "view" ), 1, GL_FALSE, (GLfloat*)view );
             glUniformMatrix4fv( glGetUniformLocation( shader_handle, "projection" ), 1, GL_FALSE, (GLfloat*)projection );
-            glUniformMatrix4fv( glGetUniformLocation( shader_handle, "model" ), 1, GL_FALSE, (GLfloat*)renderer_transform->world_matrix );
+            glUniformMatrix4fv( glGetUniformLocation( shader_handle, "model" ), 1, GL_FALSE, (GLfloat*)Transform_world_matrix( renderer_transform ) );
 
             if( props )
             {
@@ -179,21 +178,16 @@ static void draw_camera( RenderSystem *sys, ECS *ecs, HashCache *resources, floa
         }
     }
 
-    free( renderers );
-
     if( !show_editor_layer ) return;
 
-    size_t num_colliders;
-    Entity *colliders = ECS_FIND_ALL_ENTITIES_WITH_COMPONENT_ALLOC( MeshCollider, ecs, &num_colliders );
-
     Shader *wire_shader = hashcache_load( resources, "shaders/wireframe.glsl" );
     GLuint wire_shader_handle = shader_get_handle( wire_shader );
     shader_use( wire_shader );
 
-    for( int i = 0; i < num_colliders; ++i )
+    ECS_EACH( colliders, ecs, MeshCollider, Transform )
     {
-        ECS_VIEW_COMPONENT_DECL( Transform, collider_transform, ecs, colliders[i] );
-        ECS_VIEW_COMPONENT_DECL( MeshCollider, collider, ecs, colliders[i] );
+        const MeshCollider *collider = colliders.components[0];
+        ECSSoaRef collider_transform = ECS_QUERY_SOA_REF( colliders, 1 );
 
         MeshVAO *vao = get_vao( &sys->vaos_for_meshes, resources, collider->mesh );
 
@@ -204,12 +198,10 @@ static void draw_camera( RenderSystem *sys, ECS *ecs, HashCache *resources, floa
         glUniform3f( glGetUniformLocation( wire_shader_handle, "line_color" ), 1.f, 1.f, 1.f );
         glUniformMatrix4fv( glGetUniformLocation( wire_shader_handle, "view" ), 1, GL_FALSE, (GLfloat*)view );
         glUniformMatrix4fv( glGetUniformLocation( wire_shader_handle, "projection" ), 1, GL_FALSE, (GLfloat*)projection );
-        glUniformMatrix4fv( glGetUniformLocation( wire_shader_handle, "model" ), 1, GL_FALSE, (GLfloat*)collider_transform->world_matrix );
+        glUniformMatrix4fv( glGetUniformLocation( wire_shader_handle, "model" ), 1, GL_FALSE, (GLfloat*)Transform_world_matrix( collider_transform ) );
 
         glDrawElements( GL_LINES, (GLsizei)vao->wireframe_lines.item_count, GL_UNSIGNED_SHORT, vao->wireframe_lines.data );
     }
-
-    free( colliders );
 }
 
 void render_sys_run( RenderSystem *sys, ECS *ecs, HashCache *resources, float aspect_ratio, bool game_view )
@@ -217,24 +209,14 @@ void render_sys_run( RenderSystem *sys, ECS *ecs, HashCache *resources, float as
     glDepthMask( GL_TRUE );
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
-    size_t num_cameras;
-    Entity *camera_entities = ECS_FIND_ALL_ENTITIES_WITH_COMPONENT_ALLOC( Camera, ecs, &num_cameras );
-
-    if( num_cameras == 0 ) goto exit;
-
-    for( int i = 0; i < num_cameras; ++i )
+    ECS_EACH( cameras, ecs, Camera, Transform )
     {
-        ECS_VIEW_COMPONENT_DECL( Camera, camera, ecs, camera_entities[i] );
-        ECS_VIEW_COMPONENT_DECL( Transform, camera_transform, ecs, camera_entities[i] );
-
-        if( !camera_transform ) continue;
+        const Camera *camera = cameras.components[0];
+        ECSSoaRef camera_transform = ECS_QUERY_SOA_REF( cameras, 1 );
 
         if( camera->is_editor != game_view )
             draw_camera( sys, ecs, resources, aspect_ratio, camera_transform, camera, !game_view );
     }
-
-exit:
-    free( camera_entities );
 }
 
 static void clear_vaos_callback( void *ctx, MeshVAO *vao )
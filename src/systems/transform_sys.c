@@ -13,62 +13,69 @@ TransformSystem *transform_sys_new(void)
     return NULL;
 }
 
-static void Transform_to_matrix(Transform *transform, mat4 matrix)
+static void Transform_to_matrix(ECSSoaRef transform, mat4 matrix)
 {
     glm_mat4_identity(matrix);
 
-    glm_translate(matrix, transform->position);
+    glm_translate(matrix, Transform_position(transform));
 
     mat4 rotation;
-    glm_quat_mat4(transform->rotation, rotation);
+    glm_quat_mat4(Transform_rotation(transform), rotation);
     glm_mat4_mul(matrix, rotation, matrix);
 
-    glm_scale(matrix, transform->scale);
+    glm_scale(matrix, Transform_scale(transform));
 }
 
 void transform_sys_run(TransformSystem *sys, ECS *ecs)
 {
-    size_t num_transforms;
-    Entity *transform_entities = ECS_FIND_ALL_ENTITIES_WITH_COMPONENT_ALLOC(Transform, ecs, &num_transforms);
+    ECS_EACH(transforms, ecs, Transform)
+    {
+        ECSSoaRef t = ECS_QUERY_SOA_REF(transforms, 0);
+        Transform_to_matrix(t, Transform_world_matrix(t));
+    }
 
-    for (int i = 0; i < num_transforms; ++i)
+    ECS_EACH(colds, ecs, TransformCold)
     {
-        ECS_BORROW_COMPONENT_DECL(Transform, t, ecs, transform_entities[i]);
-        Transform_to_matrix(t, t->world_matrix);
-        vec_clear(&t->children);
-        ECS_RETURN_COMPONENT(ecs, t);
+        TransformCold *c = colds.components[0];
+        small_vec_clear(&c->children.vec);
     }
 
-    for (int i = 0; i < num_transforms; ++i)
+    ECS_EACH(transforms, ecs, Transform)
     {
-        ECS_BORROW_COMPONENT_DECL(Transform, t, ecs, transform_entities[i]);
-        Entity parent = t->parent;
+        ECSSoaRef t = ECS_QUERY_SOA_REF(transforms, 0);
+        Entity parent = Transform_parent(t);
+
+        // A destroyed parent takes its Transform with it, which leaves the child at the root. Cleared through a
+        // borrow so that the change is stamped for change filtered queries.
+        if (parent && !ecs_has_component(ecs, parent, Transform_id))
+        {
+            ECS_BORROW_SOA_COMPONENT_DECL(Transform, orphan, ecs, transforms.entity);
+            parent = Transform_parent(orphan) = 0;
+            ECS_RETURN_SOA_COMPONENT(ecs, orphan);
+        }
 
         if (parent)
         {
-            ECS_BORROW_COMPONENT_DECL(Transform, p, ecs, parent);
-            vec_push_copy(&p->children, &transform_entities[i]);
+            ECS_BORROW_COMPONENT_DECL(TransformCold, p, ecs, parent);
+            small_vec_push_copy(&p->children.vec, &transforms.entity);
             ECS_RETURN_COMPONENT(ecs, p);
         }
 
         while (parent)
         {
-            ECS_BORROW_COMPONENT_DECL(Transform, p, ecs, parent);
+            ECS_BORROW_SOA_COMPONENT_DECL(Transform, p, ecs, parent);
 
             mat4 parent_matrix;
             Transform_to_matrix(p, parent_matrix);
 
-            glm_mat4_mul(parent_matrix, t->world_matrix, t->world_matrix);
+            glm_mat4_mul(parent_matrix, Transform_world_matrix(t), Transform_world_matrix(t));
 
-            parent = p->parent;
+            parent = Transform_parent(p);
+            if (parent && !ecs_has_component(ecs, parent, Transform_id)) parent = 0;
 
-            ECS_RETURN_COMPONENT(ecs, p);
+            ECS_RETURN_SOA_COMPONENT(ecs, p);
         }
-
-        ECS_RETURN_COMPONENT(ecs, t);
     }
-
-    free(transform_entities);
 }
 
 void transform_sys_delete(TransformSystem *sys)
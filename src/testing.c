@@ -4,18 +4,28 @@
 #include <ns_clock.h>
 
 #include "containers/vec.h"
+#include "containers/small_vec.h"
 #include "containers/hashtable.h"
 #include "containers/ecs.h"
 #include "containers/hashcache.h"
+#include "scheduler.h"
+#include "utils.h"
 
 int run_all_tests(void)
 {
     uint64_t start = ns_clock();
 
+    TEST_RUN(utils_test);
     TEST_RUN(vec_test);
+    TEST_RUN(small_vec_test);
     TEST_RUN(hashtable_test);
     TEST_RUN(ecs_test);
     TEST_RUN(hashcache_test);
+    TEST_RUN(scheduler_test);
+
+#ifdef RUN_BENCHMARKS
+    TEST_RUN(utils_hash_benchmark);
+#endif
 
     uint64_t end = ns_clock();
     printf("\nDone! Tests completed in %u us.\n", (uint32_t)((end - start) / 1000));
@@ -6,6 +6,7 @@
 typedef int TestResult;
 
 //#define FAST_TESTS 1
+//#define RUN_BENCHMARKS 1
 #ifdef FAST_TESTS
     #define TEST_PRINT()
 #else
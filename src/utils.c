@@ -47,7 +47,404 @@ void utils_write_string_file( const char *path, const char *contents )
     fclose( f );
 }
 
+// 64 bit hash in two parts. Inputs up to one stripe go straight to a wyhash style tail, a few dependent 128 bit
+// multiplies. Longer inputs first run stripes through eight independent accumulators xxh3 style, each folding in a
+// 32x32 bit product per word, which maps onto SIMD multiplies and keeps the dependency chains short. Both parts
+// read words in native order, so hashes are only stable across little endian machines.
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define UTILS_HASH_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define UTILS_HASH_SSE2
+#endif
+
+#define HASH_P0 0xa0761d6478bd642fULL
+#define HASH_P1 0xe7037ed1a0b428dbULL
+#define HASH_PRIME32 0x9e3779b1U
+
+static const uint64_t HASH_SECRET[UTILS_HASH_SECRET_WORDS] = {
+    0x09f1fd9d03f0a9b4ULL, 0x553274161bbf8475ULL, 0x5d5bca4696b343b3ULL, 0x70d29b6c7d22528dULL,
+    0x0bf2b716f9915475ULL, 0x5eb7f92b95387ccaULL, 0x296cd0f2c21d7f90ULL, 0x1289a69805c125b1ULL,
+    0xdaa27fb8dacb9e73ULL, 0x3ed08d59cb3f4727ULL, 0x58a5f17b6c15c659ULL, 0x651ac042fa7b481aULL,
+    0x22af6aeaa88e8dccULL, 0x2d2bae64640abfb9ULL, 0xad0e83a710231b07ULL, 0x9d30ff2169d91f12ULL,
+    0xf5ff07c9523504ddULL, 0x1273c823ba66eec0ULL, 0x47e1dbe249cb520bULL, 0xbbea42bd69484adcULL,
+    0xc33e61bc6ef9e4c4ULL, 0x752cd583231b5114ULL, 0xe53dc6e1988622e5ULL, 0x928eb721ed361ba3ULL,
+};
+
+static inline uint64_t read_u64( const uint8_t *p )
+{
+    uint64_t result;
+    memcpy( &result, p, sizeof( result ) );
+    return result;
+}
+
+static inline uint64_t read_u32( const uint8_t *p )
+{
+    uint32_t result;
+    memcpy( &result, p, sizeof( result ) );
+    return result;
+}
+
+// Full 64x64 bit product with its halves folded together.
+static inline uint64_t mul_fold( uint64_t a, uint64_t b )
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = (__uint128_t)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    uint64_t hi;
+    uint64_t lo = _umul128( a, b, &hi );
+    return lo ^ hi;
+#else
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32, b_lo = (uint32_t)b, b_hi = b >> 32;
+    uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    uint64_t hi = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    uint64_t lo = (cross << 32) | (uint32_t)lo_lo;
+    return lo ^ hi;
+#endif
+}
+
+static uint64_t hash_mix_seed( uint64_t seed )
+{
+    return seed ^ mul_fold( seed ^ HASH_P0, HASH_P1 );
+}
+
+// Hashes the last 0 to 64 bytes into h, which is the mixed seed or the merged stripe accumulators.
+static Hash hash_tail( const uint8_t *p, size_t size, uint64_t h, uint64_t total_bytes )
+{
+    uint64_t a = 0, b = 0;
+
+    for( ; size > 16; p += 16, size -= 16 )
+        h = mul_fold( read_u64( p ) ^ HASH_P1, read_u64( p + 8 ) ^ h );
+
+    if( size >= 8 )
+    {
+        a = read_u64( p );
+        b = read_u64( p + size - 8 );
+    }
+    else if( size >= 4 )
+    {
+        a = read_u32( p );
+        b = read_u32( p + size - 4 );
+    }
+    else if( size > 0 )
+    {
+        a = ((uint64_t)p[0] << 16) | ((uint64_t)p[size >> 1] << 8) | p[size - 1];
+    }
+
+    return mul_fold( HASH_P1 ^ total_bytes, mul_fold( a ^ HASH_P1, b ^ h ) );
+}
+
+static void accumulate_stripe_scalar( uint64_t acc[8], const uint8_t *p, const uint64_t *secret )
+{
+    for( int i = 0; i < 8; ++i )
+    {
+        uint64_t word = read_u64( p + 8 * i );
+        uint64_t keyed = word ^ secret[i];
+        acc[i ^ 1] += word;
+        acc[i] += (keyed & 0xffffffffULL) * (keyed >> 32);
+    }
+}
+
+static void scramble_scalar( uint64_t acc[8], const uint64_t *secret )
+{
+    for( int i = 0; i < 8; ++i )
+    {
+        acc[i] ^= acc[i] >> 47;
+        acc[i] ^= secret[i];
+        acc[i] *= HASH_PRIME32;
+    }
+}
+
+// The SIMD paths do the same per-lane arithmetic as the scalar ones, so every build produces the same hashes.
+static void accumulate_stripe( uint64_t acc[8], const uint8_t *p, const uint64_t *secret )
+{
+#if defined(UTILS_HASH_AVX2)
+    for( int i = 0; i < 8; i += 4 )
+    {
+        __m256i word = _mm256_loadu_si256( (const __m256i*)(p + 8 * i) );
+        __m256i keyed = _mm256_xor_si256( word, _mm256_loadu_si256( (const __m256i*)(secret + i) ) );
+        __m256i product = _mm256_mul_epu32( keyed, _mm256_srli_epi64( keyed, 32 ) );
+        __m256i swapped = _mm256_shuffle_epi32( word, _MM_SHUFFLE( 1, 0, 3, 2 ) );
+        __m256i sum = _mm256_add_epi64( _mm256_loadu_si256( (const __m256i*)(acc + i) ), _mm256_add_epi64( product, swapped ) );
+        _mm256_storeu_si256( (__m256i*)(acc + i), sum );
+    }
+#elif defined(UTILS_HASH_SSE2)
+    for( int i = 0; i < 8; i += 2 )
+    {
+        __m128i word = _mm_loadu_si128( (const __m128i*)(p + 8 * i) );
+        __m128i keyed = _mm_xor_si128( word, _mm_loadu_si128( (const __m128i*)(secret + i) ) );
+        __m128i product = _mm_mul_epu32( keyed, _mm_srli_epi64( keyed, 32 ) );
+        __m128i swapped = _mm_shuffle_epi32( word, _MM_SHUFFLE( 1, 0, 3, 2 ) );
+        __m128i sum = _mm_add_epi64( _mm_loadu_si128( (const __m128i*)(acc + i) ), _mm_add_epi64( product, swapped ) );
+        _mm_storeu_si128( (__m128i*)(acc + i), sum );
+    }
+#else
+    accumulate_stripe_scalar( acc, p, secret );
+#endif
+}
+
+static void scramble( uint64_t acc[8], const uint64_t *secret )
+{
+#if defined(UTILS_HASH_AVX2)
+    const __m256i prime = _mm256_set1_epi32( (int)HASH_PRIME32 );
+
+    for( int i = 0; i < 8; i += 4 )
+    {
+        __m256i a = _mm256_loadu_si256( (const __m256i*)(acc + i) );
+        a = _mm256_xor_si256( a, _mm256_srli_epi64( a, 47 ) );
+        a = _mm256_xor_si256( a, _mm256_loadu_si256( (const __m256i*)(secret + i) ) );
+        __m256i lo = _mm256_mul_epu32( a, prime );
+        __m256i hi = _mm256_mul_epu32( _mm256_srli_epi64( a, 32 ), prime );
+        _mm256_storeu_si256( (__m256i*)(acc + i), _mm256_add_epi64( lo, _mm256_slli_epi64( hi, 32 ) ) );
+    }
+#elif defined(UTILS_HASH_SSE2)
+    const __m128i prime = _mm_set1_epi32( (int)HASH_PRIME32 );
+
+    for( int i = 0; i < 8; i += 2 )
+    {
+        __m128i a = _mm_loadu_si128( (const __m128i*)(acc + i) );
+        a = _mm_xor_si128( a, _mm_srli_epi64( a, 47 ) );
+        a = _mm_xor_si128( a, _mm_loadu_si128( (const __m128i*)(secret + i) ) );
+        __m128i lo = _mm_mul_epu32( a, prime );
+        __m128i hi = _mm_mul_epu32( _mm_srli_epi64( a, 32 ), prime );
+        _mm_storeu_si128( (__m128i*)(acc + i), _mm_add_epi64( lo, _mm_slli_epi64( hi, 32 ) ) );
+    }
+#else
+    scramble_scalar( acc, secret );
+#endif
+}
+
+// Each stripe of a block is keyed by the secret shifted one word further, so reordering stripes changes the hash.
+static void consume_stripes( UtilsHashStream *stream, const uint8_t *p, size_t count )
+{
+    for( size_t i = 0; i < count; ++i, p += UTILS_HASH_STRIPE_BYTES )
+    {
+        accumulate_stripe( stream->acc, p, stream->secret + stream->stripe_in_block );
+
+        if( ++stream->stripe_in_block == UTILS_HASH_STRIPES_PER_BLOCK )
+        {
+            scramble( stream->acc, stream->secret + UTILS_HASH_STRIPES_PER_BLOCK );
+            stream->stripe_in_block = 0;
+        }
+    }
+}
+
+void utils_hash_stream_begin( UtilsHashStream *stream, uint64_t seed )
+{
+    static const uint64_t initial_acc[8] = {
+        HASH_PRIME32, HASH_P0, HASH_P1, 0x8ebc6af09c88c6e3ULL,
+        0x589965cc75374cc3ULL, 0x1d8e4e27c47d124fULL, 0xc2b2ae3d27d4eb4fULL, 0x165667b1U,
+    };
+
+    memcpy( stream->acc, initial_acc, sizeof( initial_acc ) );
+
+    for( int i = 0; i < UTILS_HASH_SECRET_WORDS; ++i )
+        stream->secret[i] = i & 1 ? HASH_SECRET[i] - seed : HASH_SECRET[i] + seed;
+
+    stream->seed = seed;
+    stream->total_bytes = 0;
+    stream->stripe_in_block = 0;
+    stream->buffered_bytes = 0;
+}
+
+// Always leaves between 1 and 64 bytes buffered once anything was added, so the final bytes reach hash_tail the
+// same way however the input was split.
+void utils_hash_stream_add( UtilsHashStream *stream, const void *obj, size_t size )
+{
+    const uint8_t *p = obj;
+    stream->total_bytes += size;
+
+    if( stream->buffered_bytes + size <= UTILS_HASH_STRIPE_BYTES )
+    {
+        if( size ) memcpy( stream->buffer + stream->buffered_bytes, p, size );
+        stream->buffered_bytes += (uint32_t)size;
+        return;
+    }
+
+    if( stream->buffered_bytes )
+    {
+        size_t fill = UTILS_HASH_STRIPE_BYTES - stream->buffered_bytes;
+        memcpy( stream->buffer + stream->buffered_bytes, p, fill );
+        consume_stripes( stream, stream->buffer, 1 );
+        p += fill;
+        size -= fill;
+    }
+
+    size_t stripes = (size - 1) / UTILS_HASH_STRIPE_BYTES;
+    consume_stripes( stream, p, stripes );
+    p += stripes * UTILS_HASH_STRIPE_BYTES;
+    size -= stripes * UTILS_HASH_STRIPE_BYTES;
+
+    memcpy( stream->buffer, p, size );
+    stream->buffered_bytes = (uint32_t)size;
+}
+
+Hash utils_hash_stream_end( const UtilsHashStream *stream )
+{
+    uint64_t h;
+
+    if( stream->total_bytes <= UTILS_HASH_STRIPE_BYTES )
+    {
+        h = hash_mix_seed( stream->seed );
+    }
+    else
+    {
+        h = stream->total_bytes * HASH_P0;
+
+        for( int i = 0; i < 8; i += 2 )
+            h += mul_fold( stream->acc[i] ^ stream->secret[i + 11], stream->acc[i + 1] ^ stream->secret[i + 12] );
+
+        h ^= h >> 37;
+        h *= 0x165667919e3779f9ULL;
+        h ^= h >> 32;
+    }
+
+    return hash_tail( stream->buffer, stream->buffered_bytes, h, stream->total_bytes );
+}
+
+Hash utils_hash_seeded( const void *obj, size_t size, uint64_t seed )
+{
+    if( size <= UTILS_HASH_STRIPE_BYTES )
+        return hash_tail( obj, size, hash_mix_seed( seed ), size );
+
+    UtilsHashStream stream;
+    utils_hash_stream_begin( &stream, seed );
+    utils_hash_stream_add( &stream, obj, size );
+    return utils_hash_stream_end( &stream );
+}
+
 Hash utils_hash( const void *obj, size_t size )
+{
+    // hash_mix_seed( 0 ), saving a multiply on the short keys most lookups hash.
+    static const uint64_t mixed_zero_seed = 0x1ff5c2923a788d2cULL;
+
+    if( size <= UTILS_HASH_STRIPE_BYTES )
+        return hash_tail( obj, size, mixed_zero_seed, size );
+
+    return utils_hash_seeded( obj, size, 0 );
+}
+
+#ifdef RUN_TESTS
+
+#include <ns_clock.h>
+
+static void fill_test_bytes( uint8_t *bytes, size_t size, uint32_t seed )
+{
+    for( size_t i = 0; i < size; ++i )
+    {
+        seed = seed * 1664525u + 1013904223u;
+        bytes[i] = (uint8_t)(seed >> 24);
+    }
+}
+
+TestResult utils_test( void )
+{
+    TEST_BEGIN( "Streamed hashes match one-shot hashes however the input is split" );
+
+        static uint8_t bytes[3000];
+        fill_test_bytes( bytes, sizeof( bytes ), 1 );
+
+        static const size_t sizes[] = { 0, 1, 3, 4, 8, 16, 17, 63, 64, 65, 128, 129, 1023, 1024, 1025, 3000 };
+        static const size_t pieces[] = { 1, 7, 64, 100 };
+        bool all_match = true;
+
+        for( int i = 0; i < COUNT_OF( sizes ); ++i )
+        for( int j = 0; j < COUNT_OF( pieces ); ++j )
+        {
+            UtilsHashStream stream;
+            utils_hash_stream_begin( &stream, 99 );
+            utils_hash_stream_add( &stream, bytes, 0 );
+
+            for( size_t at = 0; at < sizes[i]; at += pieces[j] )
+                utils_hash_stream_add( &stream, bytes + at, sizes[i] - at < pieces[j] ? sizes[i] - at : pieces[j] );
+
+            all_match &= utils_hash_stream_end( &stream ) == utils_hash_seeded( bytes, sizes[i], 99 );
+        }
+
+        for( int i = 0; i < COUNT_OF( sizes ); ++i )
+            all_match &= utils_hash( bytes, sizes[i] ) == utils_hash_seeded( bytes, sizes[i], 0 );
+
+        TEST_ASSERT( all_match );
+
+    TEST_END();
+    TEST_BEGIN( "Hash depends on every bit, the length, the seed and the stripe order" );
+
+        static uint8_t bytes[1100];
+        fill_test_bytes( bytes, sizeof( bytes ), 2 );
+
+        static const size_t sizes[] = { 3, 8, 16, 17, 64, 65, 1100 };
+        bool all_differ = true;
+
+        for( int i = 0; i < COUNT_OF( sizes ); ++i )
+        {
+            Hash base = utils_hash( bytes, sizes[i] );
+
+            for( size_t bit = 0; bit < sizes[i] * 8; ++bit )
+            {
+                bytes[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+                all_differ &= utils_hash( bytes, sizes[i] ) != base;
+                bytes[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+            }
+
+            all_differ &= utils_hash_seeded( bytes, sizes[i], 1 ) != base;
+        }
+
+        TEST_ASSERT( all_differ );
+
+        static uint8_t zeros[200];
+        Hash zero_hashes[COUNT_OF( zeros )];
+
+        for( int i = 0; i < COUNT_OF( zeros ); ++i )
+        {
+            zero_hashes[i] = utils_hash( zeros, (size_t)i );
+
+            for( int j = 0; j < i; ++j )
+                all_differ &= zero_hashes[i] != zero_hashes[j];
+        }
+
+        TEST_ASSERT( all_differ );
+
+        uint8_t swapped[256];
+        memcpy( swapped, bytes + 64, 64 );
+        memcpy( swapped + 64, bytes, 64 );
+        memcpy( swapped + 128, bytes + 128, 128 );
+
+        TEST_ASSERT( utils_hash( swapped, sizeof( swapped ) ) != utils_hash( bytes, sizeof( swapped ) ) );
+
+    TEST_END();
+    TEST_BEGIN( "SIMD stripe paths match the scalar ones" );
+
+        uint8_t stripe[UTILS_HASH_STRIPE_BYTES];
+        uint64_t simd_acc[8], scalar_acc[8];
+        bool all_match = true;
+
+        fill_test_bytes( (uint8_t*)simd_acc, sizeof( simd_acc ), 3 );
+        memcpy( scalar_acc, simd_acc, sizeof( simd_acc ) );
+
+        for( uint32_t i = 0; i < 32; ++i )
+        {
+            fill_test_bytes( stripe, sizeof( stripe ), 4 + i );
+
+            accumulate_stripe( simd_acc, stripe, HASH_SECRET + i % 16 );
+            accumulate_stripe_scalar( scalar_acc, stripe, HASH_SECRET + i % 16 );
+            scramble( simd_acc, HASH_SECRET + 16 );
+            scramble_scalar( scalar_acc, HASH_SECRET + 16 );
+
+            all_match &= memcmp( simd_acc, scalar_acc, sizeof( simd_acc ) ) == 0;
+        }
+
+        TEST_ASSERT( all_match );
+
+    TEST_END();
+    return 0;
+}
+
+// The byte at a time rotate hash utils_hash used before, kept to benchmark against.
+static uint32_t rotate_hash( const void *obj, size_t size )
 {
     const uint8_t *bytes = (uint8_t*)obj;
     uint32_t hash = 0;
@@ -62,3 +459,47 @@ Hash utils_hash( const void *obj, size_t size )
 
     return hash;
 }
+
+// Not part of run_all_tests, since it takes a while. Enable RUN_BENCHMARKS in testing.h to include it.
+TestResult utils_hash_benchmark( void )
+{
+    static const size_t sizes[] = { 4, 16, 64, 256, 1024, 16384 };
+    const size_t bytes_per_size = 32 * 1024 * 1024;
+
+    uint8_t *bytes = malloc( sizes[COUNT_OF( sizes ) - 1] );
+    fill_test_bytes( bytes, sizes[COUNT_OF( sizes ) - 1], 5 );
+    uint64_t sink = 0;
+
+    printf( "  %8s %16s %16s\n", "bytes", "rotate MB/s", "utils_hash MB/s" );
+
+    for( int i = 0; i < COUNT_OF( sizes ); ++i )
+    {
+        size_t iterations = bytes_per_size / sizes[i];
+
+        uint64_t start = ns_clock();
+        for( size_t j = 0; j < iterations; ++j )
+        {
+            bytes[0] = (uint8_t)j;
+            sink += rotate_hash( bytes, sizes[i] );
+        }
+        uint64_t rotate_ns = ns_clock() - start;
+
+        start = ns_clock();
+        for( size_t j = 0; j < iterations; ++j )
+        {
+            bytes[0] = (uint8_t)j;
+            sink += utils_hash( bytes, sizes[i] );
+        }
+        uint64_t hash_ns = ns_clock() - start;
+
+        printf( "  %8u %16.0f %16.0f\n", (uint32_t)sizes[i],
+            1e3 * (double)bytes_per_size / (double)(rotate_ns + 1),
+            1e3 * (double)bytes_per_size / (double)(hash_ns + 1) );
+    }
+
+    printf( "  (checksum %llx)\n", (unsigned long long)sink );
+    free( bytes );
+    return 0;
+}
+
+#endif
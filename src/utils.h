@@ -21,6 +21,33 @@
 #endif
 
 
+// Minimal atomics for state shared between scheduler worker threads. Spin locks are int32_t, zero when unlocked.
+#ifdef _MSC_VER
+    #include <intrin.h>
+    #define UTILS_ATOMIC_INCREMENT_U64( ptr ) ((uint64_t)_InterlockedIncrement64( (volatile long long*)(ptr) ))
+    #define UTILS_ATOMIC_LOAD_U64( ptr ) ((uint64_t)_InterlockedOr64( (volatile long long*)(ptr), 0 ))
+    #define UTILS_SPIN_LOCK( ptr ) while( _InterlockedExchange( (volatile long*)(ptr), 1 ) ) {}
+    #define UTILS_SPIN_UNLOCK( ptr ) _InterlockedExchange( (volatile long*)(ptr), 0 )
+#else
+    #define UTILS_ATOMIC_INCREMENT_U64( ptr ) __atomic_add_fetch( (ptr), 1, __ATOMIC_RELAXED )
+    #define UTILS_ATOMIC_LOAD_U64( ptr ) __atomic_load_n( (ptr), __ATOMIC_RELAXED )
+    #define UTILS_SPIN_LOCK( ptr ) while( __atomic_exchange_n( (ptr), 1, __ATOMIC_ACQUIRE ) ) {}
+    #define UTILS_SPIN_UNLOCK( ptr ) __atomic_store_n( (ptr), 0, __ATOMIC_RELEASE )
+#endif
+
+// Index of the lowest set bit, for walking bitsets a word at a time. x must not be zero.
+static inline uint32_t utils_count_trailing_zeros_u64( uint64_t x )
+{
+#ifdef _MSC_VER
+    unsigned long result;
+    _BitScanForward64( &result, x );
+    return (uint32_t)result;
+#else
+    return (uint32_t)__builtin_ctzll( x );
+#endif
+}
+
+
 #define UTILS_STRTOK_FOR( str, split, ivar ) for( \
     char *tok_ctx_, *ivar = strtok_ctx( (str), (split), &tok_ctx_ ); \
     ivar != NULL; \
@@ -32,8 +59,37 @@
 #define UTILS_UNCONST_MAT( v ) ((vec4*)&(v)[0])
 
 
-typedef uint32_t Hash;
+typedef uint64_t Hash;
+
+#define UTILS_HASH_STRIPE_BYTES 64
+#define UTILS_HASH_STRIPES_PER_BLOCK 16
+#define UTILS_HASH_SECRET_WORDS (8 + UTILS_HASH_STRIPES_PER_BLOCK)
+
+// Incremental state for hashing data that isn't contiguous, e.g. several fields of a struct. Adding the bytes in
+// any number of pieces gives the same hash as passing them all to utils_hash_seeded at once.
+typedef struct UtilsHashStream
+{
+    uint64_t acc[8];
+    uint64_t secret[UTILS_HASH_SECRET_WORDS];
+    uint64_t seed;
+    uint64_t total_bytes;
+    uint32_t stripe_in_block;
+    uint32_t buffered_bytes;
+    uint8_t buffer[UTILS_HASH_STRIPE_BYTES];
+}
+UtilsHashStream;
 
 extern char *utils_read_file_alloc( const char *path_prefix, const char *path, size_t *file_length );
 extern void utils_write_string_file( const char *path, const char *contents );
+
 extern Hash utils_hash( const void *obj, size_t size );
+extern Hash utils_hash_seeded( const void *obj, size_t size, uint64_t seed );
+extern void utils_hash_stream_begin( UtilsHashStream *stream, uint64_t seed );
+extern void utils_hash_stream_add( UtilsHashStream *stream, const void *obj, size_t size );
+extern Hash utils_hash_stream_end( const UtilsHashStream *stream );
+
+#ifdef RUN_TESTS
+#include "testing.h"
+extern TestResult utils_test( void );
+extern TestResult utils_hash_benchmark( void );
+#endif